@@ -15,47 +15,267 @@
     
     Features:
         1. Book Class
-            Attributes: Title, Author, ISBN, Genre, Availability
+            Attributes: Hot: dictionary IDs of the normalized title and author (keys), ISBN (64 bit key), Availability, Type tag, Title, Author
+                        Cold: Genre and the fields of the book's type (BookDetails), in memory or paged out to a DetailFile
             Methods: Constructor, Display book details, Display availability, Update availability,
-                     Get title, Get author, Get ISBN, Get Availability
+                     Get title, Get author, Get title key, Get author key, Get title ID,
+                     Get author ID, Get ISBN, Get genre, Get Availability, Get type,
+                     Get details, Read details into a reused struct, Page out details, Check if details are paged out
         
         2. Textbook Class (derived from Book Class)
-            Attributes: Course, Edition 
-            Methods: Constructor, Display textbook details 
+            Attributes: Course, Edition (cold)
+            Methods: Constructor, Display textbook details, Get course, Get edition
         
         3. FictionBook Class (derived from Book Class)
-            Attributes: Main character, Setting 
-            Methods: Constructor, Display fiction book details 
+            Attributes: Main character, Setting (cold)
+            Methods: Constructor, Display fiction book details, Get main character, Get setting
+
+        3a. DetailFile Class
+            Attributes: File path, writer, memory-mapped (or read in) contents
+            Methods: Append a book's details, Finish writing and map the file, Read a book's details back
+
+        3b. ISBN Functions
+            Parse an ISBN-10 or ISBN-13 and check its check digit (both forms give the same 64 bit ISBN-13 key),
+            Format a key, Validate a batch of ISBNs (SSE2 for plain ISBN-13s)
+
+        3c. Memory Accounting
+            MemoryComponent (bytes requested, allocations, bytes with allocator overhead) and counting functions for
+            allocations, strings, vectors, and hash maps; each class holding heap memory can count it into a component
+            Tracking allocator hook (compiled in with -DLMS_TRACK_ALLOCATIONS): every form of global operator new and
+            delete (plain, array, nothrow, aligned, and sized), keeping count of the live bytes and allocations, to
+            check memory reports against
+
+        3d. Book Types (BookTypeInfo struct)
+            Attributes: Per type tag: name, plural name, export name, wording and export names of the two detail fields,
+                        facet each detail field is indexed under, object size, function creating a book of the type
+            Functions: Display a book's details the way its type does, Display the detail fields of a type, Create a
+                       book of a type tag
+
+        3e. KeyDictionary Class (one for title keys and one for author keys, shared by every book)
+            Attributes: Sorted keys (front coded) with the ID of each, keys added since the last merge (delta), position
+                        and number of books holding each ID, free IDs
+            Methods: Add a key (merging the delta into the sorted keys once it outgrows an eighth of them), Release a
+                     key, Find a key's ID, Look up a key by ID, Check an ID against a key, Visit the keys with a prefix,
+                     Get size, Get memory usage
+
+        3f. KeyMatcher Class
+            Attributes: Key dictionary, key, last matching and non-matching IDs
+            Methods: Check if an ID is the key's
         
         4. Library Class
-            Attributes: Vector of textbook pointers, vector of fiction book pointers
-            Methods: Add a book (overloaded for both textbook and fiction), Remove textbook, Remove fiction book,
-                     Search for a book by title or author, Display all books, Borrow or return a book
+            Attributes: Section (vector of book pointers) per type tag, search index of the books of every type by title
+                        and by author (ordered by type tag), hold queues per title,
+                        copies held for patrons, ISBN index of every type, counts of total and available copies per author
+                        and type (genre and course counts are kept by the bitmap index), cache of search results, copies of each title key and author key by dictionary ID,
+                        counting Bloom filter over the titles, authors, and title/author pairs of every type,
+                        catalog versions for snapshot reads (when turned on), availability history per title,
+                        co-borrow graph of titles patrons borrow together, trace recorder (when attached),
+                        bitmap index of the genre, course, edition, setting, type, and availability of every book
+                        (with the copy counts of each value)
+            Methods: Add a book of any type, Remove a book of a type (a copy held for a patron passes the hold to
+                     another copy on the shelf, or puts the patron back at the front of the queue), Remove textbook,
+                     Remove fiction book,
+                     Search for a book by title or author (of one type, or of any type; either is one probe of the
+                     search index),
+                     Display all books, Borrow or return a book,
+                     Place a hold on a book, Get hold queue length, Register a patron, Get a patron's loans,
+                     Display a patron's loans, Get counts for a genre, course, or author, Get counts for a type,
+                     Display catalog statistics, Find books (cached), Get search cache metrics,
+                     Attach a mutation log, Show or hide borrow and return messages, Find titles by prefix,
+                     Get title/author dictionary memory report, Configure Bloom filters, Get Bloom filter stats,
+                     Prepare, commit, or borrow or return a batch of books (all or nothing),
+                     Look up one batch query (by ISBN, title and author, title, or author; thread safe, not cached),
+                     Turn snapshots on or off, Pin a snapshot of the catalog,
+                     Get available copies at a time, Get availability over a window of time, Fix the history time,
+                     Page out book details to a memory-mapped file, Get or display a memory report by component,
+                     Get a section's size, Get a section's book by position,
+                     Get or display recommendations for a title, Set the session window for recommendations,
+                     Attach a trace recorder,
+                     Filter the books of every section by facets (AND, OR, and NOT of genre, course, edition, setting,
+                     type, and availability) with facet counts of the matches, Display filtered books
+
+        4a. HoldQueue Class
+            Attributes: Vector of patron IDs, head index, set of the waiting patron IDs
+            Methods: Push a patron, Put a patron back at the front, Pop the next patron, Check if a patron is waiting,
+                     Get size
+
+        4b. PatronIndex Class
+            Attributes: Vector of patron records, vector of loan nodes (linked per patron), patron ID to record index,
+                        book to borrowing patron index
+            Methods: Register a patron, Find a patron, Check the loan limit, Add a loan, Remove a loan,
+                     Find a loan by title and author, Get a patron's loans
+
+        4c. SearchCache Class
+            Attributes: Fixed number of cache slots (key, results, reference bit), key to slot index, hit/miss counters
+            Methods: Look up results, Insert results, Invalidate a key, Get metrics
+
+        4d. MutationLog Class
+            Attributes: Output file (starting with a magic string and format version), next sequence number, record buffer
+            Methods: Log adding a book, removing a book, borrowing or returning, borrowing or returning a batch,
+                     registering a patron, placing a hold
+
+        4e. LogFollower Class
+            Attributes: Log file path, follower Library, read offset, last applied sequence number and timestamps,
+                        whether the log's format version can be replayed
+            Methods: Poll the log and apply new mutations, Get replication lag, Check the log's format version
+
+        4f. CountingBloomFilter Class
+            Attributes: 4-bit counters (two per byte), number of hash functions, capacity, number of keys
+            Methods: Reset for a capacity and false positive rate, Insert a key, Remove a key, Check a key,
+                     Check the key of a title or author as typed (hashed as it is normalized, without building it),
+                     Get memory usage
+
+        4g. FrontCodedDictionary Class
+            Attributes: Sorted strings stored in blocks of 16 (first string in full, the rest as shared prefix length
+                        plus suffix), block offsets, optional table of common character pairs (bigram codec)
+            Methods: Build (from any strings, or from sorted distinct ones), Find a string, Find the range of strings
+                     with a prefix, Look up a string by ID, Check a string by ID, Visit a range of IDs, Get memory usage
+
+        4h. AvailabilityHistory Class
+            Attributes: Per title: encoded changes (seconds since the previous change, change in available and total
+                        copies as varints) and an index of blocks of 64 changes with their start time and counts
+            Methods: Record a change, Get available copies at a time, Summarize a window of time (fewest and most
+                     available, time-weighted average, peak utilization), Get size, Get memory usage
+
+        4i. CatalogVersions Class
+            Attributes: Published version (chunks of 256 book records and availabilities per section, type counts),
+                        working chunks, epoch of each reader, objects retired per epoch
+            Methods: Add a book, Remove a book, Set availability, Publish the working version (copying only the
+                     changed chunks, and reclaiming what no reader can still see), Pin and unpin a version
+
+        4j. CatalogSnapshot Class
+            Attributes: Pinned catalog version, reader slot
+            Methods: Get version number, Get counts for a type, Visit every book, Display all books
+
+        4k. ThreadPool Class
+            Attributes: Worker threads, task queue
+            Methods: Submit a task
+
+        4l. BatchQueryExecutor Class
+            Attributes: Thread pool, range of queries left for each worker, number of steals
+            Methods: Run a batch of queries in parallel (results in input order; idle workers steal half of the
+                     largest range left), Get steal count
+
+        4m. LibraryNetwork Class
+            Attributes: Library shards (one per branch, or one per ISBN hash bucket), a lock per shard, thread pool,
+                        directory from title and author to the shards holding copies, loan limit and books on loan of
+                        each patron across every shard
+            Methods: Add a book (to a branch, or by ISBN hash), Remove textbook, Remove fiction book,
+                     Find books on every shard in parallel, Search for a book, Borrow or return a book,
+                     Borrow or return a batch of books across shards (shards locked in ascending order),
+                     Register a patron at every branch (with one loan limit for all branches together)
+
+        4n. CatalogExporter Class
+            Attributes: Format (CSV, JSON, or NDJSON), thread pool, reusable output buffers
+            Methods: Export every book of a library to a file (chunks formatted in parallel and written in order)
+
+        4o. CoBorrowGraph Class
+            Attributes: Titles (with genre and author IDs, copies, and borrows), each patron's recent borrows, session
+                        window, links between titles in CSR form (offsets, neighbors, weights), links not merged yet
+            Methods: Count a copy added or removed, Record a patron's borrow (linking it to the session's other titles,
+                     merging into CSR form when enough links are pending), Recommend the top k titles (co-borrows
+                     normalized by borrows, plus author and genre bonuses), Set session window, Get title, link, and
+                     merge counts
+
+        4p. TraceRecorder and TraceCall Classes
+            Attributes: Trace file, record buffer (written 1 MB at a time), start time, depth of the traced call
+            Methods: Trace a call made to a Library (operation, arguments, time since the previous call, duration, and
+                     whether it threw) from a TraceCall in scope for the call; calls made inside a traced call are skipped,
+                     as are the calls other threads make (lookup, snapshot, section access) and attaching a log or trace
+
+        4q. TraceReplayer Class
+            Attributes: Trace file path, format version, traced calls, start time
+            Methods: Load a trace (of the current format version only), Get its format version, Replay it against a fresh Library as fast as possible or at the recorded pace
+                     (at the library time each call was recorded at), Display latency per operation when recorded and
+                     replayed, with errors and outcome mismatches
+
+        4r. RoaringBitmap Class
+            Attributes: Containers of 32 bit IDs sharing their high 16 bits, each a sorted array (up to 4096 IDs) or a
+                        65536 bit bitmap
+            Methods: Add, remove, or check an ID, Get cardinality, AND, OR, AND NOT, Count an intersection, Visit the IDs
+                     in order
+
+        4s. FacetIndex Class (and FacetFilter struct)
+            Attributes: Row per book (reused after removals) with its value ID for each field, bitmap of the rows of each
+                        genre, course, edition, and setting value (and its total and available copies), bitmaps of
+                        every row, of each type, and of the available rows
+            Methods: Add or remove a book, Set a book's availability, Filter (terms combined with AND, OR, and NOT;
+                     NOT inside an AND subtracts instead of building a complement) with facet counts of the matches,
+                     Get a value's copy counts, Visit every value with its copy counts
+            FacetFilter functions: Term, Type, Available, And, Or, Not
 
         5. Main Function
             Description: Menu (switch statement) by which the methods of the Library Class are utilized
+            Command line options:
+                --bench-shards       Measure search throughput of a LibraryNetwork as the number of shards grows
+                --bench-dictionary   Compare the memory and lookup time of front coded title/author dictionaries
+                                     (projected) and of the key dictionaries books hold IDs in (measured) against plain
+                                     strings
+                --bench-normalize    Compare matching against precomputed normalized keys with normalizing per query,
+                                     and the vectorized normalizer with the UTF-8 one
+                --bench-bloom        Compare lookups of books the library doesn't have with and without Bloom filters
+                --bench-batch        Compare the latency of borrowing and returning books as one batch with one call per book
+                --bench-queries      Measure how a batch of lookups scales with the threads of a BatchQueryExecutor
+                --bench-snapshot     Measure borrow and return latency while a reader dumps the catalog, with the reader
+                                     locking the library and with it reading a snapshot
+                --bench-history      Measure the memory and query time of the availability history over a semester
+                --bench-hot-cold     Compare scanning books with every field inline against the hot/cold split and a
+                                     search index probe, with the cold details in memory and paged out to a file
+                --bench-isbn         Compare validating millions of ISBNs one at a time with the batch validator
+                --bench-recommend    Measure recording borrows in the co-borrow graph and serving top 10 recommendations
+                                     over simulated borrowing sessions
+                --bench-facets       Compare answering faceted filters with facet counts from the bitmap index with
+                                     scanning both sections
+                --bench-any-type     Compare searching for books of any type in one call with one search per type
+                --bench-export       Compare exporting a large catalog as CSV, JSON, and NDJSON on 1 to 4 threads with
+                                     writing the same bytes from memory
+                --export <format> <file> <log> [threads]
+                                     Export the catalog a mutation log describes to <file> as csv, json, or ndjson
+                --bench-trace        Measure what tracing adds to each call, then replay the trace and check every
+                                     call ends the way it did when it was recorded
+                --trace <file>       Run the menu with every call to the library traced to <file>
+                --replay <file> [--original-speed]
+                                     Replay a trace against a fresh library, as fast as possible or at the pace it was
+                                     recorded, and display the latency of each kind of call
+                --memory-report [n]  Break down the heap memory of a catalog of n books (100000 by default) by component,
+                                     before and after paging out the details, and check it against the tracking allocator
+                                     when built with -DLMS_TRACK_ALLOCATIONS (exiting with 1 if they disagree)
+                --leader <log>       Run the menu as the leader; every change to the library is appended to <log>
+                                     (an existing log is replayed first; one written in another format version,
+                                     or before logs had a version, is refused)
+                --follower <log>     Run a read-only menu on a replica that applies the leader's <log> as it grows
             Primary necessary variables:
                 Library object
-                Textbook pointer
-                FictionBook pointer
-                Integer variables choice, bookType, searchChoice, borrowOrReturnChoice, isbn
-                String variables title, author, genre, course, edition, mainCharacter, setting
+                Book pointer
+                Integer variables choice, bookType, searchChoice, borrowOrReturnChoice, patronID, patronChoice, maxLoans
+                64 bit integer variable isbn
+                String variables title, author, genre, field1, field2, isbnText
         
         6. Exception Handling
             Errors that are accounted for:
                 Empty string (when adding book)
-                Negative ISBN (when adding book)
                 Duplicate ISBN for books that aren't the same (when adding book)
-                Book not found (when removing, searching for, borrowing, or returning a book)
-                Book not borrowable (when borrowing a book)
-                Book not returnable (when returning a book)
+                Book not found (when removing, searching for, borrowing, or returning a book or a batch of books)
+                Book not borrowable (when borrowing a book or a batch of books)
+                Book not returnable (when returning a book or a batch of books)
+                Invalid patron (when placing a hold or registering a patron)
+                Duplicate patron (when registering a patron)
+                Invalid branch (when adding a book to a LibraryNetwork shard that doesn't exist)
+                Patron not found (when borrowing, returning, placing a hold, or listing loans with a library card)
+                Loan limit reached (when borrowing a book or a batch of books)
+                Hold not needed (when placing a hold on a book that has an available copy)
+                Duplicate hold (when placing a hold the patron already has)
+                Snapshots disabled (when asking for a snapshot of a library with snapshots turned off)
+                Export file error (when an export file can't be opened or written)
             Addition errors that are accounted for but are not exceptions:
                 Invalid input for [menu] choice
                 Invalid input for bookType
                 Invalid input for searchChoice
                 Invalid input for borrowOrReturnChoice
+                Invalid ISBN-10 or ISBN-13 (when adding book)
             Note:
                 Books that have the same title and author are assumed to have the same content
+                Titles and authors are matched by their normalized keys, ignoring case, accents, and extra whitespace
 
 */
 
@@ -63,707 +283,12361 @@
 // Including necessary libraries
 #include <iostream>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 using namespace std;
 
 
-// Book base class
-class Book {
-    
-    // Private members
-    private:
-        string title, author, genre;
-        int isbn;
-        bool availability;
-    
-    // Public member functions
-    public:
-        
-        // Constructor with arguments
-        Book(string t, string a, int i, string g) {
-            
-            title = t;
-            author = a;
-            isbn = i;
-            genre = g;
-            availability = true;
+// Functions to normalize titles and authors into the keys used for matching
+//  A key is the text with case folded, accents stripped, whitespace runs collapsed to one space, and leading and
+//  trailing whitespace removed, so "  the HOBBIT" and "The Hobbit" have the same key, as do "Émile" and "emile".
+//  Keys are computed once when a book is created; only the text being searched for is normalized per query.
 
-        }
+// Folded forms of U+00C0 to U+017F (Latin-1 Supplement letters and Latin Extended-A), separated by '|'
+//  An empty entry means the character is kept as it is
+const char* latinFoldTable =
+    "a|a|a|a|a|a|ae|c|e|e|e|e|i|i|i|i|d|n|o|o|o|o|o||o|u|u|u|u|y|th|ss|"
+    "a|a|a|a|a|a|ae|c|e|e|e|e|i|i|i|i|d|n|o|o|o|o|o||o|u|u|u|u|y|th|y|"
+    "a|a|a|a|a|a|c|c|c|c|c|c|c|c|d|d|d|d|e|e|e|e|e|e|e|e|e|e|g|g|g|g|"
+    "g|g|g|g|h|h|h|h|i|i|i|i|i|i|i|i|i|i|ij|ij|j|j|k|k|k|l|l|l|l|l|l|l|"
+    "l|l|l|n|n|n|n|n|n|n|n|n|o|o|o|o|o|o|oe|oe|r|r|r|r|r|r|s|s|s|s|s|s|"
+    "s|s|t|t|t|t|t|t|u|u|u|u|u|u|u|u|u|u|u|u|w|w|y|y|y|z|z|z|z|z|z|s";
 
-        // Function to display book details
-        void displayBookDetails() {
-            
-            cout << "\t" << title << " is made by " << author << "; its genre is " << genre << "." << endl;
-            cout << "\tIts ISBN is " << isbn << "." << endl;
+// Function to split the fold table into one entry per character
+vector<string> buildLatinFolds() {
 
-        }
+    vector<string> folds;
+    string entry;
+    for (const char* p = latinFoldTable; ; p++) {
+
+        if (*p == '|' || *p == '\0') {
+
+            folds.push_back(entry);
+            entry.clear();
+            if (*p == '\0') {
+
+                break;
 
-        // Function to display a book's availability
-        void displayAvailability() {
-            
-            if (availability) {
-                cout << "\t" << title << " is available." << endl;
-            } else {
-                cout << "\t" << title << " is not available." << endl;
             }
 
+        } else {
+
+            entry += *p;
+
         }
 
-        // Function to update a book's availability
-        void updateAvailability(bool av) {
+    }
+    return folds;
 
-            availability = av;
+}
 
-        }
+// Function to return the folded form of U+00C0 to U+017F (nullptr if the character is kept as it is)
+//  The table is built once by the initializer of a local static, which is thread safe, so keys can be normalized on
+//  several threads at once
+const char* latinFold(uint32_t codePoint) {
 
-        // Function to return a book's title
-        string getTitle() {
+    static const vector<string> folds = buildLatinFolds();
 
-            return title;
+    const string& fold = folds[codePoint - 0xC0];
+    return fold.empty() ? nullptr : fold.c_str();
 
-        }
+}
 
-        // Function to return a book's author
-        string getAuthor() {
+// Function to append a code point as UTF-8
+void appendUtf8(string& out, uint32_t codePoint) {
 
-            return author;
-            
-        }
+    if (codePoint < 0x80) {
 
-        // Function to return a book's ISBN
-        int getISBN() {
+        out += char(codePoint);
 
-            return isbn;
+    } else if (codePoint < 0x800) {
 
-        }
+        out += char(0xC0 | (codePoint >> 6));
+        out += char(0x80 | (codePoint & 0x3F));
 
-        // Function to get a book's availability
-        bool getAvailability() {
+    } else if (codePoint < 0x10000) {
 
-            return availability;
+        out += char(0xE0 | (codePoint >> 12));
+        out += char(0x80 | ((codePoint >> 6) & 0x3F));
+        out += char(0x80 | (codePoint & 0x3F));
 
-        }
+    } else {
 
-};
+        out += char(0xF0 | (codePoint >> 18));
+        out += char(0x80 | ((codePoint >> 12) & 0x3F));
+        out += char(0x80 | ((codePoint >> 6) & 0x3F));
+        out += char(0x80 | (codePoint & 0x3F));
 
+    }
 
-// Textbook class derived from Book base class
-class Textbook : public Book {
+}
 
-    // Private members
-    private:
-        string course, edition;
-    
-    // Public member functions
-    public:
-        
-        // Exception classes:
-        //  Exception class to handle empty string
-        class emptyStringError {};
-        //  Exception class to handle negative ISBN
-        class negativeISBNerror {};
+// Function to normalize any UTF-8 text one code point at a time
+//  Bytes that aren't valid UTF-8 are kept as they are. Besides Latin letters, Greek and Cyrillic capitals are folded
+//  to lowercase, combining accents (U+0300 to U+036F) are dropped, and Unicode spaces count as whitespace.
+string normalizeKeyUtf8(const string& text) {
 
-        // Constructor with arguments; also calls base constructor with arguments
-        Textbook(string t, string a, int i, string g, string c, string e) : Book(t, a, i, g) {
-            
-            // Throw exception if empty string
-            if (t == "" || a == "" || g == "" || c == "" || e == "") {
-                
-                throw emptyStringError();
-            
-            // Throw exception if negative ISBN
-            } else if (i < 0) {
-                
-                throw negativeISBNerror();
+    // Declaring necessary variables
+    string key;
+    bool pendingSpace = false;
+    size_t i = 0;
+    key.reserve(text.size());
 
-            } else {
+    while (i < text.size()) {
 
-                course = c;
-                edition = e;
+        // Decoding the next code point
+        uint8_t lead = (uint8_t) text[i];
+        uint32_t codePoint = lead;
+        size_t length = 1;
+        if (lead >= 0xC2 && lead <= 0xDF) {
 
-            }
+            length = 2;
+            codePoint = lead & 0x1F;
 
-        }
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
 
-        // Function to display textbook details; also calls function to display book details from Book class
-        void displayTextbookDetails() {
+            length = 3;
+            codePoint = lead & 0x0F;
 
-            displayBookDetails();
-            cout << "\tThis is a Textbook. The Course it's for is " << course << " and the Edition is " << edition << "." << endl;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+
+            length = 4;
+            codePoint = lead & 0x07;
 
         }
+        if (length > 1) {
 
-};
+            bool valid = i + length <= text.size();
+            for (size_t j = 1; valid && j < length; j++) {
 
+                uint8_t next = (uint8_t) text[i + j];
+                valid = (next & 0xC0) == 0x80;
+                codePoint = (codePoint << 6) | (next & 0x3F);
 
-// FictionBook class derived from Book base class
-class FictionBook : public Book {
+            }
+            if (!valid) {
 
-    // Private members
-    private:
-        string mainCharacter, setting;
-    
-    // Public member functions
-    public:
+                length = 1;
+                codePoint = lead;
 
-        // Exception classes:
-        //  Exception class to handle empty string
-        class emptyStringError {};
-        //  Exception class to handle negative ISBN
-        class negativeISBNerror {};
+            }
 
-        // Constructor with arguments; also calls base constructor with arguments
-        FictionBook(string t, string a, int i, string g, string m, string s) : Book(t, a, i, g) {
-            
-            // Throw exception if empty string
-            if (t == "" || a == "" || g == "" || m == "" || s == "") {
-                
-                throw emptyStringError();
-            
-            // Throw exception if negative ISBN
-            } else if (i < 0) {
-                
-                throw negativeISBNerror();
+        }
 
-            } else {
+        // Whitespace (ASCII and Unicode spaces) only turns into a space before the next character that is kept
+        if ( codePoint == ' ' || (codePoint >= '\t' && codePoint <= '\r') || codePoint == 0xA0 ||
+             (codePoint >= 0x2000 && codePoint <= 0x200A) || codePoint == 0x3000 ) {
 
-                mainCharacter = m;
-                setting = s;
+            pendingSpace = !key.empty();
+            i += length;
+            continue;
 
-            }
+        }
+
+        // Combining accents are dropped
+        if (codePoint >= 0x300 && codePoint <= 0x36F) {
+
+            i += length;
+            continue;
 
         }
 
-        // Function to display fiction book details; also calls function to display book details from Book class
-        void displayFictionBookDetails() {
+        if (pendingSpace) {
 
-            displayBookDetails();
-            cout << "\tThis is a Fiction Book. The Main Character is " << mainCharacter << " and the setting is " << setting << "." << endl;
+            key += ' ';
+            pendingSpace = false;
 
         }
-        
-};
 
-// Library class
-class Library {
-    
-    // Private members
-    private:
+        // Folding the character
+        if (length == 1 && lead >= 0x80) {
 
-        // Creating two different vectors; one for Textbooks, and one for Fiction Books
-        //  These will store pointers to either Textbook or Fiction Book objects
-        vector<Textbook*> textbookSection;
-        vector<FictionBook*> fictionBookSection;
+            // Not valid UTF-8, so the byte is kept as it is
+            key += char(lead);
 
-    // Public member functions
-    public:
+        } else if (codePoint >= 'A' && codePoint <= 'Z') {
 
-        // Exception classes:
-        //  Exception class to handle a book with a duplicate ISBN that isn't the same book
-        class duplicateISBN {};
-        //  Exception class to handle a book not being found
-        class bookNotFoundError {};
-        //  Exception class to handle a book not being able to be borrowed
-        class bookNotBorrowableError {};
-        //  Exception class to handle a book not being able to be returned
-        class bookNotReturnableError {};
+            key += char(codePoint + 0x20);
 
-        // Overloaded functions to add either a Textbook or Fiction Book
-        void addBook(Textbook* b) {
-            
-            // Declaring necessary variables (to check for duplicate ISBN error)
-            string tempTitle, tempAuthor;
-            int tempISBN;
+        } else if (codePoint < 0x80) {
 
-            // Loop to go through Textbook vector
-            for (int i = 0; i < textbookSection.size(); i++) {
+            key += char(codePoint);
 
-                tempTitle = textbookSection[i]->getTitle();
-                tempAuthor = textbookSection[i]->getAuthor();
-                tempISBN = textbookSection[i]->getISBN();
+        } else if (codePoint >= 0xC0 && codePoint <= 0x17F && latinFold(codePoint) != nullptr) {
 
-                // If the ISBN of a given Textbook in the vector is the same as the one of the Textbook we are trying to add,
-                // AND it is true that their titles or authors are not the same, then throw an error for duplicate ISBN
-                if ( (b->getISBN() == tempISBN) && ( (b->getTitle() != tempTitle) || (b->getAuthor() != tempAuthor) ) ) {
+            key += latinFold(codePoint);
 
-                    throw duplicateISBN();
+        } else if ( (codePoint >= 0x391 && codePoint <= 0x3A9) || (codePoint >= 0x410 && codePoint <= 0x42F) ) {
 
-                }
+            appendUtf8(key, codePoint + 0x20);
 
-            }
+        } else if (codePoint >= 0x400 && codePoint <= 0x40F) {
+
+            appendUtf8(key, codePoint + 0x50);
+
+        } else {
 
-            // If no error occurs, we can add the Textbook
-            textbookSection.push_back(b);
+            key.append(text, i, length);
 
         }
-        void addBook(FictionBook* b) {
-            
-            // Declaring necessary variables (to check for duplicate ISBN error)
-            string tempTitle, tempAuthor;
-            int tempISBN;
+        i += length;
 
-            // Loop to go through Fiction Book vector
-            for (int i = 0; i < fictionBookSection.size(); i++) {
+    }
 
-                tempTitle = fictionBookSection[i]->getTitle();
-                tempAuthor = fictionBookSection[i]->getAuthor();
-                tempISBN = fictionBookSection[i]->getISBN();
+    return key;
 
-                // If the ISBN of a given Fiction Book in the vector is the same as the one of the Fiction Book we are trying to add,
-                // AND it is true that their titles or authors are not the same, then throw an error for duplicate ISBN
-                if ( (b->getISBN() == tempISBN) && ( (b->getTitle() != tempTitle) || (b->getAuthor() != tempAuthor) ) ) {
+}
 
-                    throw duplicateISBN();
+// Function to normalize a title or author
+//  ASCII text (the common case) takes a vectorized path that folds case and maps whitespace to spaces 16 bytes at a
+//  time and only collapses whitespace afterwards if it found a run of it; anything else goes through the UTF-8 path.
+string normalizeKey(const string& text) {
 
-                }
+    // Declaring necessary variables
+    string key(text.size(), '\0');
+    size_t i = 0;
+    bool needsCollapse = false;
+    //  Whether the byte before the current one was whitespace (the start of the text counts, to catch leading spaces)
+    unsigned previousSpace = 1;
 
-            }
-            
-            // If no error occurs, we can add the Fiction Book
-            fictionBookSection.push_back(b);
+#if defined(__SSE2__)
+    const __m128i beforeA = _mm_set1_epi8('A' - 1), afterZ = _mm_set1_epi8('Z' + 1), caseBit = _mm_set1_epi8(0x20);
+    const __m128i space = _mm_set1_epi8(' '), beforeTab = _mm_set1_epi8('\t' - 1), afterCR = _mm_set1_epi8('\r' + 1);
+    for (; i + 16 <= text.size(); i += 16) {
+
+        __m128i bytes = _mm_loadu_si128((const __m128i*) (text.data() + i));
+
+        // Any byte with the high bit set means the text isn't plain ASCII
+        if (_mm_movemask_epi8(bytes) != 0) {
+
+            return normalizeKeyUtf8(text);
 
         }
 
-        // Function to remove Textbook
-        Textbook* removeTextbook(string title, string author) {
+        // Folding A to Z to lowercase, then turning every whitespace byte into a space
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, beforeA), _mm_cmplt_epi8(bytes, afterZ));
+        bytes = _mm_or_si128(bytes, _mm_and_si128(upper, caseBit));
+        __m128i whitespace = _mm_or_si128(_mm_cmpeq_epi8(bytes, space),
+                                          _mm_and_si128(_mm_cmpgt_epi8(bytes, beforeTab), _mm_cmplt_epi8(bytes, afterCR)));
+        bytes = _mm_or_si128(_mm_andnot_si128(whitespace, bytes), _mm_and_si128(whitespace, space));
+        _mm_storeu_si128((__m128i*) &key[i], bytes);
 
-            // Declaring necessary variables
-            Textbook* txtPtr;
-            string tempTitle, tempAuthor;
+        // Checking for whitespace right after whitespace (or at the start)
+        unsigned mask = (unsigned) _mm_movemask_epi8(whitespace);
+        if ((mask & ((mask << 1) | previousSpace)) != 0) {
 
-            // Loop to go through Textbook vector
-            //  Search for matching title and author
-            for (int i = 0; i < textbookSection.size(); i++) {
+            needsCollapse = true;
 
-                tempTitle = textbookSection[i]->getTitle();
-                tempAuthor = textbookSection[i]->getAuthor();
+        }
+        previousSpace = mask >> 15;
 
-                // If match found, remove Textbook from vector and return the pointer so we can delete the object
-                if ( (title == tempTitle) && (author == tempAuthor) ) {
+    }
+#endif
 
-                    txtPtr = textbookSection[i];
-                    textbookSection.erase(textbookSection.begin() + i);
-                    return txtPtr;
+    // Loop for the bytes left over (or all of them without SSE2)
+    for (; i < text.size(); i++) {
 
-                }
+        uint8_t c = (uint8_t) text[i];
+        if (c >= 0x80) {
+
+            return normalizeKeyUtf8(text);
+
+        }
+
+        unsigned isSpace = (c == ' ' || (c >= '\t' && c <= '\r')) ? 1 : 0;
+        if (isSpace) {
+
+            c = ' ';
+            if (previousSpace) {
+
+                needsCollapse = true;
 
             }
 
-            throw bookNotFoundError();
-        
+        } else if (c >= 'A' && c <= 'Z') {
+
+            c += 0x20;
+
         }
-        // Function to remove Fiction Book
-        FictionBook* removeFictionBook(string title, string author) {
+        key[i] = char(c);
+        previousSpace = isSpace;
 
-            // Declaring necessary variables
-            FictionBook* ficPtr;
-            string tempTitle, tempAuthor;
+    }
+
+    // Trailing whitespace also needs collapsing
+    if (!key.empty() && key.back() == ' ') {
+
+        needsCollapse = true;
+
+    }
+
+    // Collapsing whitespace runs in place and trimming the ends
+    if (needsCollapse) {
 
-            // Loop to go through Fiction Book vector
-            //  Search for matching title and author
-            for (int i = 0; i < fictionBookSection.size(); i++) {
+        size_t length = 0;
+        bool pendingSpace = false;
+        for (size_t j = 0; j < key.size(); j++) {
 
-                tempTitle = fictionBookSection[i]->getTitle();
-                tempAuthor = fictionBookSection[i]->getAuthor();
+            if (key[j] == ' ') {
 
-                // If match found, remove Fiction Book from vector and return the pointer so we can delete the object
-                if ( (title == tempTitle) && (author == tempAuthor) ) {
+                pendingSpace = length > 0;
 
-                    ficPtr = fictionBookSection[i];
-                    fictionBookSection.erase(fictionBookSection.begin() + i);
-                    return ficPtr;
+            } else {
+
+                if (pendingSpace) {
+
+                    key[length++] = ' ';
+                    pendingSpace = false;
 
                 }
+                key[length++] = key[j];
 
             }
 
-            // If match not found, throw exception for book not being found
-            throw bookNotFoundError();
-        
         }
+        key.resize(length);
 
-        // Function for searching for a book
-        void bookSearch(string title, string author, int bookType, int searchChoice) {
-            
-            // Searching for Textbook
-            if (bookType == 1) {
+    }
 
-                // Vector to store textbooks with matching titles
-                vector<Textbook*> matchingTextbooks;
+    return key;
 
-                // Searching for Textbook by Title
-                if (searchChoice == 1) {
+}
 
-                    // Declaring necessary variable
-                    string tempTitle;
+// Function to pass the bytes of a title's or author's key to visit one at a time, without building the key
+//  Only plain ASCII text is handled: the bytes are exactly those normalizeKey would return, and false is returned
+//  (possibly after some bytes were visited) for anything else, which the caller then normalizes the usual way
+template <class Visit>
+bool visitNormalizedKey(const string& text, Visit visit) {
 
-                    // Loop to go through Textbook vector
-                    //  Search for matching title
-                    for (int i = 0; i < textbookSection.size(); i++) {
+    bool pendingSpace = false, started = false;
+    for (size_t i = 0; i < text.size(); i++) {
 
-                        tempTitle = textbookSection[i]->getTitle();
+        uint8_t c = (uint8_t) text[i];
+        if (c >= 0x80) {
 
-                    // If match found, add it to list of matches
-                        if (title == tempTitle) {
+            return false;
 
-                            matchingTextbooks.push_back(textbookSection[i]);
+        }
 
-                        }
+        // Whitespace only turns into a space before the next character
+        if (c == ' ' || (c >= '\t' && c <= '\r')) {
 
-                    }
-                
-                // Searching for Textbook by Author
-                } else if (searchChoice == 2) {
+            pendingSpace = started;
+            continue;
 
-                    // Declaring necessary variable
-                    string tempAuthor;
+        }
+        if (pendingSpace) {
 
-                    // Loop to go through Textbook vector
-                    //  Search for matching author
-                    for (int i = 0; i < textbookSection.size(); i++) {
+            visit((uint8_t) ' ');
+            pendingSpace = false;
 
-                        tempAuthor = textbookSection[i]->getAuthor();
+        }
+        visit((uint8_t) ((c >= 'A' && c <= 'Z') ? c + 0x20 : c));
+        started = true;
 
-                    // If match found, add it to list of matches
-                        if (author == tempAuthor) {
+    }
+    return true;
 
-                            matchingTextbooks.push_back(textbookSection[i]);
+}
 
-                        }
 
-                    }
-                    
-                }
-                
-                // Throw error if no matches
-                if (matchingTextbooks.size() == 0) {
+// Function to compute the check digit of the first 12 digits of an ISBN-13 (weights 1, 3, 1, 3, ...)
+int isbn13CheckDigit(const int* digits) {
 
-                    throw bookNotFoundError();
-                
-                // Otherwise, display details
-                } else {
+    int sum = 0;
+    for (int i = 0; i < 12; i++) {
 
-                    cout << "\nThere are " << matchingTextbooks.size() << " Textbook(s) with this title or author:\n" << endl;
-                    // Loop to display details of all Textbooks of matching title or author
-                    for (int i = 0; i < matchingTextbooks.size(); i++) {
-                        
-                        matchingTextbooks[i]->displayTextbookDetails();
-                        matchingTextbooks[i]->displayAvailability();
-                        cout << "" << endl;
+        sum += digits[i] * ((i % 2 == 0) ? 1 : 3);
 
-                    }
+    }
+    return (10 - sum % 10) % 10;
 
-                }
-                
-            // Searching for Fiction Book
-            } else if (bookType == 2) {
+}
 
-                // Vector to store textbooks with matching authors
-                vector<FictionBook*> matchingFictionBooks;
-                
-                // Searching for Fiction Book by Title
-                if (searchChoice == 1) {
 
-                    // Declaring necessary variable
-                    string tempTitle;
+// Function to parse an ISBN-10 or ISBN-13 (hyphens and spaces are ignored; an ISBN-10 may end in X) and check its
+// check digit; returns false if it isn't a valid ISBN
+//  The key is the ISBN-13 as a 64 bit integer (ISBN-10s are converted to their 978 ISBN-13), so both forms of the
+//  same ISBN get the same key, keys hash well, and they sort in the same order as the ISBN-13s
+bool parseISBN(const string& text, uint64_t& key) {
 
-                    // Loop to go through Fiction Book vector
-                    //  Search for matching title
-                    for (int i = 0; i < fictionBookSection.size(); i++) {
+    // Collecting the digits
+    int digits[13];
+    int count = 0;
+    bool endsInX = false;
+    for (size_t i = 0; i < text.size(); i++) {
 
-                        tempTitle = fictionBookSection[i]->getTitle();
+        char c = text[i];
+        if (c == '-' || c == ' ') {
 
-                    // If match found, add it to list of matches
-                        if (title == tempTitle) {
+            continue;
 
-                            matchingFictionBooks.push_back(fictionBookSection[i]);
+        }
+        if (endsInX || count == 13) {
 
-                        }
+            return false;
 
-                    }
-                
-                // Searching for Fiction Book by Author
-                } else if (searchChoice == 2) {
+        }
+        if (c >= '0' && c <= '9') {
 
-                    // Declaring necessary variable
-                    string tempAuthor;
+            digits[count++] = c - '0';
 
-                    // Loop to go through Fiction Book vector
-                    //  Search for matching author
-                    for (int i = 0; i < fictionBookSection.size(); i++) {
+        } else if ((c == 'X' || c == 'x') && count == 9) {
 
-                        tempAuthor = fictionBookSection[i]->getAuthor();
+            digits[count++] = 10;
+            endsInX = true;
 
-                    // If match found, add it to list of matches
-                        if (author == tempAuthor) {
+        } else {
 
-                            matchingFictionBooks.push_back(fictionBookSection[i]);
+            return false;
 
-                        }
+        }
 
-                    }
-                    
-                }
+    }
 
-                // Throw error if no matches
-                if (matchingFictionBooks.size() == 0) {
+    // ISBN-10: weights 10 down to 1 must sum to a multiple of 11; then converted to an ISBN-13 starting with 978
+    if (count == 10) {
 
-                    throw bookNotFoundError();
-                
-                // Otherwise, display details
-                } else {
-                    
-                    cout << "\nThere are " << matchingFictionBooks.size() << " Fiction Book(s) with this title or author:\n" << endl;
-                    // Loop to display details of all Fiction Books of matching title or author
-                    for (int i = 0; i < matchingFictionBooks.size(); i++) {
-                        
-                        matchingFictionBooks[i]->displayFictionBookDetails();
-                        matchingFictionBooks[i]->displayAvailability();
-                        cout << "" << endl;
+        int sum = 0;
+        for (int i = 0; i < 10; i++) {
 
-                    }
+            sum += digits[i] * (10 - i);
 
-                }
-                
-            }
+        }
+        if (sum % 11 != 0) {
+
+            return false;
 
         }
+        int converted[13] = {9, 7, 8};
+        for (int i = 0; i < 9; i++) {
 
-        // Function to display all books
-        void displayBooks() {
+            converted[i + 3] = digits[i];
 
-            // Displaying Textbooks:
-            cout << "\nThere are " << textbookSection.size() << " Textbook(s):\n" << endl;
-            // Loop to display details of all Textbooks
-            for (int i = 0; i < textbookSection.size(); i++) {
-                        
-                textbookSection[i]->displayTextbookDetails();
-                textbookSection[i]->displayAvailability();
-                cout << "" << endl;
+        }
+        converted[12] = isbn13CheckDigit(converted);
+        memcpy(digits, converted, sizeof(converted));
 
-            }
+    // ISBN-13: must start with 978 or 979 and have the right check digit
+    } else if (count != 13 || digits[0] != 9 || digits[1] != 7 || (digits[2] != 8 && digits[2] != 9) ||
+               isbn13CheckDigit(digits) != digits[12]) {
 
-             // Displaying Fiction Books:
-            cout << "\nThere are " << fictionBookSection.size() << " Fiction Book(s):\n" << endl;
-            // Loop to display details of all Fiction Books
-            for (int i = 0; i < fictionBookSection.size(); i++) {
-                        
-                fictionBookSection[i]->displayFictionBookDetails();
-                fictionBookSection[i]->displayAvailability();
-                cout << "" << endl;
+        return false;
 
-            }
+    }
 
-        }
+    key = 0;
+    for (int i = 0; i < 13; i++) {
 
-        // Function to borrow or return a book
-        void borrowOrReturn(string title, string author, int bookType, int borrowOrReturnChoice) {
-            
-            // Declaring necessary variables
-            string tempTitle, tempAuthor;
-            int tempIndex;
-            bool tempAvailability;
-            //  Vector to store matching book indexes in case there are duplicates
-            vector<int> matchingBookIndexes;
+        key = key * 10 + (uint64_t) digits[i];
 
-            // For Textbooks:
-            if (bookType == 1) {
+    }
+    return true;
 
-                // Loop to go through Textbook vector
-                //  Search for matching title and author
-                for (int i = 0; i < textbookSection.size(); i++) {
+}
 
-                    tempTitle = textbookSection[i]->getTitle();
-                    tempAuthor = textbookSection[i]->getAuthor();
 
-                    // If match found, add it to list of matches/duplicates
-                    if ( (title == tempTitle) && (author == tempAuthor) ) {
-                        
-                        matchingBookIndexes.push_back(i);
+// Function to format an ISBN key as the 13 digits of its ISBN-13 (a plain catalog number is printed as it is)
+string formatISBN(uint64_t key) {
 
-                    }
+    if (key < 9780000000000ULL) {
 
-                }
+        return to_string(key);
 
-                // Throw error if no matches
-                if (matchingBookIndexes.size() == 0) {
+    }
+    string text(13, '0');
+    for (int i = 12; i >= 0; i--) {
 
-                    throw bookNotFoundError();
+        text[i] = char('0' + key % 10);
+        key /= 10;
 
-                // If we are borrowing a book...
-                } else if (borrowOrReturnChoice == 1) {
-                    
-                    // Loop to look through book matches/duplicates for an available one to borrow
-                    for (int i = 0; i < matchingBookIndexes.size(); i++) {
-                        
-                        // Checking if one of the matches/duplicates is available
-                        tempIndex = matchingBookIndexes[i];
-                        tempAvailability = textbookSection[tempIndex]->getAvailability();
-                        
-                        // If it is, stop loop early to borrow only that duplicate
-                        if (tempAvailability) {
+    }
+    return text;
 
-                            break;
+}
 
-                        }
 
-                    }
+// Function to validate a batch of ISBNs, setting keys[i] to the key of texts[i] (0 if it isn't valid); returns the
+// number of valid ISBNs
+//  Plain 13 digit ISBN-13s, the usual form in bulk imports, are checked 16 bytes at a time with SSE2: the digits
+//  are range checked, weighted for the checksum, and combined into the key with multiply-adds. Anything else
+//  (hyphens, ISBN-10s) goes through parseISBN.
+size_t validateISBNs(const vector<string>& texts, vector<uint64_t>& keys) {
 
-                    // If book available, update availability and comfirm success
-                    if (tempAvailability) {
+    // Declaring necessary variables
+    size_t valid = 0;
+    keys.assign(texts.size(), 0);
 
-                        textbookSection[tempIndex]->updateAvailability(false);
-                        cout << "\nThe book has been borrowed successfully!\n" << endl;
+#if defined(__SSE2__)
+    const __m128i zeroChar = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_setzero_si128();
+    // Digits sit in bytes 3 to 15 behind three '0' bytes, so byte 3 has weight 1, byte 4 weight 3, and so on
+    const __m128i checksumWeights = _mm_setr_epi16(0, 0, 0, 1, 3, 1, 3, 1);
+    const __m128i checksumWeightsHigh = _mm_setr_epi16(3, 1, 3, 1, 3, 1, 3, 1);
+    const __m128i pairWeights = _mm_setr_epi16(10, 1, 10, 1, 10, 1, 10, 1);
+    const __m128i quadWeights = _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1);
+#endif
 
-                    // Otherwise, throw error
-                    } else {
+    for (size_t i = 0; i < texts.size(); i++) {
 
-                        throw bookNotBorrowableError();
+        const string& text = texts[i];
+#if defined(__SSE2__)
+        if (text.size() == 13) {
 
-                    }
+            // Loading the digits behind three '0' bytes and checking they are all digits
+            char buffer[16] = {'0', '0', '0'};
+            memcpy(buffer + 3, text.data(), 13);
+            __m128i d = _mm_sub_epi8(_mm_loadu_si128((const __m128i*) buffer), zeroChar);
+            __m128i bad = _mm_or_si128(_mm_cmpgt_epi8(d, nine), _mm_cmplt_epi8(d, zero));
+            if (_mm_movemask_epi8(bad) == 0 && buffer[3] == '9' && buffer[4] == '7' && (buffer[5] == '8' || buffer[5] == '9')) {
 
-                // If we are returning a book...
-                } else if (borrowOrReturnChoice == 2) {
-                    
-                    // Loop to look through book matches/duplicates for an available one to return
-                    for (int i = 0; i < matchingBookIndexes.size(); i++) {
-                        
-                        // Checking if one of the matches/duplicates is not available
-                        tempIndex = matchingBookIndexes[i];
-                        tempAvailability = textbookSection[tempIndex]->getAvailability();
-                        
-                        // If it is not, stop loop early to return only that duplicate
-                        if (!tempAvailability) {
+                // Checksum: widening to 16 bits and multiply-adding with the weights
+                __m128i low = _mm_unpacklo_epi8(d, zero), high = _mm_unpackhi_epi8(d, zero);
+                __m128i sums = _mm_add_epi32(_mm_madd_epi16(low, checksumWeights), _mm_madd_epi16(high, checksumWeightsHigh));
+                sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+                sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+                if (_mm_cvtsi128_si32(sums) % 10 == 0) {
 
-                            break;
+                    // Key: digit pairs (10a + b), then groups of four digits (100ab + cd), then combined
+                    __m128i pairs = _mm_packs_epi32(_mm_madd_epi16(low, pairWeights), _mm_madd_epi16(high, pairWeights));
+                    __m128i quads = _mm_madd_epi16(pairs, quadWeights);
+                    uint32_t groups[4];
+                    _mm_storeu_si128((__m128i*) groups, quads);
+                    keys[i] = ((uint64_t) groups[0] * 10000 + groups[1]) * 100000000ULL + (uint64_t) groups[2] * 10000 + groups[3];
+                    valid++;
 
-                        }
+                }
+                continue;
 
-                    }
+            }
 
-                    // If book is not available, update availability and comfirm success
-                    if (!tempAvailability) {
+        }
+#endif
+        if (parseISBN(text, keys[i])) {
 
-                        textbookSection[tempIndex]->updateAvailability(true);
-                        cout << "\nThe book has been returned successfully!\n" << endl;
+            valid++;
 
-                    // Otherwise, throw error
-                    } else {
+        } else {
 
-                        throw bookNotReturnableError();
+            keys[i] = 0;
 
-                    }
+        }
 
-                }
+    }
+
+    return valid;
 
-            // For Fiction Books...
-            } else if (bookType == 2) {
+}
 
-                // Loop to go through Fiction Book vector
-                //  Search for matching title and author
-                for (int i = 0; i < fictionBookSection.size(); i++) {
 
-                    tempTitle = fictionBookSection[i]->getTitle();
-                    tempAuthor = fictionBookSection[i]->getAuthor();
+// MemoryComponent struct
+//  Heap memory one part of the catalog uses: the bytes it asked for, how many allocations they are in, and the bytes
+//  those allocations take once the allocator's header and rounding are added
+struct MemoryComponent {
+    string name;
+    size_t bytes;
+    size_t allocations;
+    size_t blockBytes;
+};
 
-                    // If match found, add it to list of matches/duplicates
-                    if ( (title == tempTitle) && (author == tempAuthor) ) {
-                        
-                        matchingBookIndexes.push_back(i);
 
-                    }
+// Function to estimate the bytes an allocation takes in the heap (glibc malloc: an 8 byte header, rounded up to a
+// multiple of 16, and at least 32)
+size_t heapBlockBytes(size_t requested) {
 
-                }
+    return max((size_t) 32, (requested + 8 + 15) & ~(size_t) 15);
 
-                // Throw error if no matches
-                if (matchingBookIndexes.size() == 0) {
+}
 
-                    throw bookNotFoundError();
 
-                // If we are borrowing a book...
-                } else if (borrowOrReturnChoice == 1) {
-                    
-                    // Loop to look through book matches/duplicates for an available one to borrow
-                    for (int i = 0; i < matchingBookIndexes.size(); i++) {
-                        
-                        // Checking if one of the matches/duplicates is available
-                        tempIndex = matchingBookIndexes[i];
-                        tempAvailability = fictionBookSection[tempIndex]->getAvailability();
-                        
-                        // If it is, stop loop early to borrow only that duplicate
-                        if (tempAvailability) {
+// Function to count one allocation in a component
+void countAllocation(MemoryComponent& c, size_t requested) {
 
-                            break;
+    if (requested == 0) {
 
-                        }
+        return;
+
+    }
+    c.bytes += requested;
+    c.allocations++;
+    c.blockBytes += heapBlockBytes(requested);
+
+}
+
+
+// Function to count a string's heap buffer, if it is too long to be stored inside the string object
+void countString(MemoryComponent& c, const string& s) {
+
+    const char* inside = (const char*) &s;
+    if (s.data() < inside || s.data() >= inside + sizeof(string)) {
+
+        countAllocation(c, s.capacity() + 1);
+
+    }
+
+}
+
+
+// Function to count a vector's buffer (not what its elements own)
+template <class T>
+void countVector(MemoryComponent& c, const vector<T>& v) {
+
+    countAllocation(c, v.capacity() * sizeof(T));
+
+}
+
+
+// Function to count a hash map's nodes and bucket array (not what its keys and values own)
+//  Each node is a pointer to the next node, the key and value, and the key's hash unless the key is an integer or a
+//  pointer; a map with one bucket keeps it inside the map object
+template <class Map>
+void countHashMap(MemoryComponent& c, const Map& m) {
+
+    typedef typename Map::key_type Key;
+    size_t node = sizeof(void*) + sizeof(typename Map::value_type) +
+                  ((is_integral<Key>::value || is_pointer<Key>::value) ? 0 : sizeof(size_t));
+    node = (node + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    c.bytes += m.size() * node;
+    c.allocations += m.size();
+    c.blockBytes += m.size() * heapBlockBytes(node);
+    if (m.bucket_count() > 1) {
+
+        countAllocation(c, m.bucket_count() * sizeof(void*));
+
+    }
+
+}
+
+
+// Tracking allocator hook (compiled in with -DLMS_TRACK_ALLOCATIONS)
+//  Replaces every global operator new and delete (plain, array, nothrow, aligned, and sized) to keep count of the
+//  bytes and allocations that are live, so the estimates of a memory report can be checked against what was really
+//  allocated. Each allocation carries a header holding its size: 16 bytes, or the alignment asked for if bigger.
+#ifdef LMS_TRACK_ALLOCATIONS
+atomic<size_t> trackedBytes(0), trackedAllocations(0);
+const size_t TRACKING_HEADER = 16;
+
+// Function to allocate a tracked block whose user part is aligned to alignment (0 for the default); nullptr if the
+// allocation fails
+//  The size is kept at the start of the block and the user part starts after the header, which is 16 bytes or the
+//  alignment if that is bigger, so the block is found again from the user pointer and the alignment alone
+void* trackedAllocate(size_t size, size_t alignment) {
+
+    size_t header = max(TRACKING_HEADER, alignment);
+    char* block;
+    if (alignment <= TRACKING_HEADER) {
+
+        block = (char*) malloc(size + header);
+
+    } else {
+
+        block = (char*) aligned_alloc(alignment, (size + header + alignment - 1) / alignment * alignment);
+
+    }
+    if (block == nullptr) {
+
+        return nullptr;
+
+    }
+    *(size_t*) block = size;
+    trackedBytes += size;
+    trackedAllocations++;
+    return block + header;
+
+}
+
+// Function to free a tracked block allocated with an alignment (0 for the default)
+void trackedFree(void* p, size_t alignment) {
+
+    if (p == nullptr) {
+
+        return;
+
+    }
+    char* block = (char*) p - max(TRACKING_HEADER, alignment);
+    trackedBytes -= *(size_t*) block;
+    trackedAllocations--;
+    free(block);
+
+}
+
+// Function to allocate a tracked block, throwing bad_alloc if the allocation fails
+void* trackedAllocateOrThrow(size_t size, size_t alignment) {
+
+    void* p = trackedAllocate(size, alignment);
+    if (p == nullptr) {
+
+        throw bad_alloc();
+
+    }
+    return p;
+
+}
+
+// Plain, array, nothrow, aligned, and sized forms of new and delete, so every allocation is counted whichever form
+// the standard library picks
+void* operator new(size_t size) {
+
+    return trackedAllocateOrThrow(size, 0);
+
+}
+
+void* operator new[](size_t size) {
+
+    return trackedAllocateOrThrow(size, 0);
+
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+
+    return trackedAllocate(size, 0);
+
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+
+    return trackedAllocate(size, 0);
+
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+
+    return trackedAllocateOrThrow(size, (size_t) alignment);
+
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+
+    return trackedAllocateOrThrow(size, (size_t) alignment);
+
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+
+    return trackedAllocate(size, (size_t) alignment);
+
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+
+    return trackedAllocate(size, (size_t) alignment);
+
+}
+
+
+void operator delete(void* p) noexcept {
+
+    trackedFree(p, 0);
+
+}
+
+void operator delete[](void* p) noexcept {
+
+    trackedFree(p, 0);
+
+}
+
+void operator delete(void* p, size_t) noexcept {
+
+    trackedFree(p, 0);
+
+}
+
+void operator delete[](void* p, size_t) noexcept {
+
+    trackedFree(p, 0);
+
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept {
+
+    trackedFree(p, 0);
+
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept {
+
+    trackedFree(p, 0);
+
+}
+
+void operator delete(void* p, align_val_t alignment) noexcept {
+
+    trackedFree(p, (size_t) alignment);
+
+}
+
+void operator delete[](void* p, align_val_t alignment) noexcept {
+
+    trackedFree(p, (size_t) alignment);
+
+}
+
+void operator delete(void* p, size_t, align_val_t alignment) noexcept {
+
+    trackedFree(p, (size_t) alignment);
+
+}
+
+void operator delete[](void* p, size_t, align_val_t alignment) noexcept {
+
+    trackedFree(p, (size_t) alignment);
+
+}
+
+void operator delete(void* p, align_val_t alignment, const nothrow_t&) noexcept {
+
+    trackedFree(p, (size_t) alignment);
+
+}
+
+void operator delete[](void* p, align_val_t alignment, const nothrow_t&) noexcept {
+
+    trackedFree(p, (size_t) alignment);
+
+}
+#endif
+
+
+// Function to check if the tracking allocator hook is compiled in
+bool allocationTrackingEnabled() {
+
+#ifdef LMS_TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+
+}
+
+
+// Function to return the bytes and the number of allocations live right now (0 without the tracking allocator hook)
+void trackedAllocationTotals(size_t& bytes, size_t& allocations) {
+
+#ifdef LMS_TRACK_ALLOCATIONS
+    bytes = trackedBytes.load();
+    allocations = trackedAllocations.load();
+#else
+    bytes = 0;
+    allocations = 0;
+#endif
+
+}
+
+
+// Functions to encode and decode compact binary records
+//  Unsigned integers are written as varints (7 bits per byte, low bits first), signed integers are zigzag encoded
+//  first so small negative numbers stay small, and strings are written as a varint length followed by their bytes
+void appendVarint(string& out, uint64_t value) {
+
+    while (value >= 0x80) {
+
+        out += char((value & 0x7F) | 0x80);
+        value >>= 7;
+
+    }
+    out += char(value);
+
+}
+
+void appendSignedVarint(string& out, int64_t value) {
+
+    appendVarint(out, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+
+}
+
+void appendString(string& out, const string& value) {
+
+    appendVarint(out, value.size());
+    out += value;
+
+}
+
+bool readVarint(const char*& p, const char* end, uint64_t& value) {
+
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+
+        uint8_t byte = (uint8_t) *p++;
+        value |= (uint64_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+
+            return true;
+
+        }
+
+    }
+    return false;
+
+}
+
+bool readSignedVarint(const char*& p, const char* end, int64_t& value) {
+
+    uint64_t zigzag;
+    if (!readVarint(p, end, zigzag)) {
+
+        return false;
+
+    }
+    value = (int64_t) (zigzag >> 1) ^ -(int64_t) (zigzag & 1);
+    return true;
+
+}
+
+bool readString(const char*& p, const char* end, string& value) {
+
+    uint64_t length;
+    if (!readVarint(p, end, length) || length > (uint64_t) (end - p)) {
+
+        return false;
+
+    }
+    value.assign(p, (size_t) length);
+    p += length;
+    return true;
+
+}
+
+
+// FrontCodedDictionary class
+//  Read-optimized, compressed set of strings. The strings are sorted and stored in blocks of 16: the first string of
+//  a block is stored in full and every other one as the length of the prefix it shares with the string before it,
+//  followed by the rest of its bytes. Equality and prefix lookups binary search the first strings of the blocks and
+//  then decode at most one block. Optionally, when every string is ASCII, the stored bytes are further compressed
+//  with a bigram codec: the 128 most common character pairs are replaced by the byte values 0x80 to 0xFF.
+class FrontCodedDictionary {
+
+    // Private members
+    private:
+        static const size_t BLOCK_SIZE = 16;
+        string data;
+        vector<uint32_t> blockOffsets;
+        size_t count;
+        bool useCodec;
+        char codecPairs[128][2];
+        //  Table from character pair to its code, or -1 (only used while building)
+        vector< vector<int> > pairCodes;
+
+        // Function to append the stored form of a string's bytes
+        void encode(const char* s, size_t n, string& out) {
+
+            if (!useCodec) {
+
+                out.append(s, n);
+                return;
+
+            }
+
+            // Loop to replace known character pairs greedily from left to right
+            for (size_t i = 0; i < n; i++) {
+
+                if (i + 1 < n) {
+
+                    int code = pairCodes[(uint8_t) s[i]][(uint8_t) s[i + 1]];
+                    if (code >= 0) {
+
+                        out += char(0x80 + code);
+                        i++;
+                        continue;
+
+                    }
+
+                }
+                out += s[i];
+
+            }
+
+        }
+
+        // Function to append the original bytes of a stored string
+        void decode(const char* p, size_t n, string& out) const {
+
+            if (!useCodec) {
+
+                out.append(p, n);
+                return;
+
+            }
+
+            for (size_t i = 0; i < n; i++) {
+
+                uint8_t b = (uint8_t) p[i];
+                if (b >= 0x80) {
+
+                    out.append(codecPairs[b - 0x80], 2);
+
+                } else {
+
+                    out += char(b);
+
+                }
+
+            }
+
+        }
+
+        // Function to decode the next string of a block into current (which holds the string before it)
+        const char* next(const char* p, string& current, bool firstInBlock) const {
+
+            uint64_t shared = 0, length;
+            if (!firstInBlock) {
+
+                readVarint(p, data.data() + data.size(), shared);
+
+            }
+            readVarint(p, data.data() + data.size(), length);
+            current.resize((size_t) shared);
+            decode(p, (size_t) length, current);
+            return p + length;
+
+        }
+
+        // Function to return the ID of the first string that is not less than value (count if there is none);
+        // the string itself is stored in found
+        size_t lowerBound(const string& value, string& found) const {
+
+            // Binary search for the last block whose first string is less than value
+            size_t low = 0, high = blockOffsets.size();
+            string head;
+            while (low < high) {
+
+                size_t middle = (low + high) / 2;
+                next(data.data() + blockOffsets[middle], head, true);
+                if (head < value) {
+
+                    low = middle + 1;
+
+                } else {
+
+                    high = middle;
+
+                }
+
+            }
+            if (low == 0) {
+
+                if (count > 0) {
+
+                    next(data.data(), found, true);
+
+                }
+                return 0;
+
+            }
+
+            // Loop to decode that block until a string that is not less than value
+            size_t block = low - 1;
+            const char* p = data.data() + blockOffsets[block];
+            size_t id = block * BLOCK_SIZE;
+            size_t blockEnd = min(count, id + BLOCK_SIZE);
+            for (; id < blockEnd; id++) {
+
+                p = next(p, found, id == block * BLOCK_SIZE);
+                if (!(found < value)) {
+
+                    return id;
+
+                }
+
+            }
+            if (id < count) {
+
+                next(p, found, true);
+
+            }
+            return id;
+
+        }
+
+    // Public member functions
+    public:
+
+        // Default constructor (empty dictionary)
+        FrontCodedDictionary() {
+
+            count = 0;
+            useCodec = false;
+
+        }
+
+        // Function to build the dictionary from a list of strings (duplicates are dropped); withCodec turns on the
+        // bigram codec, which is only used if every string is ASCII
+        void build(vector<string> values, bool withCodec) {
+
+            sort(values.begin(), values.end());
+            values.erase(unique(values.begin(), values.end()), values.end());
+            buildSorted(values, withCodec);
+
+        }
+
+        // Function to build the dictionary from a list of strings that is already sorted, without duplicates
+        void buildSorted(const vector<string>& values, bool withCodec) {
+
+            data.clear();
+            blockOffsets.clear();
+            count = values.size();
+            useCodec = false;
+
+            // Training the codec on character pair counts
+            if (withCodec) {
+
+                vector<uint32_t> pairCounts(128 * 128, 0);
+                bool ascii = true;
+                for (size_t i = 0; i < values.size() && ascii; i++) {
+
+                    const string& v = values[i];
+                    for (size_t j = 0; j < v.size(); j++) {
+
+                        if ((uint8_t) v[j] >= 0x80) {
+
+                            ascii = false;
+                            break;
+
+                        }
+                        if (j + 1 < v.size()) {
+
+                            pairCounts[(uint8_t) v[j] * 128 + (uint8_t) v[j + 1]]++;
+
+                        }
+
+                    }
+
+                }
+
+                if (ascii) {
+
+                    vector<uint32_t> order(pairCounts.size());
+                    for (size_t i = 0; i < order.size(); i++) {
+
+                        order[i] = (uint32_t) i;
+
+                    }
+                    partial_sort(order.begin(), order.begin() + 128, order.end(),
+                                 [&pairCounts](uint32_t a, uint32_t b) { return pairCounts[a] > pairCounts[b]; });
+
+                    pairCodes.assign(256, vector<int>(256, -1));
+                    for (int code = 0; code < 128 && pairCounts[order[code]] > 1; code++) {
+
+                        codecPairs[code][0] = char(order[code] / 128);
+                        codecPairs[code][1] = char(order[code] % 128);
+                        pairCodes[order[code] / 128][order[code] % 128] = code;
+
+                    }
+                    useCodec = true;
+
+                }
+
+            }
+
+            // Loop to write the blocks
+            string encoded;
+            for (size_t i = 0; i < values.size(); i++) {
+
+                encoded.clear();
+                if (i % BLOCK_SIZE == 0) {
+
+                    blockOffsets.push_back((uint32_t) data.size());
+                    encode(values[i].data(), values[i].size(), encoded);
+
+                } else {
+
+                    const string& previous = values[i - 1];
+                    size_t shared = 0;
+                    while (shared < previous.size() && shared < values[i].size() && previous[shared] == values[i][shared]) {
+
+                        shared++;
+
+                    }
+                    appendVarint(data, shared);
+                    encode(values[i].data() + shared, values[i].size() - shared, encoded);
+
+                }
+                appendVarint(data, encoded.size());
+                data += encoded;
+
+            }
+
+            data.shrink_to_fit();
+            blockOffsets.shrink_to_fit();
+            pairCodes.clear();
+            pairCodes.shrink_to_fit();
+
+        }
+
+        // Function to return the number of strings
+        size_t size() const {
+
+            return count;
+
+        }
+
+        // Function to return the ID of a string, or -1 if it isn't in the dictionary
+        long find(const string& value) const {
+
+            string found;
+            size_t id = lowerBound(value, found);
+            if (id < count && found == value) {
+
+                return (long) id;
+
+            }
+            return -1;
+
+        }
+
+        // Function to return the range of IDs [first, last) of the strings that start with prefix
+        void prefixRange(const string& prefix, size_t& first, size_t& last) const {
+
+            string found;
+            first = lowerBound(prefix, found);
+
+            // The range ends at the first string not less than the prefix with its last byte incremented
+            string after = prefix;
+            while (!after.empty() && (uint8_t) after.back() == 0xFF) {
+
+                after.pop_back();
+
+            }
+            if (after.empty()) {
+
+                last = count;
+                return;
+
+            }
+            after.back() = char((uint8_t) after.back() + 1);
+            last = lowerBound(after, found);
+
+        }
+
+        // Function to return the string with a given ID
+        string lookup(size_t id) const {
+
+            string current;
+            size_t block = id / BLOCK_SIZE;
+            const char* p = data.data() + blockOffsets[block];
+            for (size_t i = block * BLOCK_SIZE; i <= id; i++) {
+
+                p = next(p, current, i == block * BLOCK_SIZE);
+
+            }
+            return current;
+
+        }
+
+        // Function to check if the string with a given ID is value, decoding its block into a buffer of the caller's
+        // so a check allocates nothing once the buffer is big enough
+        bool equals(size_t id, const string& value, string& buffer) const {
+
+            size_t block = id / BLOCK_SIZE;
+            const char* p = data.data() + blockOffsets[block];
+            for (size_t i = block * BLOCK_SIZE; i <= id; i++) {
+
+                p = next(p, buffer, i == block * BLOCK_SIZE);
+
+            }
+            return buffer == value;
+
+        }
+
+        // Function to visit the strings with IDs in [first, last) in order, decoding each block once
+        void forEach(size_t first, size_t last, function<void(size_t, const string&)> visit) const {
+
+            string current;
+            last = min(last, count);
+            if (first >= last) {
+
+                return;
+
+            }
+            size_t block = first / BLOCK_SIZE;
+            const char* p = data.data() + blockOffsets[block];
+            for (size_t id = block * BLOCK_SIZE; id < last; id++) {
+
+                p = next(p, current, id % BLOCK_SIZE == 0);
+                if (id >= first) {
+
+                    visit(id, current);
+
+                }
+
+            }
+
+        }
+
+        // Function to return the number of bytes the dictionary uses
+        size_t memoryUsage() const {
+
+            return sizeof(*this) + data.capacity() + blockOffsets.capacity() * sizeof(uint32_t);
+
+        }
+
+        // Function to count the heap memory the encoded strings and block offsets use
+        void countMemory(MemoryComponent& c) const {
+
+            countString(c, data);
+            countVector(c, blockOffsets);
+            countVector(c, pairCodes);
+            for (size_t i = 0; i < pairCodes.size(); i++) {
+
+                countVector(c, pairCodes[i]);
+
+            }
+
+        }
+
+};
+
+
+// KeyDictionary class
+//  Shared store of the normalized titles (or authors) of every book, so a book holds a 4 byte ID per key in place of a
+//  string. Most keys are in a FrontCodedDictionary, sorted and front coded (without the bigram codec, since keys are
+//  decoded on every borrow and return); keys added since it was built go into a small unsorted delta, which is merged
+//  into it in one pass once the delta outgrows an eighth of it, rather than re-sorting every key when one is added.
+//  A key's ID never changes, so a merge doesn't touch the books holding it: each ID maps to its key's position in the
+//  sorted part or in the delta. Each ID counts the books holding it; keys no book holds any more are dropped at the
+//  next merge and their IDs reused. Books are created, read, and deleted on several threads at once (shard workers,
+//  batch query workers, export workers), so adding and releasing keys takes the lock exclusively and reading shares it.
+class KeyDictionary {
+
+    // Private members
+    private:
+        static constexpr uint32_t IN_DELTA = 0x80000000;
+        static constexpr uint32_t FREE = 0xFFFFFFFF;
+        static constexpr size_t MIN_MERGE_SIZE = 256;
+        mutable shared_mutex lock;
+        //  The sorted keys, and the ID of the key at each position
+        FrontCodedDictionary sorted;
+        vector<uint32_t> sortedIDs;
+        //  The keys added since the last merge with their IDs, and each one's key by position (pointing into delta)
+        unordered_map<string, uint32_t> delta;
+        vector<const string*> deltaKeys;
+        //  By ID: the key's position in the sorted part (or IN_DELTA and its position in the delta, or FREE), and the
+        //  number of books holding it
+        vector<uint32_t> locations;
+        vector<uint32_t> references;
+        vector<uint32_t> freeIDs;
+
+        // Function to return the ID of a key, or FREE if it isn't held (the lock must be held)
+        uint32_t findLocked(const string& key) const {
+
+            unordered_map<string, uint32_t>::const_iterator added = delta.find(key);
+            if (added != delta.end()) {
+
+                return added->second;
+
+            }
+            long position = sorted.find(key);
+            return (position < 0) ? FREE : sortedIDs[position];
+
+        }
+
+        // Function to merge the delta into the sorted part, dropping the keys no book holds (the lock must be held)
+        void merge() {
+
+            // Sorting the delta's keys that are still held, and freeing the IDs of the rest
+            vector< pair<const string*, uint32_t> > added;
+            for (unordered_map<string, uint32_t>::iterator entry = delta.begin(); entry != delta.end(); entry++) {
+
+                if (references[entry->second] > 0) {
+
+                    added.push_back(make_pair(&entry->first, entry->second));
+
+                } else {
+
+                    locations[entry->second] = FREE;
+                    freeIDs.push_back(entry->second);
+
+                }
+
+            }
+            sort(added.begin(), added.end(), [](const pair<const string*, uint32_t>& a, const pair<const string*, uint32_t>& b) {
+
+                return *a.first < *b.first;
+
+            });
+
+            // Merging them with the sorted keys in one pass
+            vector<string> keys;
+            vector<uint32_t> ids;
+            keys.reserve(sorted.size() + added.size());
+            ids.reserve(sorted.size() + added.size());
+            size_t next = 0;
+            sorted.forEach(0, sorted.size(), [&](size_t position, const string& key) {
+
+                while (next < added.size() && *added[next].first < key) {
+
+                    keys.push_back(*added[next].first);
+                    ids.push_back(added[next].second);
+                    next++;
+
+                }
+                uint32_t id = sortedIDs[position];
+                if (references[id] > 0) {
+
+                    keys.push_back(key);
+                    ids.push_back(id);
+
+                } else {
+
+                    locations[id] = FREE;
+                    freeIDs.push_back(id);
+
+                }
+
+            });
+            for (; next < added.size(); next++) {
+
+                keys.push_back(*added[next].first);
+                ids.push_back(added[next].second);
+
+            }
+
+            // Rebuilding the sorted part and pointing every ID at its new position
+            sorted.buildSorted(keys, false);
+            ids.shrink_to_fit();
+            sortedIDs.swap(ids);
+            for (size_t position = 0; position < sortedIDs.size(); position++) {
+
+                locations[sortedIDs[position]] = (uint32_t) position;
+
+            }
+            delta.clear();
+            deltaKeys.clear();
+
+        }
+
+    // Public member functions
+    public:
+
+        // Function to add a reference to a key, returning its ID (a new key gets an ID in the delta)
+        uint32_t add(const string& key) {
+
+            unique_lock<shared_mutex> guard(lock);
+            uint32_t id = findLocked(key);
+            if (id == FREE) {
+
+                if (freeIDs.empty()) {
+
+                    id = (uint32_t) locations.size();
+                    locations.push_back(FREE);
+                    references.push_back(0);
+
+                } else {
+
+                    id = freeIDs.back();
+                    freeIDs.pop_back();
+
+                }
+                unordered_map<string, uint32_t>::iterator entry = delta.insert(make_pair(key, id)).first;
+                locations[id] = IN_DELTA | (uint32_t) deltaKeys.size();
+                deltaKeys.push_back(&entry->first);
+
+            }
+            references[id]++;
+
+            // Merging once the delta has grown past an eighth of the sorted keys
+            if (delta.size() > max(MIN_MERGE_SIZE, sorted.size() / 8)) {
+
+                merge();
+
+            }
+            return id;
+
+        }
+
+        // Function to drop a reference to a key (the key stays until the next merge)
+        void release(uint32_t id) {
+
+            unique_lock<shared_mutex> guard(lock);
+            references[id]--;
+
+        }
+
+        // Function to return the ID of a key, or -1 if no book has ever held it since the last merge
+        long find(const string& key) const {
+
+            shared_lock<shared_mutex> guard(lock);
+            uint32_t id = findLocked(key);
+            return (id == FREE) ? -1 : (long) id;
+
+        }
+
+        // Function to return the key with an ID
+        string lookup(uint32_t id) const {
+
+            shared_lock<shared_mutex> guard(lock);
+            uint32_t location = locations[id];
+            if (location & IN_DELTA) {
+
+                return *deltaKeys[location & ~IN_DELTA];
+
+            }
+            return sorted.lookup(location);
+
+        }
+
+        // Function to check if the key with an ID is key, decoding into a buffer of the caller's
+        bool equals(uint32_t id, const string& key, string& buffer) const {
+
+            shared_lock<shared_mutex> guard(lock);
+            uint32_t location = locations[id];
+            if (location & IN_DELTA) {
+
+                return *deltaKeys[location & ~IN_DELTA] == key;
+
+            }
+            return sorted.equals(location, key, buffer);
+
+        }
+
+        // Function to visit the ID and key of every key that starts with a prefix, in sorted order
+        void forEachWithPrefix(const string& prefix, function<void(uint32_t, const string&)> visit) const {
+
+            shared_lock<shared_mutex> guard(lock);
+
+            // The delta's matches, sorted, are visited in step with the sorted part's range
+            vector<const string*> added;
+            for (size_t i = 0; i < deltaKeys.size(); i++) {
+
+                if (deltaKeys[i]->compare(0, prefix.size(), prefix) == 0) {
+
+                    added.push_back(deltaKeys[i]);
+
+                }
+
+            }
+            sort(added.begin(), added.end(), [](const string* a, const string* b) { return *a < *b; });
+            size_t first, last, next = 0;
+            sorted.prefixRange(prefix, first, last);
+            sorted.forEach(first, last, [&](size_t position, const string& key) {
+
+                while (next < added.size() && *added[next] < key) {
+
+                    visit(delta.find(*added[next])->second, *added[next]);
+                    next++;
+
+                }
+                visit(sortedIDs[position], key);
+
+            });
+            for (; next < added.size(); next++) {
+
+                visit(delta.find(*added[next])->second, *added[next]);
+
+            }
+
+        }
+
+        // Function to return the number of keys held in the sorted part and in the delta
+        size_t size() const {
+
+            shared_lock<shared_mutex> guard(lock);
+            return sorted.size() + delta.size();
+
+        }
+
+        // Function to count the heap memory of the keys and the ID tables
+        void countMemory(MemoryComponent& c) const {
+
+            shared_lock<shared_mutex> guard(lock);
+            sorted.countMemory(c);
+            countVector(c, sortedIDs);
+            countHashMap(c, delta);
+            for (unordered_map<string, uint32_t>::const_iterator entry = delta.begin(); entry != delta.end(); entry++) {
+
+                countString(c, entry->first);
+
+            }
+            countVector(c, deltaKeys);
+            countVector(c, locations);
+            countVector(c, references);
+            countVector(c, freeIDs);
+
+        }
+
+};
+
+// The dictionaries every book's title key and author key are kept in
+KeyDictionary bookTitleKeys, bookAuthorKeys;
+
+
+// KeyMatcher class
+//  Checks the dictionary IDs of books against one key, comparing the key with each distinct ID once: the books in a
+//  search index list almost always share their title (or author) ID, so matching a list costs one comparison rather
+//  than one per book, and no dictionary search is needed to turn the key into an ID first
+class KeyMatcher {
+
+    // Private members
+    private:
+        const KeyDictionary& dictionary;
+        const string& key;
+        long matchingID, otherID;
+        string buffer;
+
+    // Public member functions
+    public:
+
+        // Constructor with the dictionary and the key to match
+        KeyMatcher(const KeyDictionary& keys, const string& value) : dictionary(keys), key(value) {
+
+            matchingID = -1;
+            otherID = -1;
+
+        }
+
+        // Function to check if an ID is the key's
+        bool matches(uint32_t id) {
+
+            if ((long) id == matchingID) {
+
+                return true;
+
+            }
+            if ((long) id == otherID) {
+
+                return false;
+
+            }
+            bool match = dictionary.equals(id, key, buffer);
+            (match ? matchingID : otherID) = (long) id;
+            return match;
+
+        }
+
+};
+
+
+// BookDetails struct
+//  Cold part of a book: the fields only displays and statistics read. The last two fields are the course and edition
+//  of a Textbook, or the main character and setting of a Fiction Book
+struct BookDetails {
+    string genre;
+    string field1;
+    string field2;
+};
+
+
+// DetailFile class
+//  File that the details of many books are paged out to. Details are appended while the file is being written, then
+//  the file is memory-mapped read-only (or read into memory where mapping isn't available) and details are decoded
+//  from it on demand. Each record is three strings, each a 4 byte length followed by its bytes. Every detail file is
+//  created under a name of its own (the path given plus a unique suffix), so paging out twice to the same path never
+//  truncates a file that is still in use, and it is deleted as soon as it is mapped or read back; the mapping lasts
+//  until the last book using it is gone.
+class DetailFile {
+
+    // Private members
+    private:
+        string path;
+        ofstream writer;
+        uint64_t written;
+        const char* data;
+        size_t size;
+        bool mapped;
+        string contents;
+        bool onDisk;
+
+        // Function to delete the file, once it has been mapped or read back (or has failed)
+        void removeFile() {
+
+            if (onDisk) {
+
+                remove(path.c_str());
+                onDisk = false;
+
+            }
+
+        }
+
+        // Function to append one string with its length in front
+        void appendField(const string& value) {
+
+            uint32_t length = (uint32_t) value.size();
+            writer.write((const char*) &length, sizeof(length));
+            writer.write(value.data(), length);
+            written += sizeof(length) + length;
+
+        }
+
+        // Function to decode one string and move past it
+        string readField(uint64_t& offset) const {
+
+            uint32_t length;
+            memcpy(&length, data + offset, sizeof(length));
+            offset += sizeof(length);
+            string value(data + offset, length);
+            offset += length;
+            return value;
+
+        }
+
+    // Public member functions
+    public:
+
+        // Constructor with the path to create the file at; a unique suffix is added to it, and no existing file is touched
+        DetailFile(string filePath) {
+
+            written = 0;
+            data = nullptr;
+            size = 0;
+            mapped = false;
+            onDisk = false;
+
+#if defined(__unix__) || defined(__APPLE__)
+            // Creating a new file with a unique name (mkstemp never opens an existing file)
+            path = filePath + ".XXXXXX";
+            int fd = mkstemp(&path[0]);
+            if (fd < 0) {
+
+                return;
+
+            }
+            close(fd);
+#else
+            // Numbering the files of this process, so no two detail files share a name
+            static atomic<uint64_t> nextFile(0);
+            path = filePath + "." + to_string(nextFile++);
+#endif
+            onDisk = true;
+            writer.open(path.c_str(), ios::binary | ios::trunc);
+
+        }
+
+        // Destructor; unmaps the file, and deletes it if it is still there
+        ~DetailFile() {
+
+#if defined(__unix__) || defined(__APPLE__)
+            if (mapped) {
+
+                munmap((void*) data, size);
+
+            }
+#endif
+            writer.close();
+            removeFile();
+
+        }
+
+        // Function to check if the file could be opened for writing
+        bool isOpen() {
+
+            return writer.is_open();
+
+        }
+
+        // Function to append a book's details; returns the offset to read them back from
+        uint64_t append(const BookDetails& details) {
+
+            uint64_t offset = written;
+            appendField(details.genre);
+            appendField(details.field1);
+            appendField(details.field2);
+            return offset;
+
+        }
+
+        // Function to finish writing and map the file for reading; returns false if it couldn't be read back
+        bool finish() {
+
+            writer.close();
+            if (writer.fail()) {
+
+                return false;
+
+            }
+
+#if defined(__unix__) || defined(__APPLE__)
+            // Mapping the file, so the operating system pages details in and out as they are used
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd >= 0) {
+
+                if (written > 0) {
+
+                    void* view = mmap(nullptr, (size_t) written, PROT_READ, MAP_SHARED, fd, 0);
+                    if (view != MAP_FAILED) {
+
+                        data = (const char*) view;
+                        size = (size_t) written;
+                        mapped = true;
+
+                    }
+
+                }
+                close(fd);
+                if (mapped || written == 0) {
+
+                    // The mapping keeps the pages readable after the file's name is gone
+                    removeFile();
+                    return true;
+
+                }
+
+            }
+#endif
+
+            // Otherwise, reading the whole file into memory
+            ifstream reader(path.c_str(), ios::binary);
+            contents.assign((size_t) written, '\0');
+            if (!reader.read(&contents[0], contents.size())) {
+
+                return false;
+
+            }
+            reader.close();
+            removeFile();
+            data = contents.data();
+            size = contents.size();
+            return true;
+
+        }
+
+        // Function to read back the details appended at an offset
+        BookDetails read(uint64_t offset) const {
+
+            BookDetails details;
+            details.genre = readField(offset);
+            details.field1 = readField(offset);
+            details.field2 = readField(offset);
+            return details;
+
+        }
+
+        // Function to return the number of bytes written to the file
+        uint64_t getSize() {
+
+            return written;
+
+        }
+
+        // Function to check if the file is memory-mapped (rather than read into memory)
+        bool isMapped() {
+
+            return mapped;
+
+        }
+
+        // Function to count the heap memory the file object uses (make_shared allocates it with its reference counts),
+        // including its contents if the file was read into memory rather than mapped
+        void countMemory(MemoryComponent& c) {
+
+            countAllocation(c, sizeof(DetailFile) + 2 * sizeof(void*));
+            countString(c, path);
+            countString(c, contents);
+
+        }
+
+        // Function to return the number of bytes of the file that are memory-mapped (0 if it was read into memory)
+        size_t getMappedSize() {
+
+            return mapped ? size : 0;
+
+        }
+
+};
+
+
+// Book base class
+//  Split into a hot part (the fields searches, borrowing, and returning use) kept in the object, and a cold part
+//  (genre and the fields of each type) kept in a separate allocation, or in a DetailFile once paged out
+//  Every book carries its type tag (1 for Textbooks, 2 for Fiction Books), so code handling books of any type can
+//  look up what it needs in BOOK_TYPES instead of being written once per type
+//  The normalized title and author (the keys every comparison uses) are held as IDs in bookTitleKeys and
+//  bookAuthorKeys, so books with the same author share one copy of its key and the keys are stored front coded
+//  Books are created as their subclass and deleted through Book pointers, so the destructor is virtual; with its vtable
+//  pointer and the two key IDs in place of two strings, the object is 128 bytes
+class Book {
+    
+    // Private members
+    private:
+        //  Dictionary IDs of the normalized title and author; first, so a scan touches as few cache lines as possible
+        uint32_t titleID, authorID;
+        uint64_t isbn;
+        bool availability;
+        uint8_t bookType;
+        string title, author;
+        //  Cold details, either in memory or at an offset in a detail file
+        unique_ptr<BookDetails> details;
+        shared_ptr<DetailFile> detailFile;
+        uint64_t detailOffset;
+    
+    // Public member functions
+    public:
+
+        // Exception classes (each subclass's are kinds of these, so a book of any type can be caught as a Book's):
+        //  Exception class to handle empty string
+        class emptyStringError {};
+        
+        // Constructor with arguments (the book's type tag, the ISBN key, the genre, and the two fields of the book's
+        // type); the ISBN is taken as it is, so it is checked once where it is read in (see parseISBN)
+        Book(int type, string t, string a, uint64_t i, string g, string f1, string f2) {
+            
+            bookType = (uint8_t) type;
+            title = t;
+            author = a;
+            titleID = bookTitleKeys.add(normalizeKey(t));
+            authorID = bookAuthorKeys.add(normalizeKey(a));
+            isbn = i;
+            availability = true;
+            details.reset(new BookDetails());
+            details->genre = g;
+            details->field1 = f1;
+            details->field2 = f2;
+            detailOffset = 0;
+
+        }
+
+        // Destructor; releases the book's keys
+        virtual ~Book() {
+
+            bookTitleKeys.release(titleID);
+            bookAuthorKeys.release(authorID);
+
+        }
+
+        // Function to display book details
+        void displayBookDetails() {
+            
+            cout << "\t" << title << " is made by " << author << "; its genre is " << getGenre() << "." << endl;
+            cout << "\tIts ISBN is " << formatISBN(isbn) << "." << endl;
+
+        }
+
+        // Function to display a book's availability
+        void displayAvailability() {
+            
+            if (availability) {
+                cout << "\t" << title << " is available." << endl;
+            } else {
+                cout << "\t" << title << " is not available." << endl;
+            }
+
+        }
+
+        // Function to update a book's availability
+        void updateAvailability(bool av) {
+
+            availability = av;
+
+        }
+
+        // Function to return a book's type tag
+        int getType() {
+
+            return bookType;
+
+        }
+
+        // Function to return a book's title
+        const string& getTitle() {
+
+            return title;
+
+        }
+
+        // Function to return a book's author
+        const string& getAuthor() {
+
+            return author;
+            
+        }
+
+        // Function to return a book's normalized title (decoded from the title dictionary)
+        string getTitleKey() {
+
+            return bookTitleKeys.lookup(titleID);
+
+        }
+
+        // Function to return a book's normalized author (decoded from the author dictionary)
+        string getAuthorKey() {
+
+            return bookAuthorKeys.lookup(authorID);
+
+        }
+
+        // Function to return the dictionary ID of a book's normalized title
+        uint32_t getTitleID() {
+
+            return titleID;
+
+        }
+
+        // Function to return the dictionary ID of a book's normalized author
+        uint32_t getAuthorID() {
+
+            return authorID;
+
+        }
+
+        // Function to return a book's ISBN (the key parseISBN returns for a real ISBN, or a plain catalog number)
+        uint64_t getISBN() {
+
+            return isbn;
+
+        }
+
+        // Function to get a book's availability
+        bool getAvailability() {
+
+            return availability;
+
+        }
+
+        // Function to return a book's cold details, reading them from the detail file if they have been paged out
+        BookDetails getDetails() {
+
+            if (details) {
+
+                return *details;
+
+            }
+            return detailFile->read(detailOffset);
+
+        }
+
+        // Function to copy a book's cold details into d, reusing the buffers of d's strings (read from the detail file if
+        // they have been paged out)
+        void readDetails(BookDetails& d) {
+
+            if (details) {
+
+                d.genre = details->genre;
+                d.field1 = details->field1;
+                d.field2 = details->field2;
+
+            } else {
+
+                d = detailFile->read(detailOffset);
+
+            }
+
+        }
+
+        // Function to return a book's genre
+        string getGenre() {
+
+            return getDetails().genre;
+
+        }
+
+        // Function to move a book's details out of memory to where they were appended in a detail file
+        void pageOutDetails(shared_ptr<DetailFile> file, uint64_t offset) {
+
+            detailFile = file;
+            detailOffset = offset;
+            details.reset();
+
+        }
+
+        // Function to check if a book's details have been paged out
+        bool detailsPagedOut() {
+
+            return !details;
+
+        }
+
+        // Function to count the heap memory a book's strings and in-memory details use (not the book object itself)
+        void countMemory(MemoryComponent& strings, MemoryComponent& cold) {
+
+            countString(strings, title);
+            countString(strings, author);
+            if (details) {
+
+                countAllocation(cold, sizeof(BookDetails));
+                countString(strings, details->genre);
+                countString(strings, details->field1);
+                countString(strings, details->field2);
+
+            }
+
+        }
+
+        // Function to return the detail file a book's details were paged out to (nullptr if they are in memory)
+        DetailFile* getDetailFile() {
+
+            return details ? nullptr : detailFile.get();
+
+        }
+
+};
+
+
+// Textbook class derived from Book base class
+class Textbook : public Book {
+
+    // Public member functions
+    public:
+        
+        // Exception classes:
+        //  Exception class to handle empty string
+        class emptyStringError : public Book::emptyStringError {};
+
+        // Constructor with arguments; also calls base constructor with arguments
+        Textbook(string t, string a, uint64_t i, string g, string c, string e) : Book(1, t, a, i, g, c, e) {
+            
+            // Throw exception if empty string
+            if (t == "" || a == "" || g == "" || c == "" || e == "") {
+                
+                throw emptyStringError();
+
+            }
+
+        }
+
+        // Function to display textbook details; also calls function to display book details from Book class
+        void displayTextbookDetails() {
+
+            BookDetails d = getDetails();
+            displayBookDetails();
+            cout << "\tThis is a Textbook. The Course it's for is " << d.field1 << " and the Edition is " << d.field2 << "." << endl;
+
+        }
+
+        // Function to return a textbook's course
+        string getCourse() {
+
+            return getDetails().field1;
+
+        }
+
+        // Function to return a textbook's edition
+        string getEdition() {
+
+            return getDetails().field2;
+
+        }
+
+};
+
+
+// FictionBook class derived from Book base class
+class FictionBook : public Book {
+
+    // Public member functions
+    public:
+
+        // Exception classes:
+        //  Exception class to handle empty string
+        class emptyStringError : public Book::emptyStringError {};
+
+        // Constructor with arguments; also calls base constructor with arguments
+        FictionBook(string t, string a, uint64_t i, string g, string m, string s) : Book(2, t, a, i, g, m, s) {
+            
+            // Throw exception if empty string
+            if (t == "" || a == "" || g == "" || m == "" || s == "") {
+                
+                throw emptyStringError();
+
+            }
+
+        }
+
+        // Function to display fiction book details; also calls function to display book details from Book class
+        void displayFictionBookDetails() {
+
+            BookDetails d = getDetails();
+            displayBookDetails();
+            cout << "\tThis is a Fiction Book. The Main Character is " << d.field1 << " and the setting is " << d.field2 << "." << endl;
+
+        }
+
+        // Function to return a fiction book's main character
+        string getMainCharacter() {
+
+            return getDetails().field1;
+
+        }
+
+        // Function to return a fiction book's setting
+        string getSetting() {
+
+            return getDetails().field2;
+
+        }
+        
+};
+
+// HoldQueue class
+//  FIFO of patron IDs waiting for a title. The IDs are stored back to back in one vector with a moving head index,
+//  so handing a copy to the next holder is O(1); a set of the waiting IDs makes checking for a duplicate hold O(1)
+//  too, so filling a queue with thousands of waiters stays linear
+class HoldQueue {
+
+    // Private members
+    private:
+        vector<int> patronIDs;
+        size_t head;
+        unordered_set<int> waiting;
+
+    // Public member functions
+    public:
+
+        // Default constructor
+        HoldQueue() {
+
+            head = 0;
+
+        }
+
+        // Function to add a patron to the back of the queue
+        void push(int patronID) {
+
+            patronIDs.push_back(patronID);
+            waiting.insert(patronID);
+
+        }
+
+        // Function to put a patron back at the front of the queue (a holder whose held copy was removed)
+        void pushFront(int patronID) {
+
+            if (head > 0) {
+
+                head--;
+                patronIDs[head] = patronID;
+
+            } else {
+
+                patronIDs.insert(patronIDs.begin(), patronID);
+
+            }
+            waiting.insert(patronID);
+
+        }
+
+        // Function to remove and return the patron at the front of the queue
+        int pop() {
+
+            int patronID = patronIDs[head];
+            head++;
+            waiting.erase(patronID);
+
+            // Once the queue is drained, or the already-served prefix is at least half of the storage,
+            // slide the remaining waiters down so memory stays proportional to the number of waiters
+            if (head == patronIDs.size()) {
+
+                patronIDs.clear();
+                head = 0;
+
+            } else if (head >= 32 && head * 2 >= patronIDs.size()) {
+
+                patronIDs.erase(patronIDs.begin(), patronIDs.begin() + head);
+                head = 0;
+
+            }
+
+            return patronID;
+
+        }
+
+        // Function to check if a patron is already waiting in the queue
+        bool contains(int patronID) {
+
+            return waiting.count(patronID) > 0;
+
+        }
+
+        // Function to return the number of waiting patrons
+        size_t size() {
+
+            return patronIDs.size() - head;
+
+        }
+
+        // Function to check if nobody is waiting
+        bool empty() {
+
+            return size() == 0;
+
+        }
+
+        // Function to count the heap memory the queue uses
+        void countMemory(MemoryComponent& c) {
+
+            countVector(c, patronIDs);
+            countHashMap(c, waiting);
+
+        }
+
+};
+
+
+// PatronIndex class
+//  Patron records are kept in one vector (12 bytes each) so hundreds of thousands of patrons stay cache friendly,
+//  and each patron's current loans form a linked list through a shared pool of 16 byte loan nodes. Checking the
+//  loan limit is O(1) and listing or finding a patron's loans only walks that patron's own list.
+class PatronIndex {
+
+    // Private members
+    private:
+
+        // Record for one patron
+        struct PatronRecord {
+            int id;
+            uint16_t loanCount;
+            uint16_t maxLoans;
+            uint32_t firstLoan;
+        };
+
+        // Node for one loan in a patron's list of loans
+        struct LoanNode {
+            Book* book;
+            uint32_t next;
+            uint32_t bookType;
+        };
+
+        vector<PatronRecord> patrons;
+        vector<LoanNode> loanNodes;
+        uint32_t freeLoanNodes;
+        unordered_map<int, uint32_t> patronSlots;
+        unordered_map<Book*, uint32_t> borrowerSlots;
+
+    // Public member functions
+    public:
+
+        // Value used for "no patron" and "end of loan list"
+        static const uint32_t NONE = 0xFFFFFFFF;
+
+        // Default constructor
+        PatronIndex() {
+
+            freeLoanNodes = NONE;
+
+        }
+
+        // Function to register a patron; returns false if the patron ID is already registered
+        bool registerPatron(int patronID, int maxLoans) {
+
+            if (patronSlots.count(patronID) != 0) {
+
+                return false;
+
+            }
+
+            PatronRecord record;
+            record.id = patronID;
+            record.loanCount = 0;
+            record.maxLoans = (uint16_t) maxLoans;
+            record.firstLoan = NONE;
+
+            patronSlots[patronID] = (uint32_t) patrons.size();
+            patrons.push_back(record);
+            return true;
+
+        }
+
+        // Function to find a patron's record index; returns NONE if the patron is not registered
+        uint32_t findPatron(int patronID) {
+
+            unordered_map<int, uint32_t>::iterator slot = patronSlots.find(patronID);
+            if (slot == patronSlots.end()) {
+
+                return NONE;
+
+            }
+
+            return slot->second;
+
+        }
+
+        // Function to check if a patron can borrow another book
+        bool canBorrow(uint32_t slot) {
+
+            return patrons[slot].loanCount < patrons[slot].maxLoans;
+
+        }
+
+        // Function to check if a patron can borrow a number of books at once
+        bool canBorrow(uint32_t slot, size_t count) {
+
+            return patrons[slot].loanCount + count <= patrons[slot].maxLoans;
+
+        }
+
+        // Function to return how many books a patron has on loan
+        int getLoanCount(uint32_t slot) {
+
+            return patrons[slot].loanCount;
+
+        }
+
+        // Function to return the record index of the patron who borrowed a book; returns NONE if nobody with a card did
+        uint32_t findBorrower(Book* b) {
+
+            unordered_map<Book*, uint32_t>::iterator borrower = borrowerSlots.find(b);
+            if (borrower == borrowerSlots.end()) {
+
+                return NONE;
+
+            }
+
+            return borrower->second;
+
+        }
+
+        // Function to add a book to the front of a patron's loan list
+        void addLoan(uint32_t slot, Book* b, int bookType) {
+
+            // Reusing a free node if there is one
+            uint32_t node;
+            if (freeLoanNodes != NONE) {
+
+                node = freeLoanNodes;
+                freeLoanNodes = loanNodes[node].next;
+
+            } else {
+
+                node = (uint32_t) loanNodes.size();
+                loanNodes.push_back(LoanNode());
+
+            }
+
+            loanNodes[node].book = b;
+            loanNodes[node].bookType = (uint32_t) bookType;
+            loanNodes[node].next = patrons[slot].firstLoan;
+            patrons[slot].firstLoan = node;
+            patrons[slot].loanCount++;
+            borrowerSlots[b] = slot;
+
+        }
+
+        // Function to remove a book from the loan list of whoever borrowed it; returns false if nobody with a card did
+        bool removeLoan(Book* b) {
+
+            uint32_t slot = findBorrower(b);
+            if (slot == NONE) {
+
+                return false;
+
+            }
+
+            // Loop to walk the patron's list, keeping track of the link that points at the current node
+            uint32_t* link = &patrons[slot].firstLoan;
+            while (*link != NONE) {
+
+                uint32_t node = *link;
+                if (loanNodes[node].book == b) {
+
+                    *link = loanNodes[node].next;
+                    loanNodes[node].book = nullptr;
+                    loanNodes[node].next = freeLoanNodes;
+                    freeLoanNodes = node;
+                    break;
+
+                }
+                link = &loanNodes[node].next;
+
+            }
+
+            patrons[slot].loanCount--;
+            borrowerSlots.erase(b);
+            return true;
+
+        }
+
+        // Function to find a book with matching normalized title and author in a patron's loan list; returns nullptr if none
+        Book* findLoan(uint32_t slot, const string& titleKey, const string& authorKey, int bookType) {
+
+            KeyMatcher title(bookTitleKeys, titleKey), author(bookAuthorKeys, authorKey);
+            for (uint32_t node = patrons[slot].firstLoan; node != NONE; node = loanNodes[node].next) {
+
+                Book* b = loanNodes[node].book;
+                if ( ((int) loanNodes[node].bookType == bookType) && title.matches(b->getTitleID()) && author.matches(b->getAuthorID()) ) {
+
+                    return b;
+
+                }
+
+            }
+
+            return nullptr;
+
+        }
+
+        // Function to collect a patron's loans along with their book types
+        void getLoans(uint32_t slot, vector<Book*>& books, vector<int>& bookTypes) {
+
+            for (uint32_t node = patrons[slot].firstLoan; node != NONE; node = loanNodes[node].next) {
+
+                books.push_back(loanNodes[node].book);
+                bookTypes.push_back((int) loanNodes[node].bookType);
+
+            }
+
+        }
+
+        // Function to count the heap memory the patron records, loan lists, and their indexes use
+        void countMemory(MemoryComponent& c) {
+
+            countVector(c, patrons);
+            countVector(c, loanNodes);
+            countHashMap(c, patronSlots);
+            countHashMap(c, borrowerSlots);
+
+        }
+
+};
+
+
+// SearchCacheMetrics struct
+//  Counters published by the search cache; bytes is an estimate of the memory the cached keys and results use
+struct SearchCacheMetrics {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t invalidations;
+    size_t entries;
+    size_t bytes;
+};
+
+
+// SearchCache class
+//  Bounded cache of search results keyed by book type, search field, and value, with CLOCK eviction: each slot has
+//  a reference bit that a hit sets, and the clock hand clears bits until it finds a slot that hasn't been used since
+//  its last pass. Results are stored as book pointers, so availability is always read from the book itself.
+class SearchCache {
+
+    // Private members
+    private:
+
+        // One cache slot
+        struct Entry {
+            string key;
+            vector<Book*> results;
+            bool referenced;
+            bool used;
+        };
+
+        vector<Entry> entries;
+        unordered_map<string, size_t> slots;
+        size_t hand;
+        SearchCacheMetrics metrics;
+
+        // Function to estimate the memory one entry uses outside of its slot (key and result buffers, map node)
+        static size_t entryBytes(const Entry& e) {
+
+            return e.key.capacity() + e.results.capacity() * sizeof(Book*) + sizeof(pair<const string, size_t>) + e.key.capacity() + 2 * sizeof(void*);
+
+        }
+
+        // Function to empty a slot
+        void release(size_t slot) {
+
+            metrics.bytes -= entryBytes(entries[slot]);
+            slots.erase(entries[slot].key);
+            entries[slot].key.clear();
+            entries[slot].key.shrink_to_fit();
+            entries[slot].results.clear();
+            entries[slot].results.shrink_to_fit();
+            entries[slot].used = false;
+            entries[slot].referenced = false;
+            metrics.entries--;
+
+        }
+
+    // Public member functions
+    public:
+
+        // Constructor with the maximum number of cached searches
+        SearchCache(size_t capacity) {
+
+            hand = 0;
+            metrics.hits = 0;
+            metrics.misses = 0;
+            metrics.evictions = 0;
+            metrics.invalidations = 0;
+            metrics.entries = 0;
+            metrics.bytes = 0;
+            resize(capacity);
+
+        }
+
+        // Function to change the maximum number of cached searches; this empties the cache
+        void resize(size_t capacity) {
+
+            clear();
+            entries.assign(capacity, Entry());
+            for (size_t i = 0; i < entries.size(); i++) {
+
+                entries[i].used = false;
+                entries[i].referenced = false;
+
+            }
+            metrics.bytes = entries.size() * sizeof(Entry);
+
+        }
+
+        // Function to look up cached results; returns false on a miss
+        bool lookup(const string& key, vector<Book*>& results) {
+
+            unordered_map<string, size_t>::iterator slot = slots.find(key);
+            if (slot == slots.end()) {
+
+                metrics.misses++;
+                return false;
+
+            }
+
+            metrics.hits++;
+            entries[slot->second].referenced = true;
+            results = entries[slot->second].results;
+            return true;
+
+        }
+
+        // Function to cache the results of a search, evicting a slot with the clock hand if the cache is full
+        void insert(const string& key, const vector<Book*>& results) {
+
+            if (entries.size() == 0 || slots.count(key) != 0) {
+
+                return;
+
+            }
+
+            // Loop to advance the hand, giving referenced slots a second chance
+            while (entries[hand].used && entries[hand].referenced) {
+
+                entries[hand].referenced = false;
+                hand = (hand + 1) % entries.size();
+
+            }
+
+            if (entries[hand].used) {
+
+                release(hand);
+                metrics.evictions++;
+
+            }
+
+            entries[hand].key = key;
+            entries[hand].results = results;
+            entries[hand].used = true;
+            entries[hand].referenced = false;
+            slots[key] = hand;
+            metrics.entries++;
+            metrics.bytes += entryBytes(entries[hand]);
+            hand = (hand + 1) % entries.size();
+
+        }
+
+        // Function to drop the cached results for a key, if there are any
+        void invalidate(const string& key) {
+
+            unordered_map<string, size_t>::iterator slot = slots.find(key);
+            if (slot != slots.end()) {
+
+                release(slot->second);
+                metrics.invalidations++;
+
+            }
+
+        }
+
+        // Function to drop every cached result
+        void clear() {
+
+            for (size_t i = 0; i < entries.size(); i++) {
+
+                if (entries[i].used) {
+
+                    release(i);
+
+                }
+
+            }
+            hand = 0;
+
+        }
+
+        // Function to return the cache metrics
+        SearchCacheMetrics getMetrics() {
+
+            return metrics;
+
+        }
+
+        // Function to count the heap memory the slots, cached keys and results, and the map of keys use
+        void countMemory(MemoryComponent& c) {
+
+            countVector(c, entries);
+            for (size_t i = 0; i < entries.size(); i++) {
+
+                countString(c, entries[i].key);
+                countVector(c, entries[i].results);
+
+            }
+            countHashMap(c, slots);
+            for (unordered_map<string, size_t>::iterator it = slots.begin(); it != slots.end(); it++) {
+
+                countString(c, it->first);
+
+            }
+
+        }
+
+};
+
+
+// Function to return the wall clock time in microseconds (comparable between processes on the same machine)
+int64_t wallClockMicros() {
+
+    return chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+
+}
+
+
+// BatchItem struct
+//  One book (type, title, and author) in a batch of books borrowed or returned together
+struct BatchItem {
+    int bookType;
+    string title;
+    string author;
+};
+
+
+// FacetFilter struct
+//  A filter over the facets of the books in every section: a term (op TERM) matches the books whose field has a value,
+//  and AND, OR, and NOT combine other filters. The fields are genre and the details BOOK_TYPES indexes (course,
+//  edition, and setting; matched by their normalized keys), type (the type tag: "1" for Textbooks, "2" for Fiction Books, or "0" for any type), and
+//  availability (value "1" for available copies or "0" for the rest).
+struct FacetFilter {
+    static const int TERM = 0, AND = 1, OR = 2, NOT = 3;
+    static const int GENRE = 1, COURSE = 2, EDITION = 3, SETTING = 4, TYPE = 5, AVAILABILITY = 6;
+    int op;
+    int field;
+    string value;
+    vector<FacetFilter> operands;
+};
+
+// The name of each facet field, by field
+const char* const FACET_FIELD_NAMES[7] = {"", "Genre", "Course", "Edition", "Setting", "Type", "Availability"};
+
+
+// Functions to build facet filters
+FacetFilter facetTerm(int field, string value) {
+
+    FacetFilter filter;
+    filter.op = FacetFilter::TERM;
+    filter.field = field;
+    filter.value = value;
+    return filter;
+
+}
+
+FacetFilter facetType(int bookType) {
+
+    return facetTerm(FacetFilter::TYPE, to_string(bookType));
+
+}
+
+FacetFilter facetAvailable() {
+
+    return facetTerm(FacetFilter::AVAILABILITY, "1");
+
+}
+
+// Function to combine two filters with AND or OR; a chain of the same operator stays one filter with more operands
+FacetFilter facetCombine(int op, const FacetFilter& a, const FacetFilter& b) {
+
+    FacetFilter filter;
+    if (a.op == op) {
+
+        filter = a;
+
+    } else {
+
+        filter.op = op;
+        filter.field = 0;
+        filter.operands.push_back(a);
+
+    }
+    filter.operands.push_back(b);
+    return filter;
+
+}
+
+FacetFilter facetAnd(const FacetFilter& a, const FacetFilter& b) {
+
+    return facetCombine(FacetFilter::AND, a, b);
+
+}
+
+FacetFilter facetOr(const FacetFilter& a, const FacetFilter& b) {
+
+    return facetCombine(FacetFilter::OR, a, b);
+
+}
+
+FacetFilter facetNot(const FacetFilter& a) {
+
+    FacetFilter filter;
+    filter.op = FacetFilter::NOT;
+    filter.field = 0;
+    filter.operands.push_back(a);
+    return filter;
+
+}
+
+
+// Function to create a book of one Book subclass from its fields (the two detail fields of its type last)
+template <class T>
+Book* newBook(string t, string a, uint64_t i, string g, string f1, string f2) {
+
+    return new T(t, a, i, g, f1, f2);
+
+}
+
+
+// BookTypeInfo struct
+//  What code handling books of any type needs to know about one type: its names, the prompts the menu asks for its
+//  two detail fields with, the wording they are displayed with, the names they are exported under, the facet each of
+//  them is indexed under (0 for none), the size of its objects, and how to create one. BOOK_TYPES holds one per type
+//  tag. The library, its indexes, the mutation log and trace records, replay, export, and the menus all go through
+//  this table; only each subclass's own getters are still written per type.
+struct BookTypeInfo {
+    const char* name;
+    const char* pluralName;
+    const char* exportName;
+    const char* field1Prompt;
+    const char* field2Prompt;
+    const char* field1Label;
+    const char* field2Label;
+    const char* field1Column;
+    const char* field2Column;
+    int field1Facet;
+    int field2Facet;
+    size_t objectSize;
+    Book* (*create)(string, string, uint64_t, string, string, string);
+};
+
+const int BOOK_TYPE_COUNT = 3;
+constexpr BookTypeInfo BOOK_TYPES[BOOK_TYPE_COUNT] = {
+    {"Book", "Books", "book", "", "", "", "", "", "", 0, 0, sizeof(Book), nullptr},
+    {"Textbook", "Textbooks", "textbook", "Course", "Edition", "This is a Textbook. The Course it's for is ", " and the Edition is ",
+     "course", "edition", FacetFilter::COURSE, FacetFilter::EDITION, sizeof(Textbook), newBook<Textbook>},
+    {"Fiction Book", "Fiction Books", "fiction", "Main Character", "Setting", "This is a Fiction Book. The Main Character is ", " and the setting is ",
+     "main_character", "setting", 0, FacetFilter::SETTING, sizeof(FictionBook), newBook<FictionBook>}
+};
+
+
+// Function to return the number of facet fields the facet index keeps: genre, and every field a type in BOOK_TYPES
+// indexes its details under
+constexpr int countFacetFields() {
+
+    int count = FacetFilter::GENRE;
+    for (int bookType = 0; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+        count = max(count, max(BOOK_TYPES[bookType].field1Facet, BOOK_TYPES[bookType].field2Facet));
+
+    }
+    return count;
+
+}
+
+const int FACET_FIELD_COUNT = countFacetFields();
+static_assert(FACET_FIELD_COUNT < FacetFilter::TYPE, "a type's facet field must come before the type and availability fields");
+
+
+// Function to return the facet fields the books of a type can be filtered by (genre, then the type's indexed details);
+// type 0 is any type, which only has genre
+vector<int> getFacetFields(int bookType) {
+
+    vector<int> fields(1, FacetFilter::GENRE);
+    if (bookType > 0 && bookType < BOOK_TYPE_COUNT) {
+
+        if (BOOK_TYPES[bookType].field1Facet != 0) {
+
+            fields.push_back(BOOK_TYPES[bookType].field1Facet);
+
+        }
+        if (BOOK_TYPES[bookType].field2Facet != 0) {
+
+            fields.push_back(BOOK_TYPES[bookType].field2Facet);
+
+        }
+
+    }
+    return fields;
+
+}
+
+
+// Function to create a book of a type tag from its fields; returns nullptr for a tag no type has
+Book* createBook(int bookType, string t, string a, uint64_t i, string g, string f1, string f2) {
+
+    if (bookType < 1 || bookType >= BOOK_TYPE_COUNT) {
+
+        return nullptr;
+
+    }
+    return BOOK_TYPES[bookType].create(t, a, i, g, f1, f2);
+
+}
+
+
+// Function to display the type-specific details of a book of a type
+void displayTypeDetails(int bookType, const string& field1, const string& field2) {
+
+    if (bookType != 0) {
+
+        cout << "\t" << BOOK_TYPES[bookType].field1Label << field1 << BOOK_TYPES[bookType].field2Label << field2 << "." << endl;
+
+    }
+
+}
+
+
+// Function to display a book's details the way its type does
+void displayDetails(Book* b) {
+
+    BookDetails d = b->getDetails();
+    b->displayBookDetails();
+    displayTypeDetails(b->getType(), d.field1, d.field2);
+
+}
+
+
+// MutationLog class
+//  Append-only log of every change made to a Library, written so follower processes can replay it. The file starts
+//  with "LMSLOG" and the format version (varint); each record after it is a varint length followed by the operation
+//  code, sequence number, wall clock timestamp, and the operation's arguments. Adds and removes carry the book's type
+//  tag, so one operation code covers every type. Version 2 introduced the header along with the type tags and the
+//  current operation codes, so a log without a header is from before them and can't be replayed.
+//  Records are flushed as soon as they are written so followers see them right away.
+class MutationLog {
+
+    // Private members
+    private:
+        ofstream file;
+        uint64_t nextSequence;
+        string record;
+
+        // Function to start a record
+        void begin(uint8_t op) {
+
+            record.clear();
+            record += char(op);
+            appendVarint(record, nextSequence);
+            appendSignedVarint(record, wallClockMicros());
+
+        }
+
+        // Function to write the finished record with its length in front
+        void commit() {
+
+            string framed;
+            framed.reserve(record.size() + 5);
+            appendVarint(framed, record.size());
+            framed += record;
+            file.write(framed.data(), framed.size());
+            file.flush();
+            nextSequence++;
+
+        }
+
+    // Public member functions
+    public:
+
+        // Operation codes
+        static const uint8_t OP_ADD_BOOK = 1;
+        static const uint8_t OP_REMOVE_BOOK = 2;
+        static const uint8_t OP_BORROW_OR_RETURN = 3;
+        static const uint8_t OP_REGISTER_PATRON = 4;
+        static const uint8_t OP_PLACE_HOLD = 5;
+        static const uint8_t OP_BORROW_OR_RETURN_BATCH = 6;
+
+        // Header: the magic string and the version of the record format
+        static constexpr const char* MAGIC = "LMSLOG";
+        static const uint64_t FORMAT_VERSION = 2;
+
+        // Constructor with the log file path and the sequence number of the next record (1 for a new log); a new or
+        // empty log is started with the header
+        MutationLog(string path, uint64_t firstSequence) : file(path.c_str(), ios::binary | ios::app) {
+
+            nextSequence = firstSequence;
+            ifstream existing(path.c_str(), ios::binary | ios::ate);
+            if (file.is_open() && (!existing.is_open() || existing.tellg() == 0)) {
+
+                string header = MAGIC;
+                appendVarint(header, FORMAT_VERSION);
+                file.write(header.data(), header.size());
+                file.flush();
+
+            }
+
+        }
+
+        // Function to check if the log file could be opened
+        bool isOpen() {
+
+            return file.is_open();
+
+        }
+
+        // Function to return the sequence number the next record will get
+        uint64_t getNextSequence() {
+
+            return nextSequence;
+
+        }
+
+        // Functions to log each kind of change
+        void logAdd(Book* b) {
+
+            BookDetails d = b->getDetails();
+            begin(OP_ADD_BOOK);
+            appendVarint(record, b->getType());
+            appendString(record, b->getTitle());
+            appendString(record, b->getAuthor());
+            appendSignedVarint(record, (int64_t) b->getISBN());
+            appendString(record, d.genre);
+            appendString(record, d.field1);
+            appendString(record, d.field2);
+            commit();
+
+        }
+        void logRemove(int bookType, const string& title, const string& author) {
+
+            begin(OP_REMOVE_BOOK);
+            appendVarint(record, bookType);
+            appendString(record, title);
+            appendString(record, author);
+            commit();
+
+        }
+        void logBorrowOrReturn(const string& title, const string& author, int bookType, int borrowOrReturnChoice, int patronID) {
+
+            begin(OP_BORROW_OR_RETURN);
+            appendString(record, title);
+            appendString(record, author);
+            appendVarint(record, bookType);
+            appendVarint(record, borrowOrReturnChoice);
+            appendSignedVarint(record, patronID);
+            commit();
+
+        }
+        void logBorrowOrReturnBatch(const vector<BatchItem>& items, int borrowOrReturnChoice, int patronID) {
+
+            begin(OP_BORROW_OR_RETURN_BATCH);
+            appendVarint(record, borrowOrReturnChoice);
+            appendSignedVarint(record, patronID);
+            appendVarint(record, items.size());
+            for (size_t i = 0; i < items.size(); i++) {
+
+                appendVarint(record, items[i].bookType);
+                appendString(record, items[i].title);
+                appendString(record, items[i].author);
+
+            }
+            commit();
+
+        }
+        void logRegisterPatron(int patronID, int maxLoans) {
+
+            begin(OP_REGISTER_PATRON);
+            appendSignedVarint(record, patronID);
+            appendSignedVarint(record, maxLoans);
+            commit();
+
+        }
+        void logPlaceHold(const string& title, const string& author, int bookType, int patronID) {
+
+            begin(OP_PLACE_HOLD);
+            appendString(record, title);
+            appendString(record, author);
+            appendVarint(record, bookType);
+            appendSignedVarint(record, patronID);
+            commit();
+
+        }
+
+};
+
+
+// TraceRecorder class
+//  Binary trace of the calls made to a Library, with their arguments, outcome, and timing, so a performance problem
+//  can be replayed later with a TraceReplayer. The file starts with "LMSTRACEv", the format version, and the wall
+//  clock time the trace started (varint microseconds); version 2 introduced the version along with the type tags and
+//  the current operation codes, so a trace starting "LMSTRACE" without it is from before them. Each record is the operation code, the nanoseconds from the previous call's start
+//  to this one's, the call's duration in nanoseconds, its outcome (0 if it returned, 1 if it threw), the length of its
+//  arguments, and the arguments, all varint encoded (a book is its type tag and fields, so adds and removes of every
+//  type share one code). Records are buffered and written 1 MB at a time, so tracing a call costs two clock reads and
+//  a few appends.
+//  Every public Library call is traced except these, which the recorder (single-threaded, like the mutation log) must
+//  not see: lookup, snapshot, getSectionSize, and getSectionBook, which are made from several threads at once (batch
+//  query workers, snapshot readers, and export workers), and attachMutationLog and attachTraceRecorder, which wire
+//  the library to its log and trace rather than act on it (a replay runs without either). Overloads that only forward
+//  to another (removeTextbook, registerPatron without a loan limit) are traced as the call they forward to.
+class TraceRecorder {
+
+    // Private members
+    private:
+        static const size_t FLUSH_SIZE = 1 << 20;
+        ofstream file;
+        string buffer;
+        string arguments;
+        chrono::steady_clock::time_point start;
+        int64_t lastStart;
+        int depth;
+        uint64_t calls;
+
+        // Functions to append one argument of each kind
+        void appendArgument(const string& value) {
+
+            appendString(arguments, value);
+
+        }
+        void appendArgument(int64_t value) {
+
+            appendSignedVarint(arguments, value);
+
+        }
+        void appendArgument(Book* b) {
+
+            BookDetails d = b->getDetails();
+            appendVarint(arguments, b->getType());
+            appendString(arguments, b->getTitle());
+            appendString(arguments, b->getAuthor());
+            appendSignedVarint(arguments, (int64_t) b->getISBN());
+            appendString(arguments, d.genre);
+            appendString(arguments, d.field1);
+            appendString(arguments, d.field2);
+
+        }
+        void appendArgument(const FacetFilter& filter) {
+
+            appendVarint(arguments, filter.op);
+            if (filter.op == FacetFilter::TERM) {
+
+                appendVarint(arguments, filter.field);
+                appendString(arguments, filter.value);
+                return;
+
+            }
+            appendVarint(arguments, filter.operands.size());
+            for (size_t i = 0; i < filter.operands.size(); i++) {
+
+                appendArgument(filter.operands[i]);
+
+            }
+
+        }
+        void appendArgument(const vector<BatchItem>& items) {
+
+            appendVarint(arguments, items.size());
+            for (size_t i = 0; i < items.size(); i++) {
+
+                appendVarint(arguments, items[i].bookType);
+                appendString(arguments, items[i].title);
+                appendString(arguments, items[i].author);
+
+            }
+
+        }
+
+        // Function to append every argument of a call, in order
+        void appendArguments() {
+
+        }
+        template <class First, class... Rest>
+        void appendArguments(const First& first, const Rest&... rest) {
+
+            appendArgument(first);
+            appendArguments(rest...);
+
+        }
+
+    // Public member functions
+    public:
+
+        // Operation codes
+        static const uint8_t OP_ADD_BOOK = 1;
+        static const uint8_t OP_REMOVE_BOOK = 2;
+        static const uint8_t OP_FIND_BOOKS = 3;
+        static const uint8_t OP_BOOK_SEARCH = 4;
+        static const uint8_t OP_DISPLAY_BOOKS = 5;
+        static const uint8_t OP_BORROW_OR_RETURN = 6;
+        static const uint8_t OP_BORROW_OR_RETURN_BATCH = 7;
+        static const uint8_t OP_PLACE_HOLD = 8;
+        static const uint8_t OP_REGISTER_PATRON = 9;
+        static const uint8_t OP_GET_PATRON_LOANS = 10;
+        static const uint8_t OP_DISPLAY_PATRON_LOANS = 11;
+        static const uint8_t OP_GET_FACET_COUNTS = 12;
+        static const uint8_t OP_FIND_TITLES_WITH_PREFIX = 13;
+        static const uint8_t OP_GET_RECOMMENDATIONS = 14;
+        static const uint8_t OP_DISPLAY_RECOMMENDATIONS = 15;
+        static const uint8_t OP_DISPLAY_CATALOG_STATS = 16;
+        static const uint8_t OP_GET_HOLD_QUEUE_LENGTH = 17;
+        static const uint8_t OP_FILTER_BOOKS = 18;
+        static const uint8_t OP_DISPLAY_FILTERED_BOOKS = 19;
+        static const uint8_t OP_PREPARE_BATCH = 20;
+        static const uint8_t OP_COMMIT_BATCH = 21;
+        static const uint8_t OP_SET_SESSION_WINDOW = 22;
+        static const uint8_t OP_CONFIGURE_BLOOM_FILTERS = 23;
+        static const uint8_t OP_SET_SEARCH_CACHE_SIZE = 24;
+        static const uint8_t OP_SET_SHOW_MESSAGES = 25;
+        static const uint8_t OP_SET_HISTORY_TIME = 26;
+        static const uint8_t OP_PAGE_OUT_DETAILS = 27;
+        static const uint8_t OP_ENABLE_SNAPSHOTS = 28;
+        static const uint8_t OP_GET_AVAILABLE_COPIES_AT = 29;
+        static const uint8_t OP_GET_AVAILABILITY_WINDOW = 30;
+        static const uint8_t OP_GET_TYPE_COUNTS = 31;
+        static const uint8_t OP_GET_DICTIONARY_REPORT = 32;
+        static const uint8_t OP_GET_BLOOM_FILTER_STATS = 33;
+        static const uint8_t OP_GET_SEARCH_CACHE_METRICS = 34;
+        static const uint8_t OP_GET_MEMORY_REPORT = 35;
+        static const uint8_t OP_DISPLAY_MEMORY_REPORT = 36;
+        static const uint8_t OP_COUNT = 37;
+
+        // Header: the magic string and the version of the record format
+        static constexpr const char* MAGIC = "LMSTRACEv";
+        static const uint64_t FORMAT_VERSION = 2;
+
+        // Functions to carry a double as the bits of an integer argument (integer arguments of every width share one
+        // overload, which a double one would make ambiguous)
+        static int64_t doubleBits(double value) {
+
+            int64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+
+        }
+        static double bitsDouble(int64_t bits) {
+
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+
+        }
+
+        // Constructor with the trace file path; an existing file is replaced
+        TraceRecorder(string path) : file(path.c_str(), ios::binary | ios::trunc) {
+
+            start = chrono::steady_clock::now();
+            lastStart = 0;
+            depth = 0;
+            calls = 0;
+            buffer.reserve(FLUSH_SIZE + 64 * 1024);
+            buffer += MAGIC;
+            appendVarint(buffer, FORMAT_VERSION);
+            appendVarint(buffer, (uint64_t) wallClockMicros());
+
+        }
+
+        // Destructor; writes whatever is still buffered
+        ~TraceRecorder() {
+
+            flush();
+
+        }
+
+        // Function to check if the trace file could be opened
+        bool isOpen() {
+
+            return file.is_open();
+
+        }
+
+        // Function to write the buffered records to the file
+        void flush() {
+
+            file.write(buffer.data(), buffer.size());
+            file.flush();
+            buffer.clear();
+
+        }
+
+        // Function to return the number of calls traced
+        uint64_t getCallCount() {
+
+            return calls;
+
+        }
+
+        // Function to start a call; returns true (and records its arguments) only for a call that isn't made from
+        // inside another traced call
+        template <class... Arguments>
+        bool enter(const Arguments&... args) {
+
+            if (depth++ != 0) {
+
+                return false;
+
+            }
+            arguments.clear();
+            appendArguments(args...);
+            return true;
+
+        }
+
+        // Function to return the nanoseconds since the trace started
+        int64_t now() {
+
+            return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+
+        }
+
+        // Function to finish a call, writing its record if it was the outermost one
+        void leave(bool outermost, uint8_t op, int64_t callStart, bool threw) {
+
+            depth--;
+            if (!outermost) {
+
+                return;
+
+            }
+            buffer += char(op);
+            appendSignedVarint(buffer, callStart - lastStart);
+            appendVarint(buffer, (uint64_t) (now() - callStart));
+            buffer += char(threw ? 1 : 0);
+            appendString(buffer, arguments);
+            lastStart = callStart;
+            calls++;
+            if (buffer.size() >= FLUSH_SIZE) {
+
+                flush();
+
+            }
+
+        }
+
+};
+
+
+// TraceCall class
+//  Traces one Library call while it is in scope: created at the top of the call with the operation code and the
+//  arguments, it writes the record when the call returns or throws (an exception is still unwinding when the
+//  destructor runs). Calls made from inside a traced call aren't traced.
+class TraceCall {
+
+    // Private members
+    private:
+        TraceRecorder* recorder;
+        uint8_t op;
+        bool outermost;
+        int exceptions;
+        int64_t start;
+
+    // Public member functions
+    public:
+
+        // Constructor with the library's trace recorder (nullptr if it isn't traced), the operation code, and the
+        // call's arguments
+        template <class... Arguments>
+        TraceCall(TraceRecorder* r, uint8_t o, const Arguments&... args) {
+
+            recorder = r;
+            op = o;
+            outermost = false;
+            start = 0;
+            if (recorder != nullptr) {
+
+                outermost = recorder->enter(args...);
+                exceptions = uncaught_exceptions();
+                start = outermost ? recorder->now() : 0;
+
+            }
+
+        }
+
+        // Destructor; the call threw if there are more exceptions in flight than when it started
+        ~TraceCall() {
+
+            if (recorder != nullptr) {
+
+                recorder->leave(outermost, op, start, uncaught_exceptions() > exceptions);
+
+            }
+
+        }
+
+};
+
+
+// CountingBloomFilter class
+//  Probabilistic set of keys that answers "definitely not here" or "maybe here". Counters are 4 bits (two per byte)
+//  so keys can also be removed; a counter that reaches 15 stays there, which can only cause extra "maybe" answers,
+//  never a wrong "not here". The filter is blocked: each key picks one 64 byte block (128 counters) and sets its k
+//  counters inside it, so a check touches a single cache line. Keys are tagged with a kind so titles, authors, and
+//  title/author pairs can share one filter.
+class CountingBloomFilter {
+
+    // Private members
+    private:
+        static const size_t BLOCK_COUNTERS = 128;
+        static const int MAX_HASHES = 9;
+        vector<uint8_t> counters;
+        size_t slotCount;
+        size_t blockCount;
+        int hashCount;
+        size_t capacity;
+        size_t keyCount;
+
+        // Function to mix the bits of an FNV-1a hash (64 bit finalizer)
+        static uint64_t finishHash(uint64_t h) {
+
+            h ^= h >> 33;
+            h *= 0xFF51AFD7ED558CCDULL;
+            h ^= h >> 33;
+            h *= 0xC4CEB9FE1A85EC53ULL;
+            h ^= h >> 33;
+            return h;
+
+        }
+
+        // Function to hash a kind and one or two strings (FNV-1a followed by a 64 bit finalizer)
+        static uint64_t hashKey(char kind, const string& first, const string* second) {
+
+            uint64_t h = 14695981039346656037ULL;
+            h = (h ^ (uint8_t) kind) * 1099511628211ULL;
+            for (size_t i = 0; i < first.size(); i++) {
+
+                h = (h ^ (uint8_t) first[i]) * 1099511628211ULL;
+
+            }
+            if (second != nullptr) {
+
+                h = (h ^ 0x1F) * 1099511628211ULL;
+                for (size_t i = 0; i < second->size(); i++) {
+
+                    h = (h ^ (uint8_t) (*second)[i]) * 1099511628211ULL;
+
+                }
+
+            }
+            return finishHash(h);
+
+        }
+
+        // Function to hash a kind and the keys of one or two texts that aren't normalized yet, giving the same hash as
+        // hashKey of their keys; plain ASCII text is hashed as it is normalized, so no key string is built
+        static uint64_t hashTextKey(char kind, const string& first, const string* second) {
+
+            uint64_t h = 14695981039346656037ULL;
+            h = (h ^ (uint8_t) kind) * 1099511628211ULL;
+            auto add = [&h](uint8_t c) { h = (h ^ c) * 1099511628211ULL; };
+            bool ascii = visitNormalizedKey(first, add);
+            if (ascii && second != nullptr) {
+
+                h = (h ^ 0x1F) * 1099511628211ULL;
+                ascii = visitNormalizedKey(*second, add);
+
+            }
+            if (!ascii) {
+
+                string secondKey = (second != nullptr) ? normalizeKey(*second) : string();
+                return hashKey(kind, normalizeKey(first), (second != nullptr) ? &secondKey : nullptr);
+
+            }
+            return finishHash(h);
+
+        }
+
+        // Function to check the k counters of a hashed key; false means the key was definitely never inserted
+        bool probe(uint64_t h) {
+
+            uint64_t mixed = h * 0x9E3779B97F4A7C15ULL;
+            for (int i = 0; i < hashCount; i++) {
+
+                if (getCounter(slotFor(h, mixed, i)) == 0) {
+
+                    return false;
+
+                }
+
+            }
+            return true;
+
+        }
+
+        // Functions to read and write one 4-bit counter
+        uint8_t getCounter(size_t slot) {
+
+            return (counters[slot >> 1] >> ((slot & 1) * 4)) & 0x0F;
+
+        }
+        void setCounter(size_t slot, uint8_t value) {
+
+            int shift = (slot & 1) * 4;
+            counters[slot >> 1] = (uint8_t) ((counters[slot >> 1] & ~(0x0F << shift)) | (value << shift));
+
+        }
+
+        // Function to return the counter a key's i-th hash picks (7 bits of a second mix of the hash per counter)
+        size_t slotFor(uint64_t h, uint64_t mixed, int i) {
+
+            return (size_t) (h % blockCount) * BLOCK_COUNTERS + (size_t) ((mixed >> (i * 7)) & (BLOCK_COUNTERS - 1));
+
+        }
+
+        // Function to add (change 1) or remove (change -1) a key
+        void update(uint64_t h, int change) {
+
+            uint64_t mixed = h * 0x9E3779B97F4A7C15ULL;
+            for (int i = 0; i < hashCount; i++) {
+
+                size_t slot = slotFor(h, mixed, i);
+                uint8_t value = getCounter(slot);
+                if (value == 15) {
+
+                    continue;
+
+                }
+                if (change > 0) {
+
+                    setCounter(slot, value + 1);
+
+                } else if (value > 0) {
+
+                    setCounter(slot, value - 1);
+
+                }
+
+            }
+
+        }
+
+    // Public member functions
+    public:
+
+        // Default constructor (a filter with no room, which says "maybe" to everything until it is reset)
+        CountingBloomFilter() {
+
+            slotCount = 0;
+            blockCount = 0;
+            hashCount = 0;
+            capacity = 0;
+            keyCount = 0;
+
+        }
+
+        // Function to empty the filter and size it for a number of keys at a false positive rate
+        void reset(size_t expectedKeys, double falsePositiveRate) {
+
+            expectedKeys = max(expectedKeys, (size_t) 64);
+            double bitsPerKey = -log(falsePositiveRate) / (log(2.0) * log(2.0));
+            blockCount = (size_t) ceil(expectedKeys * bitsPerKey / BLOCK_COUNTERS);
+            slotCount = blockCount * BLOCK_COUNTERS;
+            hashCount = min(MAX_HASHES, max(1, (int) round(bitsPerKey * log(2.0))));
+            capacity = expectedKeys;
+            keyCount = 0;
+            counters.assign((slotCount + 1) / 2, 0);
+
+        }
+
+        // Functions to insert and remove a key made of one string, or of two strings (such as a title and author)
+        void insert(char kind, const string& first, const string* second) {
+
+            if (slotCount != 0) {
+
+                update(hashKey(kind, first, second), 1);
+                keyCount++;
+
+            }
+
+        }
+        void remove(char kind, const string& first, const string* second) {
+
+            if (slotCount != 0) {
+
+                update(hashKey(kind, first, second), -1);
+                keyCount--;
+
+            }
+
+        }
+
+        // Function to check a key; false means the key was definitely never inserted
+        bool mightContain(char kind, const string& first, const string* second) {
+
+            return slotCount == 0 || probe(hashKey(kind, first, second));
+
+        }
+
+        // Function to check the key of one or two texts that aren't normalized yet (a title and author as typed), so
+        // a miss is found without building a key string
+        bool mightContainText(char kind, const string& first, const string* second) {
+
+            return slotCount == 0 || probe(hashTextKey(kind, first, second));
+
+        }
+
+        // Function to check if the filter has more keys than it was sized for
+        bool isFull() {
+
+            return keyCount >= capacity;
+
+        }
+
+        // Function to return the number of keys in the filter
+        size_t size() {
+
+            return keyCount;
+
+        }
+
+        // Function to return the number of bytes the filter uses
+        size_t memoryUsage() {
+
+            return sizeof(*this) + counters.capacity();
+
+        }
+
+        // Function to count the heap memory the counters use
+        void countMemory(MemoryComponent& c) {
+
+            countVector(c, counters);
+
+        }
+
+};
+
+
+// BloomFilterStats struct
+//  How often the Bloom filters were checked and how often they rejected a lookup without a scan
+struct BloomFilterStats {
+    uint64_t checks;
+    uint64_t rejections;
+    size_t keys;
+    size_t bytes;
+};
+
+
+// AvailabilityWindow struct
+//  Availability of one title over a window of time: the fewest and most copies on the shelf, the time-weighted average
+//  number on the shelf, the highest share of copies that were out at once, and the number of changes in the window
+struct AvailabilityWindow {
+    int minAvailable;
+    int maxAvailable;
+    double averageAvailable;
+    double peakUtilization;
+    size_t transitions;
+};
+
+
+// AvailabilityHistory class
+//  Append-only record of how many copies of each title were on the shelf (and in the library) over time. Each
+//  title's changes are kept in blocks of 64: the block index holds the time and counts after the block's first
+//  change, and the rest of the block is one byte string of (seconds since the previous change, change code) varints,
+//  where the change code packs the change in available copies and the change in total copies. Queries binary search
+//  the block index by time and decode at most one block to find where they start.
+class AvailabilityHistory {
+
+    // Private members
+    private:
+
+        // Number of changes per block
+        static const uint32_t BLOCK_SIZE = 64;
+
+        // Start of one block: time and counts after its first change, and where the rest of its changes are encoded
+        struct Block {
+            int64_t time;
+            int32_t available;
+            int32_t total;
+            uint32_t offset;
+            uint32_t count;
+        };
+
+        // One title's history, plus the latest time and counts so new changes can be encoded as deltas
+        struct Series {
+            string bytes;
+            vector<Block> blocks;
+            int64_t lastTime;
+            int32_t available;
+            int32_t total;
+        };
+
+        // Position while decoding a series: the block, how many of its changes have been read, and the time and
+        // counts after the last change read
+        struct Cursor {
+            size_t block;
+            uint32_t read;
+            const char* p;
+            int64_t time;
+            int32_t available;
+            int32_t total;
+        };
+
+        unordered_map<string, Series> series;
+        size_t transitionCount;
+
+        // Function to start a cursor at the beginning of a block (just after its first change)
+        static Cursor startBlock(const Series& s, size_t block) {
+
+            Cursor c;
+            c.block = block;
+            c.read = 1;
+            c.p = s.bytes.data() + s.blocks[block].offset;
+            c.time = s.blocks[block].time;
+            c.available = s.blocks[block].available;
+            c.total = s.blocks[block].total;
+            return c;
+
+        }
+
+        // Function to return the time of the cursor's next change without moving the cursor; false if there is none
+        static bool peekTime(const Series& s, const Cursor& c, int64_t& time) {
+
+            if (c.read < s.blocks[c.block].count) {
+
+                const char* p = c.p;
+                uint64_t delta;
+                readVarint(p, s.bytes.data() + s.bytes.size(), delta);
+                time = c.time + (int64_t) delta;
+                return true;
+
+            }
+            if (c.block + 1 < s.blocks.size()) {
+
+                time = s.blocks[c.block + 1].time;
+                return true;
+
+            }
+            return false;
+
+        }
+
+        // Function to move the cursor past its next change (which must exist)
+        static void advance(const Series& s, Cursor& c) {
+
+            if (c.read == s.blocks[c.block].count) {
+
+                c = startBlock(s, c.block + 1);
+                return;
+
+            }
+
+            const char* end = s.bytes.data() + s.bytes.size();
+            uint64_t delta, code;
+            readVarint(c.p, end, delta);
+            readVarint(c.p, end, code);
+            c.time += (int64_t) delta;
+            c.total += (int32_t) (code % 3) - 1;
+            code /= 3;
+            c.available += (code & 1) ? -(int32_t) ((code + 1) / 2) : (int32_t) (code / 2);
+            c.read++;
+
+        }
+
+        // Function to position a cursor on the last change at or before a time; false if the series starts after it
+        static bool seek(const Series& s, int64_t time, Cursor& c) {
+
+            // Binary search for the last block that starts at or before the time
+            size_t low = 0, high = s.blocks.size();
+            while (low < high) {
+
+                size_t middle = (low + high) / 2;
+                if (s.blocks[middle].time <= time) {
+
+                    low = middle + 1;
+
+                } else {
+
+                    high = middle;
+
+                }
+
+            }
+            if (low == 0) {
+
+                return false;
+
+            }
+
+            // Decoding forward inside the block
+            c = startBlock(s, low - 1);
+            int64_t next;
+            while (c.read < s.blocks[c.block].count && peekTime(s, c, next) && next <= time) {
+
+                advance(s, c);
+
+            }
+            return true;
+
+        }
+
+    // Public member functions
+    public:
+
+        // Default constructor
+        AvailabilityHistory() {
+
+            transitionCount = 0;
+
+        }
+
+        // Function to record a change in a title's available copies and total copies at a time (in seconds)
+        //  Times earlier than the title's latest change are recorded at the latest change's time
+        void record(const string& key, int64_t time, int availableChange, int totalChange) {
+
+            if (availableChange == 0 && totalChange == 0) {
+
+                return;
+
+            }
+
+            Series& s = series[key];
+            if (s.blocks.empty()) {
+
+                s.lastTime = time;
+                s.available = 0;
+                s.total = 0;
+
+            }
+            time = max(time, s.lastTime);
+            s.available += availableChange;
+            s.total += totalChange;
+
+            // Starting a new block with the counts in full, or adding the change to the last block as deltas
+            if (s.blocks.empty() || s.blocks.back().count == BLOCK_SIZE) {
+
+                Block b;
+                b.time = time;
+                b.available = s.available;
+                b.total = s.total;
+                b.offset = (uint32_t) s.bytes.size();
+                b.count = 1;
+                s.blocks.push_back(b);
+
+            } else {
+
+                int64_t zigzag = ((int64_t) availableChange << 1) ^ ((int64_t) availableChange >> 63);
+                appendVarint(s.bytes, (uint64_t) (time - s.lastTime));
+                appendVarint(s.bytes, (uint64_t) zigzag * 3 + (uint64_t) (totalChange + 1));
+                s.blocks.back().count++;
+
+            }
+            s.lastTime = time;
+            transitionCount++;
+
+        }
+
+        // Function to return how many copies of a title were on the shelf at a time (0 before its first change)
+        int availableAt(const string& key, int64_t time) {
+
+            unordered_map<string, Series>::iterator found = series.find(key);
+            Cursor c;
+            if (found == series.end() || !seek(found->second, time, c)) {
+
+                return 0;
+
+            }
+            return c.available;
+
+        }
+
+        // Function to summarize a title's availability over the window [from, to] (in seconds)
+        AvailabilityWindow window(const string& key, int64_t from, int64_t to) {
+
+            // Declaring necessary variables
+            AvailabilityWindow result;
+            result.minAvailable = 0;
+            result.maxAvailable = 0;
+            result.averageAvailable = 0;
+            result.peakUtilization = 0;
+            result.transitions = 0;
+            unordered_map<string, Series>::iterator found = series.find(key);
+            if (found == series.end() || to < from) {
+
+                return result;
+
+            }
+            const Series& s = found->second;
+
+            // Counts at the start of the window
+            Cursor c;
+            int available = 0, total = 0;
+            bool started = seek(s, from, c);
+            if (started) {
+
+                available = c.available;
+                total = c.total;
+
+            }
+            result.minAvailable = available;
+            result.maxAvailable = available;
+            if (total > 0) {
+
+                result.peakUtilization = (double) (total - available) / total;
+
+            }
+
+            // Loop through the changes inside the window, weighting each count by how long it lasted
+            double weighted = 0;
+            int64_t since = from, next = 0;
+            while (true) {
+
+                // Time of the next change: the first change of the title, or the one after the cursor
+                bool more = true;
+                if (started) {
+
+                    more = peekTime(s, c, next);
+
+                } else {
+
+                    next = s.blocks[0].time;
+
+                }
+                if (!more || next > to) {
+
+                    break;
+
+                }
+
+                weighted += (double) available * (next - since);
+                since = next;
+                if (started) {
+
+                    advance(s, c);
+
+                } else {
+
+                    c = startBlock(s, 0);
+                    started = true;
+
+                }
+                available = c.available;
+                total = c.total;
+                result.minAvailable = min(result.minAvailable, available);
+                result.maxAvailable = max(result.maxAvailable, available);
+                if (total > 0) {
+
+                    result.peakUtilization = max(result.peakUtilization, (double) (total - available) / total);
+
+                }
+                result.transitions++;
+
+            }
+            weighted += (double) available * (to - since);
+            result.averageAvailable = (to > from) ? weighted / (to - from) : available;
+            return result;
+
+        }
+
+        // Function to return the number of changes recorded
+        size_t size() {
+
+            return transitionCount;
+
+        }
+
+        // Function to return the number of bytes the encoded changes and block indexes use (not counting the map of titles)
+        size_t memoryUsage() {
+
+            size_t bytes = 0;
+            for (unordered_map<string, Series>::iterator it = series.begin(); it != series.end(); it++) {
+
+                bytes += it->second.bytes.capacity() + it->second.blocks.capacity() * sizeof(Block);
+
+            }
+            return bytes;
+
+        }
+
+        // Function to count the heap memory the encoded changes, block indexes, and the map of titles use
+        void countMemory(MemoryComponent& c) {
+
+            countHashMap(c, series);
+            for (unordered_map<string, Series>::iterator it = series.begin(); it != series.end(); it++) {
+
+                countString(c, it->first);
+                countString(c, it->second.bytes);
+                countVector(c, it->second.blocks);
+
+            }
+
+        }
+
+};
+
+
+// Function to return the number of bytes a std::string uses, including its heap buffer if it has one
+size_t stringFootprint(const string& s) {
+
+    // Short strings are stored inside the string object itself
+    if (s.capacity() <= 15) {
+
+        return sizeof(string);
+
+    }
+    return sizeof(string) + s.capacity() + 1;
+
+}
+
+
+// DictionaryReport struct
+//  Memory the title and author keys of a library's books would use as two strings per book, and what they use as a 4
+//  byte dictionary ID per title and per author plus the shared key dictionaries (measured, not projected)
+struct DictionaryReport {
+    size_t books;
+    size_t distinctTitles;
+    size_t distinctAuthors;
+    size_t stringBytes;
+    size_t dictionaryBytes;
+};
+
+
+// MemoryReport struct
+//  Heap memory used by each component of a library, and the bytes of memory-mapped detail files its books read from
+struct MemoryReport {
+    size_t books;
+    vector<MemoryComponent> components;
+    size_t mappedBytes;
+};
+
+
+// FacetCounts struct
+//  Number of copies, and how many of them are on the shelf, for one genre, course, author, or book type
+struct FacetCounts {
+    int total;
+    int available;
+};
+
+
+// BatchQuery struct
+//  One lookup in a batch of queries: by ISBN (queryChoice 1), by title and author (queryChoice 2), by title
+//  (queryChoice 3), or by author (queryChoice 4); fields the query doesn't use are ignored
+struct BatchQuery {
+    int queryChoice;
+    int bookType;
+    uint64_t isbn;
+    string title;
+    string author;
+};
+
+
+// BookRecord struct
+//  Copy of a book's details kept by catalog versions, so a snapshot stays readable after the book itself is deleted
+//  The last two fields are the course and edition of a Textbook, or the main character and setting of a Fiction Book
+struct BookRecord {
+    int bookType;
+    string title;
+    string author;
+    uint64_t isbn;
+    string genre;
+    string field1;
+    string field2;
+};
+
+
+// CatalogVersions class
+//  Multiversion copy of the catalog (every book and its availability) for snapshot reads. One writer changes the
+//  working version and publishes it at the end of each operation; readers pin the latest published version without
+//  locking and without ever seeing half of an operation. Each section is stored in chunks of 256 entries; a version
+//  shares every chunk it didn't change with the version before it, so publishing copies one chunk per changed chunk
+//  plus the list of chunk pointers. Replaced versions, chunks, and records of removed books are reclaimed by epoch:
+//  each reader announces the epoch it started in, and anything retired in an earlier epoch than every active reader's
+//  is deleted.
+class CatalogVersions {
+
+    // Snapshots read versions directly
+    friend class CatalogSnapshot;
+
+    // Private members
+    private:
+
+        // One book of a section, or an empty slot (record is nullptr)
+        struct Entry {
+            const BookRecord* record;
+            bool available;
+        };
+
+        // Fixed size block of entries
+        static const size_t CHUNK_SIZE = 256;
+        struct Chunk {
+            Entry entries[CHUNK_SIZE];
+        };
+
+        // Something waiting to be reclaimed, and the epoch it was retired in
+        struct Retired {
+            uint64_t epoch;
+            const void* object;
+            int kind;
+        };
+
+        // One published version of the catalog
+        struct Version {
+            uint64_t number;
+            vector<Chunk*> chunks[BOOK_TYPE_COUNT];
+            size_t slotCount[BOOK_TYPE_COUNT];
+            FacetCounts typeCounts[BOOK_TYPE_COUNT];
+        };
+
+        // Number of readers that can hold snapshots at the same time
+        static const size_t MAX_READERS = 64;
+
+        // Published version, and the epochs of the readers (0 for a free reader slot)
+        atomic<const Version*> current;
+        atomic<uint64_t> globalEpoch;
+        atomic<uint64_t> readerEpochs[MAX_READERS];
+
+        // Working version, only touched by the writer
+        vector<Chunk*> chunks[BOOK_TYPE_COUNT];
+        vector<uint8_t> chunkIsNew[BOOK_TYPE_COUNT];
+        vector<size_t> freeSlots[BOOK_TYPE_COUNT];
+        size_t slotCount[BOOK_TYPE_COUNT];
+        FacetCounts typeCounts[BOOK_TYPE_COUNT];
+        unordered_map<Book*, size_t> bookSlots;
+        bool changed;
+        uint64_t nextNumber;
+
+        // Objects replaced since the last publish, and objects waiting for readers to move on
+        vector<Retired> replaced;
+        vector<Retired> retired;
+
+        // Function to delete a retired object
+        static void destroy(const Retired& r) {
+
+            if (r.kind == 0) {
+
+                delete (const Version*) r.object;
+
+            } else if (r.kind == 1) {
+
+                delete (const Chunk*) r.object;
+
+            } else {
+
+                delete (const BookRecord*) r.object;
+
+            }
+
+        }
+
+        // Function to count the heap memory of a record and its strings
+        static void countRecord(MemoryComponent& c, const BookRecord* record) {
+
+            if (record == nullptr) {
+
+                return;
+
+            }
+            countAllocation(c, sizeof(BookRecord));
+            countString(c, record->title);
+            countString(c, record->author);
+            countString(c, record->genre);
+            countString(c, record->field1);
+            countString(c, record->field2);
+
+        }
+
+        // Function to count the heap memory of a version and its lists of chunks (not the chunks, which are shared)
+        static void countVersion(MemoryComponent& c, const Version* version) {
+
+            if (version == nullptr) {
+
+                return;
+
+            }
+            countAllocation(c, sizeof(Version));
+            for (int t = 0; t < BOOK_TYPE_COUNT; t++) {
+
+                countVector(c, version->chunks[t]);
+
+            }
+
+        }
+
+        // Function to return a slot's entry in the working version, copying its chunk first if a published version shares it
+        Entry& writableEntry(int bookType, size_t slot) {
+
+            size_t c = slot / CHUNK_SIZE;
+            if (!chunkIsNew[bookType][c]) {
+
+                Chunk* copy = new Chunk(*chunks[bookType][c]);
+                Retired r = {0, chunks[bookType][c], 1};
+                replaced.push_back(r);
+                chunks[bookType][c] = copy;
+                chunkIsNew[bookType][c] = 1;
+
+            }
+            changed = true;
+            return chunks[bookType][c]->entries[slot % CHUNK_SIZE];
+
+        }
+
+        // Function to delete every retired object that no reader can still see
+        void reclaim() {
+
+            uint64_t oldest = globalEpoch.load();
+            for (size_t i = 0; i < MAX_READERS; i++) {
+
+                uint64_t epoch = readerEpochs[i].load();
+                if (epoch != 0 && epoch < oldest) {
+
+                    oldest = epoch;
+
+                }
+
+            }
+
+            size_t kept = 0;
+            for (size_t i = 0; i < retired.size(); i++) {
+
+                if (retired[i].epoch < oldest) {
+
+                    destroy(retired[i]);
+
+                } else {
+
+                    retired[kept++] = retired[i];
+
+                }
+
+            }
+            retired.resize(kept);
+
+        }
+
+        // Function for a reader to pin the latest published version; returns the reader slot to unpin it with
+        size_t pin(const Version*& version) {
+
+            // Taking a free reader slot, announcing the current epoch in it
+            while (true) {
+
+                for (size_t i = 0; i < MAX_READERS; i++) {
+
+                    uint64_t idle = 0;
+                    if (readerEpochs[i].compare_exchange_strong(idle, globalEpoch.load())) {
+
+                        version = current.load();
+                        return i;
+
+                    }
+
+                }
+                this_thread::yield();
+
+            }
+
+        }
+
+        // Function for a reader to give up its pinned version
+        void unpin(size_t readerSlot) {
+
+            readerEpochs[readerSlot].store(0);
+
+        }
+
+        // Function to visit every book of a section in a version, in slot order
+        static void forEachBook(const Version* version, int bookType, function<void(const BookRecord&, bool)> visit) {
+
+            for (size_t slot = 0; slot < version->slotCount[bookType]; slot++) {
+
+                const Entry& entry = version->chunks[bookType][slot / CHUNK_SIZE]->entries[slot % CHUNK_SIZE];
+                if (entry.record != nullptr) {
+
+                    visit(*entry.record, entry.available);
+
+                }
+
+            }
+
+        }
+
+    // Public member functions
+    public:
+
+        // Default constructor; publishes an empty catalog
+        CatalogVersions() {
+
+            globalEpoch.store(1);
+            for (size_t i = 0; i < MAX_READERS; i++) {
+
+                readerEpochs[i].store(0);
+
+            }
+            for (int i = 0; i < BOOK_TYPE_COUNT; i++) {
+
+                slotCount[i] = 0;
+                typeCounts[i].total = 0;
+                typeCounts[i].available = 0;
+
+            }
+            changed = true;
+            nextNumber = 1;
+            current.store(nullptr);
+            publish();
+
+        }
+
+        // Destructor; no reader may still hold a snapshot
+        ~CatalogVersions() {
+
+            for (size_t i = 0; i < retired.size(); i++) {
+
+                destroy(retired[i]);
+
+            }
+            for (size_t i = 0; i < replaced.size(); i++) {
+
+                destroy(replaced[i]);
+
+            }
+            for (int t = 0; t < BOOK_TYPE_COUNT; t++) {
+
+                for (size_t c = 0; c < chunks[t].size(); c++) {
+
+                    for (size_t e = 0; e < CHUNK_SIZE; e++) {
+
+                        delete chunks[t][c]->entries[e].record;
+
+                    }
+                    delete chunks[t][c];
+
+                }
+
+            }
+            delete current.load();
+
+        }
+
+        // Function to add a book to the working version
+        void addBook(Book* b, int bookType) {
+
+            // Copying the book's details
+            BookRecord* record = new BookRecord();
+            record->bookType = bookType;
+            record->title = b->getTitle();
+            record->author = b->getAuthor();
+            record->isbn = b->getISBN();
+            BookDetails details = b->getDetails();
+            record->genre = details.genre;
+            record->field1 = details.field1;
+            record->field2 = details.field2;
+
+            // Reusing the slot of a removed book if there is one, otherwise adding a slot (and a chunk if needed)
+            size_t slot;
+            if (!freeSlots[bookType].empty()) {
+
+                slot = freeSlots[bookType].back();
+                freeSlots[bookType].pop_back();
+
+            } else {
+
+                slot = slotCount[bookType]++;
+                if (slot / CHUNK_SIZE == chunks[bookType].size()) {
+
+                    Chunk* chunk = new Chunk();
+                    for (size_t e = 0; e < CHUNK_SIZE; e++) {
+
+                        chunk->entries[e].record = nullptr;
+                        chunk->entries[e].available = false;
+
+                    }
+                    chunks[bookType].push_back(chunk);
+                    chunkIsNew[bookType].push_back(1);
+
+                }
+
+            }
+
+            Entry& entry = writableEntry(bookType, slot);
+            entry.record = record;
+            entry.available = b->getAvailability();
+            bookSlots[b] = slot;
+            typeCounts[bookType].total++;
+            typeCounts[bookType].available += entry.available ? 1 : 0;
+
+        }
+
+        // Function to remove a book from the working version; its record is reclaimed once no snapshot can see it
+        void removeBook(Book* b, int bookType) {
+
+            unordered_map<Book*, size_t>::iterator found = bookSlots.find(b);
+            if (found == bookSlots.end()) {
+
+                return;
+
+            }
+
+            Entry& entry = writableEntry(bookType, found->second);
+            Retired r = {0, entry.record, 2};
+            replaced.push_back(r);
+            typeCounts[bookType].total--;
+            typeCounts[bookType].available -= entry.available ? 1 : 0;
+            entry.record = nullptr;
+            entry.available = false;
+            freeSlots[bookType].push_back(found->second);
+            bookSlots.erase(found);
+
+        }
+
+        // Function to change a book's availability in the working version
+        void setAvailability(Book* b, int bookType, bool av) {
+
+            unordered_map<Book*, size_t>::iterator found = bookSlots.find(b);
+            if (found == bookSlots.end()) {
+
+                return;
+
+            }
+
+            Entry& entry = writableEntry(bookType, found->second);
+            typeCounts[bookType].available += (av ? 1 : 0) - (entry.available ? 1 : 0);
+            entry.available = av;
+
+        }
+
+        // Function to publish the working version if it has changed since the last publish, and reclaim what it can
+        void publish() {
+
+            if (!changed) {
+
+                return;
+
+            }
+
+            Version* version = new Version();
+            version->number = nextNumber++;
+            for (int t = 0; t < BOOK_TYPE_COUNT; t++) {
+
+                version->chunks[t] = chunks[t];
+                version->slotCount[t] = slotCount[t];
+                version->typeCounts[t] = typeCounts[t];
+                fill(chunkIsNew[t].begin(), chunkIsNew[t].end(), 0);
+
+            }
+
+            // Retiring the previous version and everything this one replaced in the epoch that is ending
+            const Version* previous = current.exchange(version);
+            uint64_t epoch = globalEpoch.fetch_add(1);
+            if (previous != nullptr) {
+
+                Retired r = {epoch, previous, 0};
+                retired.push_back(r);
+
+            }
+            for (size_t i = 0; i < replaced.size(); i++) {
+
+                replaced[i].epoch = epoch;
+                retired.push_back(replaced[i]);
+
+            }
+            replaced.clear();
+            changed = false;
+            reclaim();
+
+        }
+
+        // Function to return the number of retired objects still waiting for readers to move on
+        size_t getRetiredCount() {
+
+            return retired.size();
+
+        }
+
+        // Function to count the heap memory the working and published versions, their records, and everything waiting to
+        // be reclaimed use (chunks shared between versions are counted once)
+        void countMemory(MemoryComponent& c) {
+
+            countAllocation(c, sizeof(CatalogVersions));
+            for (int t = 0; t < BOOK_TYPE_COUNT; t++) {
+
+                countVector(c, chunks[t]);
+                countVector(c, chunkIsNew[t]);
+                countVector(c, freeSlots[t]);
+                for (size_t i = 0; i < chunks[t].size(); i++) {
+
+                    countAllocation(c, sizeof(Chunk));
+                    for (size_t e = 0; e < CHUNK_SIZE; e++) {
+
+                        countRecord(c, chunks[t][i]->entries[e].record);
+
+                    }
+
+                }
+
+            }
+            countHashMap(c, bookSlots);
+            countVersion(c, current.load());
+            countVector(c, replaced);
+            countVector(c, retired);
+            for (size_t i = 0; i < replaced.size() + retired.size(); i++) {
+
+                const Retired& r = (i < replaced.size()) ? replaced[i] : retired[i - replaced.size()];
+                if (r.kind == 0) {
+
+                    countVersion(c, (const Version*) r.object);
+
+                } else if (r.kind == 1) {
+
+                    countAllocation(c, sizeof(Chunk));
+
+                } else {
+
+                    countRecord(c, (const BookRecord*) r.object);
+
+                }
+
+            }
+
+        }
+
+};
+
+
+// CatalogSnapshot class
+//  A reader's handle on one published catalog version; the version stays readable until the handle is destroyed,
+//  however much the library changes in the meantime
+class CatalogSnapshot {
+
+    // Private members
+    private:
+        CatalogVersions* versions;
+        const CatalogVersions::Version* version;
+        size_t readerSlot;
+
+    // Public member functions
+    public:
+
+        // Constructor; pins the latest published version
+        CatalogSnapshot(CatalogVersions* source) {
+
+            versions = source;
+            readerSlot = versions->pin(version);
+
+        }
+
+        // Move constructor; snapshots can't be copied
+        CatalogSnapshot(CatalogSnapshot&& other) {
+
+            versions = other.versions;
+            version = other.version;
+            readerSlot = other.readerSlot;
+            other.versions = nullptr;
+
+        }
+        CatalogSnapshot(const CatalogSnapshot&) = delete;
+        CatalogSnapshot& operator=(const CatalogSnapshot&) = delete;
+
+        // Destructor; unpins the version
+        ~CatalogSnapshot() {
+
+            if (versions != nullptr) {
+
+                versions->unpin(readerSlot);
+
+            }
+
+        }
+
+        // Function to return the number of the version this snapshot sees (versions are numbered in publish order)
+        uint64_t getVersionNumber() {
+
+            return version->number;
+
+        }
+
+        // Function to return the counts for one book type as of this snapshot
+        FacetCounts getTypeCounts(int bookType) {
+
+            return version->typeCounts[bookType];
+
+        }
+
+        // Function to visit every book of one type with its availability as of this snapshot
+        void forEachBook(int bookType, function<void(const BookRecord&, bool)> visit) {
+
+            CatalogVersions::forEachBook(version, bookType, visit);
+
+        }
+
+        // Function to display all books as of this snapshot, in the same format as displayBooks
+        void displayBooks() {
+
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                cout << "\nThere are " << version->typeCounts[bookType].total << " " << BOOK_TYPES[bookType].name << "(s):\n" << endl;
+                forEachBook(bookType, [bookType](const BookRecord& b, bool available) {
+
+                    cout << "\t" << b.title << " is made by " << b.author << "; its genre is " << b.genre << "." << endl;
+                    cout << "\tIts ISBN is " << formatISBN(b.isbn) << "." << endl;
+                    displayTypeDetails(bookType, b.field1, b.field2);
+                    if (available) {
+                        cout << "\t" << b.title << " is available." << endl;
+                    } else {
+                        cout << "\t" << b.title << " is not available." << endl;
+                    }
+                    cout << "" << endl;
+
+                });
+
+            }
+
+        }
+
+};
+
+
+// Recommendation struct
+//  A title recommended alongside another, how many times patrons borrowed the two in one session, and its score
+struct Recommendation {
+    int bookType;
+    string title;
+    string author;
+    uint32_t coBorrows;
+    double score;
+};
+
+
+// CoBorrowGraph class
+//  "Patrons who borrowed this also borrowed" links between titles. Two titles are linked when one patron borrows both
+//  within a session window, and a link's weight counts how often that happened. Links are kept in a compressed sparse
+//  row (CSR) layout: title i's neighbors are neighbors[offsets[i]] to neighbors[offsets[i + 1] - 1], sorted, with
+//  their weights alongside. New links go to a short list per title first and are merged into the CSR arrays once
+//  there are enough of them, so a borrow is a few appends and a recommendation reads one contiguous row.
+class CoBorrowGraph {
+
+    // Private members
+    private:
+
+        // One title: how it is displayed, its genre and author (as IDs, so they compare quickly), its copies in the
+        // catalog, and how many times it was borrowed by a patron
+        struct Node {
+            int bookType;
+            string title;
+            string author;
+            uint32_t genreID;
+            uint32_t authorID;
+            uint32_t copies;
+            uint32_t borrows;
+        };
+
+        // One of a patron's recent borrows
+        struct RecentBorrow {
+            uint32_t node;
+            int64_t time;
+        };
+
+        // Number of recent borrows remembered per patron, and the fewest new links that are worth a merge
+        static const size_t MAX_RECENT_BORROWS = 8;
+        static const size_t MIN_MERGE_LINKS = 4096;
+
+        // Titles, keyed like the hold queues, and the IDs of genres and normalized authors
+        vector<Node> nodes;
+        unordered_map<string, uint32_t> nodeIDs;
+        unordered_map<string, uint32_t> genreIDs, authorIDs;
+        vector< vector<uint32_t> > authorNodes;
+
+        // Each patron's borrows within the session window, and the window's length in seconds
+        unordered_map<int, vector<RecentBorrow> > recentBorrows;
+        int64_t sessionWindow;
+
+        // Links merged into CSR form, and links (neighbor and weight added) not merged yet, per title
+        vector<uint32_t> offsets, neighbors, weights;
+        vector< vector< pair<uint32_t, uint32_t> > > pending;
+        size_t pendingLinks;
+        size_t merges;
+
+        // Function to return the ID of a string in a table of IDs, adding it if it's new
+        static uint32_t internID(unordered_map<string, uint32_t>& ids, const string& value) {
+
+            unordered_map<string, uint32_t>::iterator found = ids.find(value);
+            if (found != ids.end()) {
+
+                return found->second;
+
+            }
+            uint32_t id = (uint32_t) ids.size();
+            ids[value] = id;
+            return id;
+
+        }
+
+        // Function to return a title's node, adding it if it's new
+        uint32_t findOrAddNode(const string& key, Book* b, int bookType) {
+
+            unordered_map<string, uint32_t>::iterator found = nodeIDs.find(key);
+            if (found != nodeIDs.end()) {
+
+                return found->second;
+
+            }
+
+            Node node;
+            node.bookType = bookType;
+            node.title = b->getTitle();
+            node.author = b->getAuthor();
+            node.genreID = internID(genreIDs, b->getGenre());
+            node.authorID = internID(authorIDs, b->getAuthorKey());
+            node.copies = 0;
+            node.borrows = 0;
+            uint32_t id = (uint32_t) nodes.size();
+            nodes.push_back(node);
+            nodeIDs[key] = id;
+            pending.push_back(vector< pair<uint32_t, uint32_t> >());
+            if (node.authorID == authorNodes.size()) {
+
+                authorNodes.push_back(vector<uint32_t>());
+
+            }
+            authorNodes[node.authorID].push_back(id);
+            return id;
+
+        }
+
+        // Function to add one to the weight of a link, in one direction
+        void addLink(uint32_t from, uint32_t to) {
+
+            vector< pair<uint32_t, uint32_t> >& links = pending[from];
+            for (size_t i = 0; i < links.size(); i++) {
+
+                if (links[i].first == to) {
+
+                    links[i].second++;
+                    return;
+
+                }
+
+            }
+            links.push_back(make_pair(to, 1u));
+            pendingLinks++;
+
+        }
+
+        // Function to merge a title's CSR row and its pending links (sorted first) into one list sorted by neighbor
+        void mergedRow(uint32_t node, vector< pair<uint32_t, uint32_t> >& row) {
+
+            vector< pair<uint32_t, uint32_t> >& added = pending[node];
+            sort(added.begin(), added.end());
+            size_t i = (node + 1 < offsets.size()) ? offsets[node] : 0;
+            size_t end = (node + 1 < offsets.size()) ? offsets[node + 1] : 0;
+            size_t j = 0;
+            row.clear();
+            while (i < end || j < added.size()) {
+
+                if (j == added.size() || (i < end && neighbors[i] < added[j].first)) {
+
+                    row.push_back(make_pair(neighbors[i], weights[i]));
+                    i++;
+
+                } else if (i == end || added[j].first < neighbors[i]) {
+
+                    row.push_back(added[j]);
+                    j++;
+
+                } else {
+
+                    row.push_back(make_pair(neighbors[i], weights[i] + added[j].second));
+                    i++;
+                    j++;
+
+                }
+
+            }
+
+        }
+
+        // Function to merge every pending link into new CSR arrays
+        void merge() {
+
+            vector<uint32_t> newOffsets(nodes.size() + 1, 0), newNeighbors, newWeights;
+            vector< pair<uint32_t, uint32_t> > row;
+            newNeighbors.reserve(neighbors.size() + pendingLinks);
+            newWeights.reserve(neighbors.size() + pendingLinks);
+            for (uint32_t node = 0; node < nodes.size(); node++) {
+
+                mergedRow(node, row);
+                for (size_t i = 0; i < row.size(); i++) {
+
+                    newNeighbors.push_back(row[i].first);
+                    newWeights.push_back(row[i].second);
+
+                }
+                newOffsets[node + 1] = (uint32_t) newNeighbors.size();
+                vector< pair<uint32_t, uint32_t> >().swap(pending[node]);
+
+            }
+            offsets.swap(newOffsets);
+            neighbors.swap(newNeighbors);
+            weights.swap(newWeights);
+            pendingLinks = 0;
+            merges++;
+
+        }
+
+    // Public member functions
+    public:
+
+        // Default length of a borrowing session, in seconds
+        static const int64_t DEFAULT_SESSION_WINDOW = 4 * 3600;
+
+        // Weights of the signals a score adds up: how often the titles were borrowed together (normalized by how
+        // often each was borrowed, so between 0 and 1), and bonuses for the same author and the same genre
+        static constexpr double AUTHOR_BONUS = 0.2;
+        static constexpr double GENRE_BONUS = 0.1;
+
+        // Default constructor
+        CoBorrowGraph() {
+
+            sessionWindow = DEFAULT_SESSION_WINDOW;
+            pendingLinks = 0;
+            merges = 0;
+
+        }
+
+        // Function to count a copy of a title added to the catalog
+        void addCopy(const string& key, Book* b, int bookType) {
+
+            nodes[findOrAddNode(key, b, bookType)].copies++;
+
+        }
+
+        // Function to count a copy of a title removed from the catalog; titles without copies aren't recommended
+        void removeCopy(const string& key) {
+
+            unordered_map<string, uint32_t>::iterator found = nodeIDs.find(key);
+            if (found != nodeIDs.end() && nodes[found->second].copies > 0) {
+
+                nodes[found->second].copies--;
+
+            }
+
+        }
+
+        // Function to record that a patron borrowed a title at a time (seconds since 1970), linking it to the other
+        // titles the patron borrowed within the session window
+        void recordBorrow(int patronID, const string& key, Book* b, int bookType, int64_t time) {
+
+            // Declaring necessary variables
+            uint32_t node = findOrAddNode(key, b, bookType);
+            vector<RecentBorrow>& recent = recentBorrows[patronID];
+            size_t kept = 0;
+            nodes[node].borrows++;
+
+            // Forgetting borrows from before the window, and linking this title to the rest (once each)
+            for (size_t i = 0; i < recent.size(); i++) {
+
+                if (time - recent[i].time <= sessionWindow) {
+
+                    recent[kept++] = recent[i];
+
+                }
+
+            }
+            recent.resize(kept);
+            for (size_t i = 0; i < recent.size(); i++) {
+
+                bool seen = (recent[i].node == node);
+                for (size_t j = 0; j < i && !seen; j++) {
+
+                    seen = (recent[j].node == recent[i].node);
+
+                }
+                if (!seen) {
+
+                    addLink(node, recent[i].node);
+                    addLink(recent[i].node, node);
+
+                }
+
+            }
+            if (recent.size() == MAX_RECENT_BORROWS) {
+
+                recent.erase(recent.begin());
+
+            }
+            RecentBorrow borrow = {node, time};
+            recent.push_back(borrow);
+
+            // Merging once the pending links are a quarter of the merged ones (or a few thousand, at first)
+            if (pendingLinks >= max(MIN_MERGE_LINKS, neighbors.size() / 4)) {
+
+                merge();
+
+            }
+
+        }
+
+        // Function to return up to k titles to recommend alongside a title, best first
+        //  Candidates are the titles borrowed with it and the titles by the same author; each scores its co-borrow
+        //  count divided by the geometric mean of the two titles' borrows, plus the author and genre bonuses
+        vector<Recommendation> recommend(const string& key, size_t k) {
+
+            // Declaring necessary variables
+            vector<Recommendation> results;
+            vector< pair<uint32_t, uint32_t> > row;
+            vector< pair<double, uint32_t> > ranked;
+            unordered_map<string, uint32_t>::iterator found = nodeIDs.find(key);
+            if (found == nodeIDs.end() || k == 0) {
+
+                return results;
+
+            }
+            uint32_t self = found->second;
+            const Node& base = nodes[self];
+
+            // Titles borrowed with this one, then the same author's titles that weren't (with a co-borrow count of 0)
+            mergedRow(self, row);
+            size_t linked = row.size();
+            const vector<uint32_t>& sameAuthor = authorNodes[base.authorID];
+            for (size_t i = 0; i < sameAuthor.size(); i++) {
+
+                if (!binary_search(row.begin(), row.begin() + linked, make_pair(sameAuthor[i], 0u),
+                                   [](const pair<uint32_t, uint32_t>& a, const pair<uint32_t, uint32_t>& b) { return a.first < b.first; })) {
+
+                    row.push_back(make_pair(sameAuthor[i], 0u));
+
+                }
+
+            }
+
+            // Scoring the candidates still in the catalog
+            for (size_t i = 0; i < row.size(); i++) {
+
+                const Node& other = nodes[row[i].first];
+                if (row[i].first == self || other.copies == 0) {
+
+                    continue;
+
+                }
+                double score = (base.borrows == 0 || other.borrows == 0) ? 0.0 : row[i].second / sqrt((double) base.borrows * other.borrows);
+                score += (other.authorID == base.authorID) ? AUTHOR_BONUS : 0.0;
+                score += (other.genreID == base.genreID) ? GENRE_BONUS : 0.0;
+                ranked.push_back(make_pair(-score, (uint32_t) i));
+
+            }
+
+            // Keeping the k best
+            size_t count = min(k, ranked.size());
+            partial_sort(ranked.begin(), ranked.begin() + count, ranked.end());
+            for (size_t i = 0; i < count; i++) {
+
+                const pair<uint32_t, uint32_t>& candidate = row[ranked[i].second];
+                const Node& other = nodes[candidate.first];
+                Recommendation r = {other.bookType, other.title, other.author, candidate.second, -ranked[i].first};
+                results.push_back(r);
+
+            }
+            return results;
+
+        }
+
+        // Function to change the session window (seconds)
+        void setSessionWindow(int64_t seconds) {
+
+            sessionWindow = seconds;
+
+        }
+
+        // Function to return the number of titles
+        size_t getTitleCount() {
+
+            return nodes.size();
+
+        }
+
+        // Function to return the number of links (each pair of titles counted once, merged or not)
+        size_t getLinkCount() {
+
+            size_t links = neighbors.size();
+            for (size_t i = 0; i < pending.size(); i++) {
+
+                for (size_t j = 0; j < pending[i].size(); j++) {
+
+                    uint32_t to = pending[i][j].first;
+                    bool merged = false;
+                    if (i + 1 < offsets.size()) {
+
+                        merged = binary_search(neighbors.begin() + offsets[i], neighbors.begin() + offsets[i + 1], to);
+
+                    }
+                    links += merged ? 0 : 1;
+
+                }
+
+            }
+            return links / 2;
+
+        }
+
+        // Function to return the number of merges into CSR form so far
+        size_t getMergeCount() {
+
+            return merges;
+
+        }
+
+        // Function to count the heap memory the titles, links, and recent borrows use
+        void countMemory(MemoryComponent& c) {
+
+            countVector(c, nodes);
+            for (size_t i = 0; i < nodes.size(); i++) {
+
+                countString(c, nodes[i].title);
+                countString(c, nodes[i].author);
+
+            }
+            unordered_map<string, uint32_t>* tables[3] = {&nodeIDs, &genreIDs, &authorIDs};
+            for (int t = 0; t < 3; t++) {
+
+                countHashMap(c, *tables[t]);
+                for (unordered_map<string, uint32_t>::iterator it = tables[t]->begin(); it != tables[t]->end(); it++) {
+
+                    countString(c, it->first);
+
+                }
+
+            }
+            countVector(c, authorNodes);
+            for (size_t i = 0; i < authorNodes.size(); i++) {
+
+                countVector(c, authorNodes[i]);
+
+            }
+            countHashMap(c, recentBorrows);
+            for (unordered_map<int, vector<RecentBorrow> >::iterator it = recentBorrows.begin(); it != recentBorrows.end(); it++) {
+
+                countVector(c, it->second);
+
+            }
+            countVector(c, offsets);
+            countVector(c, neighbors);
+            countVector(c, weights);
+            countVector(c, pending);
+            for (size_t i = 0; i < pending.size(); i++) {
+
+                countVector(c, pending[i]);
+
+            }
+
+        }
+
+};
+
+
+// RoaringBitmap class
+//  Compressed set of 32 bit row IDs. IDs are grouped by their high 16 bits into containers, each holding the low 16
+//  bits either as a sorted array (up to 4096 IDs, 2 bytes each) or as a 65536 bit bitmap (8 KB), whichever is smaller.
+//  AND, OR, and AND NOT work container by container: merging two arrays, probing an array against a bitmap, or
+//  combining two bitmaps 64 bits at a time.
+class RoaringBitmap {
+
+    // Private members
+    private:
+
+        // One container: the high 16 bits it holds IDs for, how many it holds, and either the array or the bitmap
+        struct Container {
+            uint16_t key;
+            uint32_t cardinality;
+            vector<uint16_t> values;
+            vector<uint64_t> words;
+        };
+
+        // Most IDs a container holds as an array, and the number of 64 bit words in a bitmap container
+        static const uint32_t ARRAY_LIMIT = 4096;
+        static const size_t BITMAP_WORDS = 1024;
+
+        // Containers sorted by key
+        vector<Container> containers;
+
+        // Function to return the position of the container for a key, or where it would go
+        size_t findContainer(uint16_t key) const {
+
+            size_t low = 0, high = containers.size();
+            while (low < high) {
+
+                size_t middle = (low + high) / 2;
+                if (containers[middle].key < key) {
+
+                    low = middle + 1;
+
+                } else {
+
+                    high = middle;
+
+                }
+
+            }
+            return low;
+
+        }
+
+        // Function to switch a container to whichever form is smaller for its cardinality
+        static void normalize(Container& c) {
+
+            if (c.words.empty() && c.cardinality > ARRAY_LIMIT) {
+
+                c.words.assign(BITMAP_WORDS, 0);
+                for (size_t i = 0; i < c.values.size(); i++) {
+
+                    c.words[c.values[i] >> 6] |= (uint64_t) 1 << (c.values[i] & 63);
+
+                }
+                vector<uint16_t>().swap(c.values);
+
+            } else if (!c.words.empty() && c.cardinality <= ARRAY_LIMIT) {
+
+                c.values.clear();
+                c.values.reserve(c.cardinality);
+                for (size_t w = 0; w < BITMAP_WORDS; w++) {
+
+                    for (uint64_t word = c.words[w]; word != 0; word &= word - 1) {
+
+                        c.values.push_back((uint16_t) (w * 64 + __builtin_ctzll(word)));
+
+                    }
+
+                }
+                vector<uint64_t>().swap(c.words);
+
+            }
+
+        }
+
+        // Function to check if a container holds the low 16 bits of an ID
+        static bool holds(const Container& c, uint16_t low) {
+
+            if (!c.words.empty()) {
+
+                return (c.words[low >> 6] >> (low & 63)) & 1;
+
+            }
+            return binary_search(c.values.begin(), c.values.end(), low);
+
+        }
+
+        // Function to return a container's bitmap words, building them in scratch if it is an array
+        static const uint64_t* bitmapWords(const Container& c, vector<uint64_t>& scratch) {
+
+            if (!c.words.empty()) {
+
+                return c.words.data();
+
+            }
+            scratch.assign(BITMAP_WORDS, 0);
+            for (size_t i = 0; i < c.values.size(); i++) {
+
+                scratch[c.values[i] >> 6] |= (uint64_t) 1 << (c.values[i] & 63);
+
+            }
+            return scratch.data();
+
+        }
+
+        // Function to keep the IDs of an array container that another container holds
+        static void filterArray(const Container& array, const Container& other, bool keep, Container& out) {
+
+            for (size_t i = 0; i < array.values.size(); i++) {
+
+                if (holds(other, array.values[i]) == keep) {
+
+                    out.values.push_back(array.values[i]);
+
+                }
+
+            }
+            out.cardinality = (uint32_t) out.values.size();
+
+        }
+
+        // Function to combine two containers with the same key; op is 1 (AND), 2 (OR), or 3 (AND NOT)
+        static Container combine(const Container& a, const Container& b, int op) {
+
+            Container out;
+            out.key = a.key;
+            out.cardinality = 0;
+
+            // Two arrays: a merge (an OR can outgrow an array, which normalize turns into a bitmap)
+            if (a.words.empty() && b.words.empty()) {
+
+                if (op == 1) {
+
+                    set_intersection(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(), back_inserter(out.values));
+
+                } else if (op == 2) {
+
+                    set_union(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(), back_inserter(out.values));
+
+                } else {
+
+                    set_difference(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(), back_inserter(out.values));
+
+                }
+                out.cardinality = (uint32_t) out.values.size();
+                normalize(out);
+                return out;
+
+            }
+
+            // An array ANDed with (or without) a bitmap: probing the bitmap for each ID of the array
+            if (a.words.empty() && op != 2) {
+
+                filterArray(a, b, op == 1, out);
+                return out;
+
+            }
+            if (b.words.empty() && op == 1) {
+
+                filterArray(b, a, true, out);
+                return out;
+
+            }
+
+            // Otherwise both as bitmaps, 64 IDs at a time
+            vector<uint64_t> leftScratch, rightScratch;
+            const uint64_t* left = bitmapWords(a, leftScratch);
+            const uint64_t* right = bitmapWords(b, rightScratch);
+            out.words.resize(BITMAP_WORDS);
+            for (size_t w = 0; w < BITMAP_WORDS; w++) {
+
+                uint64_t word = (op == 1) ? (left[w] & right[w]) : (op == 2) ? (left[w] | right[w]) : (left[w] & ~right[w]);
+                out.words[w] = word;
+                out.cardinality += (uint32_t) __builtin_popcountll(word);
+
+            }
+            normalize(out);
+            return out;
+
+        }
+
+        // Function to count the IDs two containers with the same key both hold
+        static uint32_t countBoth(const Container& a, const Container& b) {
+
+            uint32_t count = 0;
+            if (!a.words.empty() && !b.words.empty()) {
+
+                for (size_t w = 0; w < BITMAP_WORDS; w++) {
+
+                    count += (uint32_t) __builtin_popcountll(a.words[w] & b.words[w]);
+
+                }
+
+            } else if (a.words.empty() && b.words.empty() && (a.values.size() > 16 * b.values.size() ||
+                                                               b.values.size() > 16 * a.values.size())) {
+
+                // Arrays of very different sizes: a binary search in the bigger one for each ID of the smaller one,
+                // starting after the last one found
+                const vector<uint16_t>& small = (a.values.size() < b.values.size()) ? a.values : b.values;
+                const vector<uint16_t>& big = (a.values.size() < b.values.size()) ? b.values : a.values;
+                vector<uint16_t>::const_iterator from = big.begin();
+                for (size_t i = 0; i < small.size() && from != big.end(); i++) {
+
+                    from = lower_bound(from, big.end(), small[i]);
+                    count += (from != big.end() && *from == small[i]) ? 1 : 0;
+
+                }
+
+            } else if (a.words.empty() && b.words.empty()) {
+
+                size_t i = 0, j = 0;
+                while (i < a.values.size() && j < b.values.size()) {
+
+                    if (a.values[i] < b.values[j]) {
+
+                        i++;
+
+                    } else if (b.values[j] < a.values[i]) {
+
+                        j++;
+
+                    } else {
+
+                        count++;
+                        i++;
+                        j++;
+
+                    }
+
+                }
+
+            } else {
+
+                const Container& array = a.words.empty() ? a : b;
+                const Container& bitmap = a.words.empty() ? b : a;
+                for (size_t i = 0; i < array.values.size(); i++) {
+
+                    count += holds(bitmap, array.values[i]) ? 1 : 0;
+
+                }
+
+            }
+            return count;
+
+        }
+
+        // Function to combine two bitmaps container by container; op is 1 (AND), 2 (OR), or 3 (AND NOT)
+        static RoaringBitmap combine(const RoaringBitmap& a, const RoaringBitmap& b, int op) {
+
+            RoaringBitmap out;
+            size_t i = 0, j = 0;
+            while (i < a.containers.size() || j < b.containers.size()) {
+
+                // A container only one side has: kept by OR, and by AND NOT when it is on the left
+                if (j == b.containers.size() || (i < a.containers.size() && a.containers[i].key < b.containers[j].key)) {
+
+                    if (op != 1) {
+
+                        out.containers.push_back(a.containers[i]);
+
+                    }
+                    i++;
+
+                } else if (i == a.containers.size() || b.containers[j].key < a.containers[i].key) {
+
+                    if (op == 2) {
+
+                        out.containers.push_back(b.containers[j]);
+
+                    }
+                    j++;
+
+                } else {
+
+                    Container c = combine(a.containers[i], b.containers[j], op);
+                    if (c.cardinality > 0) {
+
+                        out.containers.push_back(c);
+
+                    }
+                    i++;
+                    j++;
+
+                }
+
+            }
+            return out;
+
+        }
+
+    // Public member functions
+    public:
+
+        // Function to add an ID
+        void add(uint32_t id) {
+
+            uint16_t key = (uint16_t) (id >> 16), low = (uint16_t) id;
+            size_t i = findContainer(key);
+            if (i == containers.size() || containers[i].key != key) {
+
+                Container c;
+                c.key = key;
+                c.cardinality = 0;
+                containers.insert(containers.begin() + i, c);
+
+            }
+            Container& c = containers[i];
+            if (!c.words.empty()) {
+
+                uint64_t bit = (uint64_t) 1 << (low & 63);
+                c.cardinality += (c.words[low >> 6] & bit) ? 0 : 1;
+                c.words[low >> 6] |= bit;
+                return;
+
+            }
+            vector<uint16_t>::iterator position = lower_bound(c.values.begin(), c.values.end(), low);
+            if (position == c.values.end() || *position != low) {
+
+                c.values.insert(position, low);
+                c.cardinality++;
+                normalize(c);
+
+            }
+
+        }
+
+        // Function to remove an ID
+        void remove(uint32_t id) {
+
+            uint16_t key = (uint16_t) (id >> 16), low = (uint16_t) id;
+            size_t i = findContainer(key);
+            if (i == containers.size() || containers[i].key != key || !holds(containers[i], low)) {
+
+                return;
+
+            }
+            Container& c = containers[i];
+            c.cardinality--;
+            if (!c.words.empty()) {
+
+                c.words[low >> 6] &= ~((uint64_t) 1 << (low & 63));
+
+            } else {
+
+                c.values.erase(lower_bound(c.values.begin(), c.values.end(), low));
+
+            }
+            if (c.cardinality == 0) {
+
+                containers.erase(containers.begin() + i);
+
+            } else {
+
+                normalize(c);
+
+            }
+
+        }
+
+        // Function to check if an ID is in the bitmap
+        bool contains(uint32_t id) const {
+
+            size_t i = findContainer((uint16_t) (id >> 16));
+            return i < containers.size() && containers[i].key == (uint16_t) (id >> 16) && holds(containers[i], (uint16_t) id);
+
+        }
+
+        // Function to return the number of IDs in the bitmap
+        uint64_t getCardinality() const {
+
+            uint64_t count = 0;
+            for (size_t i = 0; i < containers.size(); i++) {
+
+                count += containers[i].cardinality;
+
+            }
+            return count;
+
+        }
+
+        // Functions to return the IDs in both bitmaps, in either, or in the first but not the second
+        static RoaringBitmap intersect(const RoaringBitmap& a, const RoaringBitmap& b) {
+
+            return combine(a, b, 1);
+
+        }
+        static RoaringBitmap unite(const RoaringBitmap& a, const RoaringBitmap& b) {
+
+            return combine(a, b, 2);
+
+        }
+        static RoaringBitmap subtract(const RoaringBitmap& a, const RoaringBitmap& b) {
+
+            return combine(a, b, 3);
+
+        }
+
+        // Function to count the IDs in both bitmaps without building their intersection
+        static uint64_t intersectCount(const RoaringBitmap& a, const RoaringBitmap& b) {
+
+            uint64_t count = 0;
+            size_t i = 0, j = 0;
+            while (i < a.containers.size() && j < b.containers.size()) {
+
+                if (a.containers[i].key < b.containers[j].key) {
+
+                    i++;
+
+                } else if (b.containers[j].key < a.containers[i].key) {
+
+                    j++;
+
+                } else {
+
+                    count += countBoth(a.containers[i++], b.containers[j++]);
+
+                }
+
+            }
+            return count;
+
+        }
+
+        // Function to call visit with each ID in ascending order, until it returns false
+        template <class Visit>
+        void forEach(Visit visit) const {
+
+            for (size_t i = 0; i < containers.size(); i++) {
+
+                const Container& c = containers[i];
+                uint32_t high = (uint32_t) c.key << 16;
+                if (c.words.empty()) {
+
+                    for (size_t v = 0; v < c.values.size(); v++) {
+
+                        if (!visit(high | c.values[v])) {
+
+                            return;
+
+                        }
+
+                    }
+                    continue;
+
+                }
+                for (size_t w = 0; w < BITMAP_WORDS; w++) {
+
+                    for (uint64_t word = c.words[w]; word != 0; word &= word - 1) {
+
+                        if (!visit(high | (uint32_t) (w * 64 + __builtin_ctzll(word)))) {
+
+                            return;
+
+                        }
+
+                    }
+
+                }
+
+            }
+
+        }
+
+        // Function to count the bitmap's heap memory into a component
+        void countMemory(MemoryComponent& c) const {
+
+            countVector(c, containers);
+            for (size_t i = 0; i < containers.size(); i++) {
+
+                countVector(c, containers[i].values);
+                countVector(c, containers[i].words);
+
+            }
+
+        }
+
+};
+
+
+// FacetValueCount struct
+//  How many of the books a filter matched have one value of a field
+struct FacetValueCount {
+    int field;
+    string value;
+    uint64_t count;
+};
+
+
+// FilterResult struct
+//  The books a facet filter matched (up to the limit asked for), how many it matched in all, and the facet counts of
+//  the matches: each value of each field, with the most common values first
+struct FilterResult {
+    vector<Book*> books;
+    uint64_t matches;
+    vector<FacetValueCount> facets;
+};
+
+
+// FacetIndex class
+//  Bitmap index over the low-cardinality fields of every book. Each book gets a row ID (reused
+//  once its book is removed, so the IDs stay dense), and each value of a field keeps a RoaringBitmap of the rows
+//  that have it, alongside bitmaps of the rows of each type and of the available rows. A filter is answered by
+//  combining bitmaps, and its facet counts by tallying the values each matching row keeps.
+class FacetIndex {
+
+    // Private members
+    private:
+
+        // The values of one field: value IDs by normalized key, and each value's display form, rows, and copy counts
+        struct FacetValue {
+            string value;
+            RoaringBitmap rows;
+            FacetCounts counts;
+        };
+        struct Field {
+            unordered_map<string, uint32_t> valueIDs;
+            vector<FacetValue> values;
+        };
+
+        // One row: its book and type, and the value ID of each field (NONE for a field its type doesn't have), so a
+        // book can be taken out of the index without reading its details
+        struct Row {
+            Book* book;
+            int bookType;
+            uint32_t values[FACET_FIELD_COUNT];
+        };
+
+        static const uint32_t NONE = 0xFFFFFFFF;
+
+        // The facet fields (indexed by field - 1, as many as BOOK_TYPES indexes), the rows, and the bitmaps of every
+        // row, of each type, and of the available rows
+        Field fields[FACET_FIELD_COUNT];
+        vector<Row> rows;
+        vector<uint32_t> freeRows;
+        unordered_map<Book*, uint32_t> rowIDs;
+        RoaringBitmap liveRows, typeRows[BOOK_TYPE_COUNT], availableRows;
+
+        // Function to return the bitmap of the rows a term matches (scratch holds it if it has to be built)
+        const RoaringBitmap* termRows(const FacetFilter& term, RoaringBitmap& scratch) const {
+
+            static const RoaringBitmap noRows;
+            if (term.field == FacetFilter::TYPE) {
+
+                // Type 0 is any type
+                int bookType = atoi(term.value.c_str());
+                return (bookType == 0 && term.value == "0") ? &liveRows : (bookType > 0 && bookType < BOOK_TYPE_COUNT) ? &typeRows[bookType] : &noRows;
+
+            }
+            if (term.field == FacetFilter::AVAILABILITY) {
+
+                if (term.value == "1") {
+
+                    return &availableRows;
+
+                }
+                scratch = RoaringBitmap::subtract(liveRows, availableRows);
+                return &scratch;
+
+            }
+            if (term.field < FacetFilter::GENRE || term.field > FACET_FIELD_COUNT) {
+
+                return &noRows;
+
+            }
+            const Field& field = fields[term.field - 1];
+            unordered_map<string, uint32_t>::const_iterator id = field.valueIDs.find(normalizeKey(term.value));
+            return (id == field.valueIDs.end()) ? &noRows : &field.values[id->second].rows;
+
+        }
+
+        // Function to return the rows a filter matches
+        RoaringBitmap evaluate(const FacetFilter& filter) const {
+
+            RoaringBitmap scratch;
+            if (filter.op == FacetFilter::TERM) {
+
+                return *termRows(filter, scratch);
+
+            }
+            if (filter.op == FacetFilter::NOT) {
+
+                return RoaringBitmap::subtract(liveRows, evaluate(filter.operands[0]));
+
+            }
+            if (filter.op == FacetFilter::OR) {
+
+                RoaringBitmap result;
+                for (size_t i = 0; i < filter.operands.size(); i++) {
+
+                    result = RoaringBitmap::unite(result, evaluate(filter.operands[i]));
+
+                }
+                return result;
+
+            }
+
+            // AND: the operands' bitmaps (terms used in place), smallest first so each step is as small as it can be,
+            // then the rows of the NOT operands taken out instead of building their complements
+            vector<RoaringBitmap> built(filter.operands.size() + 1);
+            vector<const RoaringBitmap*> included, excluded;
+            for (size_t i = 0; i < filter.operands.size(); i++) {
+
+                const FacetFilter& operand = filter.operands[i];
+                bool negated = operand.op == FacetFilter::NOT;
+                const FacetFilter& inner = negated ? operand.operands[0] : operand;
+                const RoaringBitmap* rowsOf;
+                if (inner.op == FacetFilter::TERM) {
+
+                    rowsOf = termRows(inner, built[i]);
+
+                } else {
+
+                    built[i] = evaluate(inner);
+                    rowsOf = &built[i];
+
+                }
+                (negated ? excluded : included).push_back(rowsOf);
+
+            }
+            sort(included.begin(), included.end(), [](const RoaringBitmap* a, const RoaringBitmap* b) {
+
+                return a->getCardinality() < b->getCardinality();
+
+            });
+            RoaringBitmap result = included.empty() ? liveRows : *included[0];
+            for (size_t i = 1; i < included.size(); i++) {
+
+                result = RoaringBitmap::intersect(result, *included[i]);
+
+            }
+            for (size_t i = 0; i < excluded.size(); i++) {
+
+                result = RoaringBitmap::subtract(result, *excluded[i]);
+
+            }
+            return result;
+
+        }
+
+    // Public member functions
+    public:
+
+        // Function to add a book to the index
+        void addBook(Book* b, int bookType) {
+
+            // Taking a free row, or a new one
+            uint32_t row;
+            if (!freeRows.empty()) {
+
+                row = freeRows.back();
+                freeRows.pop_back();
+
+            } else {
+
+                row = (uint32_t) rows.size();
+                rows.push_back(Row());
+
+            }
+            rowIDs[b] = row;
+            rows[row].book = b;
+            rows[row].bookType = bookType;
+
+            // Adding the row to the bitmap of each of its values
+            BookDetails details = b->getDetails();
+            const string* values[FACET_FIELD_COUNT] = {&details.genre};
+            if (BOOK_TYPES[bookType].field1Facet != 0) {
+
+                values[BOOK_TYPES[bookType].field1Facet - 1] = &details.field1;
+
+            }
+            if (BOOK_TYPES[bookType].field2Facet != 0) {
+
+                values[BOOK_TYPES[bookType].field2Facet - 1] = &details.field2;
+
+            }
+            for (int f = 0; f < FACET_FIELD_COUNT; f++) {
+
+                rows[row].values[f] = NONE;
+                if (values[f] == nullptr) {
+
+                    continue;
+
+                }
+                string key = normalizeKey(*values[f]);
+                unordered_map<string, uint32_t>::iterator id = fields[f].valueIDs.find(key);
+                if (id == fields[f].valueIDs.end()) {
+
+                    id = fields[f].valueIDs.insert(make_pair(key, (uint32_t) fields[f].values.size())).first;
+                    fields[f].values.push_back(FacetValue());
+                    fields[f].values.back().value = *values[f];
+                    fields[f].values.back().counts.total = 0;
+                    fields[f].values.back().counts.available = 0;
+
+                }
+                rows[row].values[f] = id->second;
+                FacetValue& value = fields[f].values[id->second];
+                value.rows.add(row);
+                value.counts.total++;
+                value.counts.available += b->getAvailability() ? 1 : 0;
+
+            }
+            liveRows.add(row);
+            typeRows[bookType].add(row);
+            if (b->getAvailability()) {
+
+                availableRows.add(row);
+
+            }
+
+        }
+
+        // Function to remove a book from the index
+        void removeBook(Book* b) {
+
+            unordered_map<Book*, uint32_t>::iterator id = rowIDs.find(b);
+            if (id == rowIDs.end()) {
+
+                return;
+
+            }
+            uint32_t row = id->second;
+            bool available = availableRows.contains(row);
+            for (int f = 0; f < FACET_FIELD_COUNT; f++) {
+
+                if (rows[row].values[f] != NONE) {
+
+                    FacetValue& value = fields[f].values[rows[row].values[f]];
+                    value.rows.remove(row);
+                    value.counts.total--;
+                    value.counts.available -= available ? 1 : 0;
+
+                }
+
+            }
+            liveRows.remove(row);
+            typeRows[rows[row].bookType].remove(row);
+            availableRows.remove(row);
+            rows[row].book = nullptr;
+            rowIDs.erase(id);
+            freeRows.push_back(row);
+
+        }
+
+        // Function to record a change to a book's availability, using the value IDs in its row (not its details)
+        void setAvailability(Book* b, bool av) {
+
+            unordered_map<Book*, uint32_t>::iterator id = rowIDs.find(b);
+            if (id == rowIDs.end() || availableRows.contains(id->second) == av) {
+
+                return;
+
+            }
+            for (int f = 0; f < FACET_FIELD_COUNT; f++) {
+
+                if (rows[id->second].values[f] != NONE) {
+
+                    fields[f].values[rows[id->second].values[f]].counts.available += av ? 1 : -1;
+
+                }
+
+            }
+            if (av) {
+
+                availableRows.add(id->second);
+
+            } else {
+
+                availableRows.remove(id->second);
+
+            }
+
+        }
+
+        // Function to return the books a filter matches (at most limit of them, in row order) and the facet counts
+        // of every match
+        FilterResult filter(const FacetFilter& facetFilter, size_t limit) const {
+
+            // Declaring necessary variables
+            FilterResult result;
+            RoaringBitmap matches = evaluate(facetFilter);
+            result.matches = matches.getCardinality();
+
+            // Collecting the first books up to the limit, and tallying the values of every match from its row (a pass
+            // over the matches, rather than intersecting them with the bitmap of every value)
+            vector<uint64_t> tallies[FACET_FIELD_COUNT];
+            for (int f = 0; f < FACET_FIELD_COUNT; f++) {
+
+                tallies[f].assign(fields[f].values.size(), 0);
+
+            }
+            matches.forEach([&](uint32_t row) {
+
+                if (result.books.size() < limit) {
+
+                    result.books.push_back(rows[row].book);
+
+                }
+                for (int f = 0; f < FACET_FIELD_COUNT; f++) {
+
+                    if (rows[row].values[f] != NONE) {
+
+                        tallies[f][rows[row].values[f]]++;
+
+                    }
+
+                }
+                return true;
+
+            });
+
+            // Listing the values with matches, most common first within each field
+            for (int f = 0; f < FACET_FIELD_COUNT; f++) {
+
+                size_t first = result.facets.size();
+                for (size_t v = 0; v < tallies[f].size(); v++) {
+
+                    if (tallies[f][v] > 0) {
+
+                        FacetValueCount c = {f + 1, fields[f].values[v].value, tallies[f][v]};
+                        result.facets.push_back(c);
+
+                    }
+
+                }
+                sort(result.facets.begin() + first, result.facets.end(), [](const FacetValueCount& a, const FacetValueCount& b) {
+
+                    return a.count > b.count;
+
+                });
+
+            }
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                FacetValueCount c = {FacetFilter::TYPE, BOOK_TYPES[bookType].name, RoaringBitmap::intersectCount(matches, typeRows[bookType])};
+                if (c.count > 0) {
+
+                    result.facets.push_back(c);
+
+                }
+
+            }
+            uint64_t available = RoaringBitmap::intersectCount(matches, availableRows);
+            FacetValueCount availability[2] = {{FacetFilter::AVAILABILITY, "Available", available},
+                                               {FacetFilter::AVAILABILITY, "Not available", result.matches - available}};
+            for (int a = 0; a < 2; a++) {
+
+                if (availability[a].count > 0) {
+
+                    result.facets.push_back(availability[a]);
+
+                }
+
+            }
+
+            return result;
+
+        }
+
+        // Function to return the copy counts of one value of a facet field
+        FacetCounts getCounts(int field, const string& value) const {
+
+            FacetCounts none = {0, 0};
+            if (field < FacetFilter::GENRE || field > FACET_FIELD_COUNT) {
+
+                return none;
+
+            }
+            unordered_map<string, uint32_t>::const_iterator id = fields[field - 1].valueIDs.find(normalizeKey(value));
+            return (id == fields[field - 1].valueIDs.end()) ? none : fields[field - 1].values[id->second].counts;
+
+        }
+
+        // Function to visit every value of a field that has copies, with its display form and copy counts
+        void forEachValue(int field, function<void(const string&, const FacetCounts&)> visit) const {
+
+            if (field < FacetFilter::GENRE || field > FACET_FIELD_COUNT) {
+
+                return;
+
+            }
+            const vector<FacetValue>& values = fields[field - 1].values;
+            for (size_t v = 0; v < values.size(); v++) {
+
+                if (values[v].counts.total > 0) {
+
+                    visit(values[v].value, values[v].counts);
+
+                }
+
+            }
+
+        }
+
+        // Function to return the number of distinct values of a field
+        size_t getValueCount(int field) const {
+
+            return (field >= FacetFilter::GENRE && field <= FACET_FIELD_COUNT) ? fields[field - 1].valueIDs.size() : 0;
+
+        }
+
+        // Function to count the index's heap memory into a component
+        void countMemory(MemoryComponent& c) const {
+
+            for (int f = 0; f < FACET_FIELD_COUNT; f++) {
+
+                countHashMap(c, fields[f].valueIDs);
+                countVector(c, fields[f].values);
+                for (unordered_map<string, uint32_t>::const_iterator id = fields[f].valueIDs.begin(); id != fields[f].valueIDs.end(); id++) {
+
+                    countString(c, id->first);
+
+                }
+                for (size_t v = 0; v < fields[f].values.size(); v++) {
+
+                    countString(c, fields[f].values[v].value);
+                    fields[f].values[v].rows.countMemory(c);
+
+                }
+
+            }
+            countVector(c, rows);
+            countVector(c, freeRows);
+            countHashMap(c, rowIDs);
+            liveRows.countMemory(c);
+            availableRows.countMemory(c);
+            for (int bookType = 0; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                typeRows[bookType].countMemory(c);
+
+            }
+
+        }
+
+};
+
+
+// Library class
+class Library {
+    
+    // Private members
+    private:
+
+        // The catalog's storage: a section of book pointers per book type tag (1 for Textbooks, 2 for Fiction Books; 0
+        // is unused), in the order the books were added
+        //  Sections only serve positional access (displays, exports, and snapshots walk them type by type); every
+        //  search goes through the indexes below, which hold the books of every type together
+        vector<Book*> sections[BOOK_TYPE_COUNT];
+
+        // Search index over the books of every type: the books with each normalized title and with each normalized
+        // author, ordered by type tag and then by when they were added
+        //  Keyed by searchIndexKey; a list can also hold books whose key only shares the hash, so the keys are still
+        //  compared. The books carry their tag, so a search of any type is one probe that takes the whole list, and a
+        //  search of one type is the same probe keeping only that type's books.
+        unordered_map<uint64_t, vector<Book*> > searchIndex;
+
+        // Function to build a search index key: a 64 bit hash (FNV-1a) of a normalized title (searchChoice 1) or
+        // author (searchChoice 2), with the search field in the low bit
+        static uint64_t searchIndexKey(int searchChoice, const string& key) {
+
+            uint64_t h = 14695981039346656037ULL;
+            for (size_t i = 0; i < key.size(); i++) {
+
+                h = (h ^ (uint8_t) key[i]) * 1099511628211ULL;
+
+            }
+            return (h << 1) | (uint64_t) (searchChoice == 2 ? 1 : 0);
+
+        }
+
+        // Function to return the search index list of a normalized title (searchChoice 1) or author (searchChoice 2),
+        // or nullptr if no book has it; several threads may call this at once as long as the catalog isn't changing
+        const vector<Book*>* indexedBooks(int searchChoice, const string& key) const {
+
+            unordered_map<uint64_t, vector<Book*> >::const_iterator list = searchIndex.find(searchIndexKey(searchChoice, key));
+            return (list == searchIndex.end()) ? nullptr : &list->second;
+
+        }
+
+        // Function to add a book to the search index lists of its title and author, after the books of its own type
+        // and of the types before it
+        void addToSearchIndex(Book* b) {
+
+            for (int searchChoice = 1; searchChoice <= 2; searchChoice++) {
+
+                vector<Book*>& list = searchIndex[searchIndexKey(searchChoice, searchChoice == 1 ? b->getTitleKey() : b->getAuthorKey())];
+                size_t i = list.size();
+                while (i > 0 && list[i - 1]->getType() > b->getType()) {
+
+                    i--;
+
+                }
+                list.insert(list.begin() + i, b);
+
+            }
+
+        }
+
+        // Function to remove a book from the search index lists of its title and author; emptied lists are dropped
+        void removeFromSearchIndex(Book* b) {
+
+            for (int searchChoice = 1; searchChoice <= 2; searchChoice++) {
+
+                unordered_map<uint64_t, vector<Book*> >::iterator list =
+                    searchIndex.find(searchIndexKey(searchChoice, searchChoice == 1 ? b->getTitleKey() : b->getAuthorKey()));
+                if (list == searchIndex.end()) {
+
+                    continue;
+
+                }
+                vector<Book*>::iterator entry = find(list->second.begin(), list->second.end(), b);
+                if (entry != list->second.end()) {
+
+                    list->second.erase(entry);
+
+                }
+                if (list->second.empty()) {
+
+                    searchIndex.erase(list);
+
+                }
+
+            }
+
+        }
+
+        // Hold queues, keyed by book type, title and author, and the copies currently held for a patron
+        //  A held copy is off the shelf (not available) but not yet borrowed
+        unordered_map<string, HoldQueue> holdQueues;
+        unordered_map<Book*, int> heldCopies;
+
+        // Registered patrons and the books each of them has on loan
+        PatronIndex patronIndex;
+
+        // Catalog statistics, kept up to date as books are added, removed, borrowed, and returned
+        //  Type counts are indexed by book type (1 for Textbooks, 2 for Fiction Books)
+        //  Authors are counted by the dictionary ID of their normalized key; genres and courses are counted in the facet index, by the value
+        //  IDs each book's row keeps, so borrowing and returning never read a book's details
+        unordered_map<uint32_t, FacetCounts> authorCounts;
+        FacetCounts typeCounts[BOOK_TYPE_COUNT];
+
+        // Cache of search results
+        SearchCache searchCache;
+
+        // ISBN index over the books of every type, pointing at one copy and counting the copies with that ISBN
+        //  Every copy with the same ISBN has the same type, title, and author, so one copy is enough to check for
+        //  duplicates and tells which type the ISBN belongs to
+        struct IsbnEntry {
+            Book* book;
+            int copies;
+        };
+        unordered_map<uint64_t, IsbnEntry> isbnIndex;
+
+        // Log every change is written to, if this library is a leader (nullptr otherwise)
+        MutationLog* mutationLog;
+
+        // Recorder every outermost call is traced to (nullptr if calls aren't traced)
+        TraceRecorder* traceRecorder;
+
+        // Whether borrowOrReturn displays its confirmation messages
+        bool showMessages;
+
+        // Counting Bloom filter over the books of every type, holding every title ('t'), author ('a'), and title/author
+        // pair ('b') key, so most lookups for books the library doesn't have are rejected without probing the indexes
+        //  A false positive rate of 0 turns the filter off
+        CountingBloomFilter bloomFilter;
+        double bloomFalsePositiveRate;
+        BloomFilterStats bloomStats;
+
+        // History of how many copies of each title were on the shelf, keyed like the hold queues, and the time changes
+        // are recorded at if it has been fixed (0 to use the clock)
+        AvailabilityHistory availabilityHistory;
+        int64_t historyTime;
+
+        // Function to return the time changes are recorded at (seconds since 1970): the fixed history time, or the clock
+        int64_t currentSeconds() {
+
+            return (historyTime != 0) ? historyTime : wallClockMicros() / 1000000;
+
+        }
+
+        // Function to record a change in a title's available and total copies in the availability history
+        void recordHistory(Book* b, int bookType, int availableChange, int totalChange) {
+
+            availabilityHistory.record(bookKey(bookType, b->getTitleKey(), b->getAuthorKey()), currentSeconds(), availableChange, totalChange);
+
+        }
+
+        // Function to link a book a patron borrowed to the other titles they borrowed in the same session
+        void recordCoBorrow(Book* b, int bookType, int patronID) {
+
+            if (patronID != 0) {
+
+                coBorrowGraph.recordBorrow(patronID, bookKey(bookType, b->getTitleKey(), b->getAuthorKey()), b, bookType, currentSeconds());
+
+            }
+
+        }
+
+        // Links between titles patrons borrow together, for recommendations
+        CoBorrowGraph coBorrowGraph;
+
+        // Bitmaps of the books with each genre, course, edition, setting, type, and availability, for faceted filters
+        FacetIndex facetIndex;
+
+        // Versions of the catalog for snapshot reads, if snapshots are turned on (nullptr otherwise)
+        //  Every change is made to the working version and published when the operation making it finishes
+        unique_ptr<CatalogVersions> catalogVersions;
+
+        // Function to publish the changes of the operation that is finishing to snapshot readers
+        void publishSnapshot() {
+
+            if (catalogVersions) {
+
+                catalogVersions->publish();
+
+            }
+
+        }
+
+        // Function to add (insert true) or remove the title, author and title-and-author keys of a book in the Bloom filter
+        void updateBloomFilter(Book* b, bool insert) {
+
+            string titleKey = b->getTitleKey(), authorKey = b->getAuthorKey();
+            if (insert) {
+
+                bloomFilter.insert('t', titleKey, nullptr);
+                bloomFilter.insert('a', authorKey, nullptr);
+                bloomFilter.insert('b', titleKey, &authorKey);
+
+            } else {
+
+                bloomFilter.remove('t', titleKey, nullptr);
+                bloomFilter.remove('a', authorKey, nullptr);
+                bloomFilter.remove('b', titleKey, &authorKey);
+
+            }
+
+        }
+
+        // Function to rebuild the Bloom filter with room for twice as many keys as it has now
+        void rebuildBloomFilter() {
+
+            if (bloomFalsePositiveRate <= 0) {
+
+                bloomFilter = CountingBloomFilter();
+                return;
+
+            }
+
+            size_t books = 0;
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                books += sections[bookType].size();
+
+            }
+            bloomFilter.reset(max((size_t) 1024, books * 2) * 3, bloomFalsePositiveRate);
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                for (size_t i = 0; i < sections[bookType].size(); i++) {
+
+                    updateBloomFilter(sections[bookType][i], true);
+
+                }
+
+            }
+
+        }
+
+        // Function to check the Bloom filter; false means no book of any type has the key
+        bool bloomMightContain(char kind, const string& first, const string* second) {
+
+            if (bloomFalsePositiveRate <= 0) {
+
+                return true;
+
+            }
+
+            return countBloomCheck(bloomFilter.mightContain(kind, first, second));
+
+        }
+
+        // Function to check the Bloom filter for the key of a title or author as typed, before it is normalized
+        bool bloomMightContainText(char kind, const string& text) {
+
+            if (bloomFalsePositiveRate <= 0) {
+
+                return true;
+
+            }
+
+            return countBloomCheck(bloomFilter.mightContainText(kind, text, nullptr));
+
+        }
+
+        // Function to count a Bloom filter check in the stats and pass its answer on
+        bool countBloomCheck(bool mightContain) {
+
+            bloomStats.checks++;
+            if (!mightContain) {
+
+                bloomStats.rejections++;
+
+            }
+            return mightContain;
+
+        }
+
+        // Number of copies in this library of each title key and author key, by ID in the shared key dictionaries
+        vector<uint32_t> titleCopies, authorCopies;
+
+        // Function to count a copy of a book added (change 1) or removed (change -1) under its title and author IDs
+        void countDictionaryCopies(Book* b, int change) {
+
+            uint32_t titleID = b->getTitleID(), authorID = b->getAuthorID();
+            if (titleID >= titleCopies.size()) {
+
+                titleCopies.resize(titleID + 1, 0);
+
+            }
+            if (authorID >= authorCopies.size()) {
+
+                authorCopies.resize(authorID + 1, 0);
+
+            }
+            titleCopies[titleID] += change;
+            authorCopies[authorID] += change;
+
+        }
+
+        // Function to add a book to the ISBN index
+        void indexISBN(Book* b) {
+
+            IsbnEntry& entry = isbnIndex[b->getISBN()];
+            if (entry.copies == 0) {
+
+                entry.book = b;
+
+            }
+            entry.copies++;
+
+        }
+
+        // Function to remove a book from the ISBN index
+        void unindexISBN(Book* b) {
+
+            unordered_map<uint64_t, IsbnEntry>::iterator entry = isbnIndex.find(b->getISBN());
+            if (entry == isbnIndex.end()) {
+
+                return;
+
+            }
+
+            entry->second.copies--;
+            if (entry->second.copies == 0) {
+
+                isbnIndex.erase(entry);
+
+            // If the copy being removed is the one the index points at, point it at another copy
+            } else if (entry->second.book == b) {
+
+                vector<Book*> copies = findCopies(b->getTitleKey(), b->getAuthorKey(), b->getType());
+                for (size_t i = 0; i < copies.size(); i++) {
+
+                    if (copies[i] != b && copies[i]->getISBN() == b->getISBN()) {
+
+                        entry->second.book = copies[i];
+                        break;
+
+                    }
+
+                }
+
+            }
+
+        }
+
+        // Function to build the search cache key (book type, search field, and the normalized title or author searched for)
+        static string searchKey(int bookType, int searchChoice, const string& value) {
+
+            string key;
+            key.reserve(value.size() + 2);
+            key += char('0' + bookType);
+            key += char('0' + searchChoice);
+            key += value;
+            return key;
+
+        }
+
+        // Function to drop cached searches whose results a book belongs in (those of its own type and those of any type)
+        void invalidateSearches(Book* b, int bookType) {
+
+            searchCache.invalidate(searchKey(bookType, 1, b->getTitleKey()));
+            searchCache.invalidate(searchKey(bookType, 2, b->getAuthorKey()));
+            searchCache.invalidate(searchKey(0, 1, b->getTitleKey()));
+            searchCache.invalidate(searchKey(0, 2, b->getAuthorKey()));
+
+        }
+
+        // Function to add a book to the section of its type, throwing an error for a duplicate ISBN
+        void insertBook(Book* b) {
+
+            int bookType = b->getType();
+
+            // Looking up the ISBN in the ISBN index
+            //  If a book with the same ISBN as the one we are trying to add is already in the library, AND it is true
+            //  that their types, titles, or authors are not the same, then throw an error for duplicate ISBN
+            unordered_map<uint64_t, IsbnEntry>::iterator sameISBN = isbnIndex.find(b->getISBN());
+            if ( (sameISBN != isbnIndex.end()) &&
+                 ( (bookType != sameISBN->second.book->getType()) || (b->getTitleID() != sameISBN->second.book->getTitleID()) ||
+                   (b->getAuthorID() != sameISBN->second.book->getAuthorID()) ) ) {
+
+                throw duplicateISBN();
+
+            }
+
+            // If no error occurs, we can add the book
+            sections[bookType].push_back(b);
+            indexBook(b, bookType);
+            publishSnapshot();
+
+        }
+
+        // Function to take a book of a type out of its section by title and author, throwing an error if there is none
+        Book* takeBook(int bookType, const string& title, const string& author) {
+
+            // Finding the first copy added with the title and author (the Bloom filter rules most misses out first)
+            vector<Book*> copies = findCopies(normalizeKey(title), normalizeKey(author), bookType);
+            if (copies.empty()) {
+
+                throw bookNotFoundError();
+
+            }
+
+            // Removing it from the indexes and its section, and returning the pointer so we can delete the object
+            Book* bookPtr = copies[0];
+            vector<Book*>& section = sections[bookType];
+            unindexBook(bookPtr, bookType);
+            section.erase(find(section.begin(), section.end(), bookPtr));
+            publishSnapshot();
+            if (mutationLog != nullptr) {
+
+                mutationLog->logRemove(bookType, title, author);
+
+            }
+            return bookPtr;
+
+        }
+
+        // Function to adjust the counts of one author; authors with no copies left are dropped
+        static void adjustFacet(unordered_map<uint32_t, FacetCounts>& counts, uint32_t value, int totalChange, int availableChange) {
+
+            FacetCounts& c = counts[value];
+            c.total += totalChange;
+            c.available += availableChange;
+            if (c.total == 0) {
+
+                counts.erase(value);
+
+            }
+
+        }
+
+        // Function to adjust the type and author counts a book contributes to (only hot fields are read)
+        void countBook(Book* b, int bookType, int totalChange, int availableChange) {
+
+            typeCounts[bookType].total += totalChange;
+            typeCounts[bookType].available += availableChange;
+            adjustFacet(authorCounts, b->getAuthorID(), totalChange, availableChange);
+
+        }
+
+        // Function to change a book's availability and keep the catalog statistics in step
+        void setAvailability(Book* b, int bookType, bool av) {
+
+            if (b->getAvailability() != av) {
+
+                b->updateAvailability(av);
+                countBook(b, bookType, 0, av ? 1 : -1);
+                recordHistory(b, bookType, av ? 1 : -1, 0);
+                facetIndex.setAvailability(b, av);
+                if (catalogVersions) {
+
+                    catalogVersions->setAvailability(b, bookType, av);
+
+                }
+
+            }
+
+        }
+
+        // Function to find a registered patron's record index, throwing an error if the patron is not registered
+        uint32_t requirePatron(int patronID) {
+
+            uint32_t slot = patronIndex.findPatron(patronID);
+            if (slot == PatronIndex::NONE) {
+
+                throw patronNotFoundError();
+
+            }
+
+            return slot;
+
+        }
+
+        // Function to build the key used for per-title structures (book type, normalized title, and normalized author)
+        static string bookKey(int bookType, const string& titleKey, const string& authorKey) {
+
+            string key;
+            key.reserve(titleKey.size() + authorKey.size() + 3);
+            key += char('0' + bookType);
+            key += '\x1f';
+            key += titleKey;
+            key += '\x1f';
+            key += authorKey;
+            return key;
+
+        }
+
+        // Function to collect every copy (duplicate) of a book with matching normalized title and author
+        vector<Book*> findCopies(const string& titleKey, const string& authorKey, int bookType) {
+
+            // Vector to store matching books in case there are duplicates
+            vector<Book*> matchingBooks;
+
+            // Skipping the probe if the Bloom filter says there is no such book
+            if (bookType < 1 || bookType >= BOOK_TYPE_COUNT || !bloomMightContain('b', titleKey, &authorKey)) {
+
+                return matchingBooks;
+
+            }
+
+            // Going through the books with the title, keeping those of the type with the author
+            const vector<Book*>* books = indexedBooks(1, titleKey);
+            if (books == nullptr) {
+
+                return matchingBooks;
+
+            }
+            KeyMatcher title(bookTitleKeys, titleKey), author(bookAuthorKeys, authorKey);
+            for (size_t i = 0; i < books->size(); i++) {
+
+                Book* b = (*books)[i];
+                if ( (b->getType() == bookType) && title.matches(b->getTitleID()) && author.matches(b->getAuthorID()) ) {
+
+                    matchingBooks.push_back(b);
+
+                }
+
+            }
+
+            return matchingBooks;
+
+        }
+
+        // Function called after a book has been added to a section
+        void indexBook(Book* b, int bookType) {
+
+            countBook(b, bookType, 1, b->getAvailability() ? 1 : 0);
+            recordHistory(b, bookType, b->getAvailability() ? 1 : 0, 1);
+            coBorrowGraph.addCopy(bookKey(bookType, b->getTitleKey(), b->getAuthorKey()), b, bookType);
+            facetIndex.addBook(b, bookType);
+            invalidateSearches(b, bookType);
+            addToSearchIndex(b);
+            indexISBN(b);
+            countDictionaryCopies(b, 1);
+            if (catalogVersions) {
+
+                catalogVersions->addBook(b, bookType);
+
+            }
+
+            // Adding the book's keys to the Bloom filter, or rebuilding it bigger once it is full (which includes this book)
+            if (bloomFalsePositiveRate > 0) {
+
+                if (bloomFilter.isFull()) {
+
+                    rebuildBloomFilter();
+
+                } else {
+
+                    updateBloomFilter(b, true);
+
+                }
+
+            }
+
+            // If patrons are waiting for this title, the new copy goes straight to the next holder
+            unordered_map<string, HoldQueue>::iterator queue = holdQueues.find(bookKey(bookType, b->getTitleKey(), b->getAuthorKey()));
+            if (queue != holdQueues.end()) {
+
+                setAvailability(b, bookType, false);
+                heldCopies[b] = queue->second.pop();
+                if (queue->second.empty()) {
+
+                    holdQueues.erase(queue);
+
+                }
+
+            }
+
+        }
+
+        // Function called before a book is removed from a section
+        void unindexBook(Book* b, int bookType) {
+
+            countBook(b, bookType, -1, b->getAvailability() ? -1 : 0);
+            recordHistory(b, bookType, b->getAvailability() ? -1 : 0, -1);
+            coBorrowGraph.removeCopy(bookKey(bookType, b->getTitleKey(), b->getAuthorKey()));
+            facetIndex.removeBook(b);
+            invalidateSearches(b, bookType);
+            removeFromSearchIndex(b);
+            unindexISBN(b);
+            countDictionaryCopies(b, -1);
+            if (catalogVersions) {
+
+                catalogVersions->removeBook(b, bookType);
+
+            }
+            if (bloomFalsePositiveRate > 0) {
+
+                updateBloomFilter(b, false);
+
+            }
+            patronIndex.removeLoan(b);
+
+            // A copy held for a patron passes the hold to another copy on the shelf, or puts the patron back at the
+            // front of the queue, so removing it never loses the holder's place
+            unordered_map<Book*, int>::iterator held = heldCopies.find(b);
+            if (held != heldCopies.end()) {
+
+                int patronID = held->second;
+                heldCopies.erase(held);
+                vector<Book*> copies = findCopies(b->getTitleKey(), b->getAuthorKey(), bookType);
+                for (size_t i = 0; i < copies.size(); i++) {
+
+                    if (copies[i]->getAvailability()) {
+
+                        setAvailability(copies[i], bookType, false);
+                        heldCopies[copies[i]] = patronID;
+                        return;
+
+                    }
+
+                }
+                holdQueues[bookKey(bookType, b->getTitleKey(), b->getAuthorKey())].pushFront(patronID);
+
+            }
+
+        }
+
+        // Function to finish returning a borrowed copy; the copy goes to the next holder if patrons are waiting
+        void finishReturn(Book* chosenBook, int bookType) {
+
+            // If patrons are waiting for this title, hand the copy directly to the next holder
+            unordered_map<string, HoldQueue>::iterator queue = holdQueues.find(bookKey(bookType, chosenBook->getTitleKey(), chosenBook->getAuthorKey()));
+            if (queue != holdQueues.end()) {
+
+                int nextPatronID = queue->second.pop();
+                heldCopies[chosenBook] = nextPatronID;
+                if (queue->second.empty()) {
+
+                    holdQueues.erase(queue);
+
+                }
+
+                if (showMessages) {
+
+                    cout << "\nThe book has been returned successfully! It is now being held for patron " << nextPatronID << ".\n" << endl;
+
+                }
+
+            // Otherwise, the book goes back on the shelf
+            } else {
+
+                setAvailability(chosenBook, bookType, true);
+                if (showMessages) {
+
+                    cout << "\nThe book has been returned successfully!\n" << endl;
+
+                }
+
+            }
+
+        }
+
+    // Public member functions
+    public:
+
+        // Exception classes:
+        //  Exception class to handle a book with a duplicate ISBN that isn't the same book
+        class duplicateISBN {};
+        //  Exception class to handle a book not being found
+        class bookNotFoundError {};
+        //  Exception class to handle a book not being able to be borrowed
+        class bookNotBorrowableError {};
+        //  Exception class to handle a book not being able to be returned
+        class bookNotReturnableError {};
+        //  Exception class to handle an invalid patron ID
+        class invalidPatronError {};
+        //  Exception class to handle a hold on a book that has a copy available right now
+        class holdNotNeededError {};
+        //  Exception class to handle a patron placing the same hold twice
+        class duplicateHoldError {};
+        //  Exception class to handle registering a patron ID that is already registered
+        class duplicatePatronError {};
+        //  Exception class to handle a library card number that does not belong to a registered patron
+        class patronNotFoundError {};
+        //  Exception class to handle a patron that already has the maximum number of books on loan
+        class loanLimitReachedError {};
+        //  Exception class to handle asking for a snapshot when snapshots are turned off
+        class snapshotsDisabledError {};
+
+        // Default number of books a patron may have on loan at once
+        static const int DEFAULT_MAX_LOANS = 10;
+
+        // Default number of searches kept in the search cache
+        static const size_t DEFAULT_SEARCH_CACHE_SIZE = 1024;
+
+        // Default false positive rate of the Bloom filters
+        static constexpr double DEFAULT_BLOOM_FALSE_POSITIVE_RATE = 0.01;
+
+        // Default constructor
+        Library() : searchCache(DEFAULT_SEARCH_CACHE_SIZE) {
+
+            mutationLog = nullptr;
+            traceRecorder = nullptr;
+            showMessages = true;
+            historyTime = 0;
+            bloomFalsePositiveRate = DEFAULT_BLOOM_FALSE_POSITIVE_RATE;
+            bloomStats.checks = 0;
+            bloomStats.rejections = 0;
+            rebuildBloomFilter();
+
+            for (int i = 0; i < BOOK_TYPE_COUNT; i++) {
+
+                typeCounts[i].total = 0;
+                typeCounts[i].available = 0;
+
+            }
+
+        }
+
+        // Function to add a book of any type to the section of its type
+        void addBook(Book* b) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_ADD_BOOK, b);
+
+            insertBook(b);
+            if (mutationLog != nullptr) {
+
+                mutationLog->logAdd(b);
+
+            }
+
+        }
+
+        // Function to remove a book of a type by title and author, throwing an error if there is none
+        Book* removeBook(int bookType, string title, string author) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_REMOVE_BOOK, bookType, title, author);
+
+            if (bookType < 1 || bookType >= BOOK_TYPE_COUNT) {
+
+                throw bookNotFoundError();
+
+            }
+            return takeBook(bookType, title, author);
+
+        }
+
+        // Function to remove Textbook
+        Textbook* removeTextbook(string title, string author) {
+
+            return static_cast<Textbook*>(removeBook(1, title, author));
+        
+        }
+        // Function to remove Fiction Book
+        FictionBook* removeFictionBook(string title, string author) {
+
+            return static_cast<FictionBook*>(removeBook(2, title, author));
+        
+        }
+
+        // Function to find books by title (searchChoice 1) or author (searchChoice 2) of one type, or of any type when
+        // bookType is 0; both are one probe of the search index, whose lists are already ordered by type, and repeated
+        // searches are served from the cache
+        //  Cached results are only dropped when a book with that title or author is added or removed. Borrowing and
+        //  returning don't change which books match, and availability is read from the books themselves.
+        vector<Book*> findBooks(const string& title, const string& author, int bookType, int searchChoice) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_FIND_BOOKS, title, author, bookType, searchChoice);
+
+            // Declaring necessary variables
+            vector<Book*> matchingBooks;
+            const string& text = (searchChoice == 1) ? title : author;
+            char filterKind = (searchChoice == 1) ? 't' : 'a';
+            if (bookType < 0 || bookType >= BOOK_TYPE_COUNT) {
+
+                return matchingBooks;
+
+            }
+
+            // Returning no results right away if the Bloom filter says there is no such title or author; the filter
+            // hashes the text as it normalizes it, so a miss allocates nothing
+            if (!bloomMightContainText(filterKind, text)) {
+
+                return matchingBooks;
+
+            }
+            string valueKey = normalizeKey(text);
+
+            string key = searchKey(bookType, searchChoice, valueKey);
+
+            // Returning the cached results if this search has been made before
+            if (searchCache.lookup(key, matchingBooks)) {
+
+                return matchingBooks;
+
+            }
+            // Loop to go through the books with the title or author, of every type
+            const vector<Book*>* books = indexedBooks(searchChoice, valueKey);
+            KeyMatcher value(searchChoice == 1 ? bookTitleKeys : bookAuthorKeys, valueKey);
+            for (size_t i = 0; books != nullptr && i < books->size(); i++) {
+
+                // If match found (of the type, for a search of one type), add it to list of matches
+                Book* b = (*books)[i];
+                if ( (bookType == 0 || b->getType() == bookType) &&
+                     value.matches(searchChoice == 1 ? b->getTitleID() : b->getAuthorID()) ) {
+
+                    matchingBooks.push_back(b);
+
+                }
+
+            }
+
+            searchCache.insert(key, matchingBooks);
+            return matchingBooks;
+
+        }
+
+        // Function for searching for a book
+        void bookSearch(string title, string author, int bookType, int searchChoice) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_BOOK_SEARCH, title, author, bookType, searchChoice);
+
+            // Vector to store books with matching titles or authors
+            vector<Book*> matchingBooks = findBooks(title, author, bookType, searchChoice);
+
+            // Throw error if no matches
+            if (matchingBooks.size() == 0) {
+
+                throw bookNotFoundError();
+
+            }
+
+            // Otherwise, display details
+            cout << "\nThere are " << matchingBooks.size() << " " << BOOK_TYPES[bookType].name << "(s) with this title or author:\n" << endl;
+
+            // Loop to display details of all books of matching title or author
+            for (size_t i = 0; i < matchingBooks.size(); i++) {
+
+                displayDetails(matchingBooks[i]);
+                matchingBooks[i]->displayAvailability();
+                cout << "" << endl;
+
+            }
+
+        }
+
+        // Function to return the number of books in a section (1 for Textbooks, 2 for Fiction Books)
+        size_t getSectionSize(int bookType) {
+
+            return (bookType >= 1 && bookType < BOOK_TYPE_COUNT) ? sections[bookType].size() : 0;
+
+        }
+
+        // Function to return a book of a section by its position; several threads may call this at once as long as
+        // the catalog isn't changing
+        Book* getSectionBook(int bookType, size_t i) {
+
+            return sections[bookType][i];
+
+        }
+
+        // Function to answer one batch query (of one book type, or of any type for type 0), returning every matching copy
+        //  Nothing is cached or counted, so several threads may call this at once as long as the catalog isn't changing
+        vector<Book*> lookup(const BatchQuery& query) {
+
+            // Declaring necessary variables
+            vector<Book*> matchingBooks;
+            string titleKey, authorKey;
+            int bookType = query.bookType;
+            if (bookType < 0 || bookType >= BOOK_TYPE_COUNT) {
+
+                return matchingBooks;
+
+            }
+
+            // By ISBN: the ISBN index says whether there are any copies (and of which type), and the search index is
+            // only probed for the copies when there is more than one
+            if (query.queryChoice == 1) {
+
+                unordered_map<uint64_t, IsbnEntry>::const_iterator entry = isbnIndex.find(query.isbn);
+                if (entry == isbnIndex.end() || (bookType != 0 && entry->second.book->getType() != bookType)) {
+
+                    return matchingBooks;
+
+                }
+                if (entry->second.copies == 1) {
+
+                    matchingBooks.push_back(entry->second.book);
+                    return matchingBooks;
+
+                }
+                titleKey = entry->second.book->getTitleKey();
+                authorKey = entry->second.book->getAuthorKey();
+
+            // By title and author, title, or author: skipping the probe if the Bloom filter says there is no match
+            } else {
+
+                // The filter hashes the title and author as it normalizes them, so a miss builds no key strings
+                if (bloomFalsePositiveRate > 0) {
+
+                    if ( (query.queryChoice == 2 && !bloomFilter.mightContainText('b', query.title, &query.author)) ||
+                         (query.queryChoice == 3 && !bloomFilter.mightContainText('t', query.title, nullptr)) ||
+                         (query.queryChoice == 4 && !bloomFilter.mightContainText('a', query.author, nullptr)) ) {
+
+                        return matchingBooks;
+
+                    }
+
+                }
+                if (query.queryChoice != 4) {
+
+                    titleKey = normalizeKey(query.title);
+
+                }
+                if (query.queryChoice != 3) {
+
+                    authorKey = normalizeKey(query.author);
+
+                }
+
+            }
+
+            // Loop to go through the books with the title (or, for an author query, the author) for those of the type
+            // with the title and author (or just one of them)
+            const vector<Book*>* books = (query.queryChoice == 4) ? indexedBooks(2, authorKey) : indexedBooks(1, titleKey);
+            KeyMatcher title(bookTitleKeys, titleKey), author(bookAuthorKeys, authorKey);
+            for (size_t i = 0; books != nullptr && i < books->size(); i++) {
+
+                Book* b = (*books)[i];
+                if ( (bookType == 0 || b->getType() == bookType) &&
+                     (query.queryChoice == 4 || title.matches(b->getTitleID())) &&
+                     (query.queryChoice == 3 || author.matches(b->getAuthorID())) &&
+                     (query.queryChoice != 1 || query.isbn == b->getISBN()) ) {
+
+                    matchingBooks.push_back(b);
+
+                }
+
+            }
+
+            return matchingBooks;
+
+        }
+
+        // Function to display all books
+        void displayBooks() {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_DISPLAY_BOOKS);
+
+            // Loop to display each type's section, starting with Textbooks
+            for (int type = 1; type < BOOK_TYPE_COUNT; type++) {
+
+                cout << "\nThere are " << sections[type].size() << " " << BOOK_TYPES[type].name << "(s):\n" << endl;
+                // Loop to display details of all books of the type
+                for (size_t i = 0; i < sections[type].size(); i++) {
+
+                    displayDetails(sections[type][i]);
+                    sections[type][i]->displayAvailability();
+                    cout << "" << endl;
+
+                }
+
+            }
+
+        }
+
+        // Function to borrow or return a book
+        void borrowOrReturn(string title, string author, int bookType, int borrowOrReturnChoice) {
+
+            // Without a library card, the book is borrowed or returned on behalf of no particular patron
+            borrowOrReturn(title, author, bookType, borrowOrReturnChoice, 0);
+
+        }
+
+        // Function to borrow or return a book on behalf of a patron (patron ID 0 means no library card)
+        void borrowOrReturn(string title, string author, int bookType, int borrowOrReturnChoice, int patronID) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_BORROW_OR_RETURN, title, author, bookType, borrowOrReturnChoice, patronID);
+
+            // Declaring necessary variables
+            Book* chosenBook = nullptr;
+            uint32_t patronSlot = PatronIndex::NONE;
+            string titleKey = normalizeKey(title), authorKey = normalizeKey(author);
+
+            // A library card must belong to a registered patron
+            if (patronID != 0) {
+
+                patronSlot = requirePatron(patronID);
+
+            }
+
+            // A patron returning a book only needs their own loans, so the sections are not scanned
+            if (borrowOrReturnChoice == 2 && patronSlot != PatronIndex::NONE) {
+
+                chosenBook = patronIndex.findLoan(patronSlot, titleKey, authorKey, bookType);
+                if (chosenBook == nullptr) {
+
+                    // Tell apart a book this library doesn't have from one the patron doesn't have
+                    if (findCopies(titleKey, authorKey, bookType).size() == 0) {
+
+                        throw bookNotFoundError();
+
+                    }
+                    throw bookNotReturnableError();
+
+                }
+
+                patronIndex.removeLoan(chosenBook);
+                finishReturn(chosenBook, bookType);
+                publishSnapshot();
+                if (mutationLog != nullptr) {
+
+                    mutationLog->logBorrowOrReturn(title, author, bookType, borrowOrReturnChoice, patronID);
+
+                }
+                return;
+
+            }
+
+            //  Vector to store matching books in case there are duplicates
+            vector<Book*> matchingBooks = findCopies(titleKey, authorKey, bookType);
+
+            // Throw error if no matches
+            if (matchingBooks.size() == 0) {
+
+                throw bookNotFoundError();
+
+            // If we are borrowing a book...
+            } else if (borrowOrReturnChoice == 1) {
+
+                // Throw error if the patron already has as many books as they are allowed
+                if (patronSlot != PatronIndex::NONE && !patronIndex.canBorrow(patronSlot)) {
+
+                    throw loanLimitReachedError();
+
+                }
+
+                // A copy that is being held for this patron is picked up first
+                if (patronID > 0) {
+
+                    for (size_t i = 0; i < matchingBooks.size(); i++) {
+
+                        unordered_map<Book*, int>::iterator held = heldCopies.find(matchingBooks[i]);
+                        if (held != heldCopies.end() && held->second == patronID) {
+
+                            chosenBook = matchingBooks[i];
+                            heldCopies.erase(held);
+                            break;
+
+                        }
+
+                    }
+
+                }
+
+                // Otherwise, loop to look through book matches/duplicates for an available one to borrow
+                if (chosenBook == nullptr) {
+
+                    for (size_t i = 0; i < matchingBooks.size(); i++) {
+
+                        // If one is available, stop loop early to borrow only that duplicate
+                        if (matchingBooks[i]->getAvailability()) {
+
+                            chosenBook = matchingBooks[i];
+                            setAvailability(chosenBook, bookType, false);
+                            break;
+
+                        }
+
+                    }
+
+                }
+
+                // If a copy was found, add it to the patron's loans and comfirm success
+                if (chosenBook != nullptr) {
+
+                    if (patronSlot != PatronIndex::NONE) {
+
+                        patronIndex.addLoan(patronSlot, chosenBook, bookType);
+
+                    }
+                    recordCoBorrow(chosenBook, bookType, patronID);
+                    if (showMessages) {
+
+                        cout << "\nThe book has been borrowed successfully!\n" << endl;
+
+                    }
+
+                // Otherwise, throw error (cannot borrow book)
+                } else {
+
+                    throw bookNotBorrowableError();
+
+                }
+
+            // If we are returning a book...
+            } else if (borrowOrReturnChoice == 2) {
+
+                // Loop to look through book matches/duplicates for one that was borrowed without a library card
+                //  (not available, not on hold, and not on a registered patron's loan list)
+                for (size_t i = 0; i < matchingBooks.size(); i++) {
+
+                    if ( !matchingBooks[i]->getAvailability() && (heldCopies.count(matchingBooks[i]) == 0) &&
+                         (patronIndex.findBorrower(matchingBooks[i]) == PatronIndex::NONE) ) {
+
+                        chosenBook = matchingBooks[i];
+                        break;
+
+                    }
+
+                }
+
+                // Throw error if there is nothing to return (cannot return book)
+                if (chosenBook == nullptr) {
+
+                    throw bookNotReturnableError();
+
+                }
+
+                finishReturn(chosenBook, bookType);
+
+            }
+
+            // Only successful borrows and returns reach this point, since failures throw
+            publishSnapshot();
+            if (mutationLog != nullptr) {
+
+                mutationLog->logBorrowOrReturn(title, author, bookType, borrowOrReturnChoice, patronID);
+
+            }
+
+        }
+
+        // Function to pick the copy each book of a batch would borrow or return, without changing anything
+        //  Throws the same errors as borrowOrReturn if any book of the batch can't be borrowed or returned
+        //  Each distinct title is looked up once, and a copy is never picked twice
+        vector<Book*> prepareBatch(const vector<BatchItem>& items, int borrowOrReturnChoice, int patronID) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_PREPARE_BATCH, items, borrowOrReturnChoice, patronID);
+
+            // Declaring necessary variables
+            vector<Book*> chosenBooks;
+            uint32_t patronSlot = PatronIndex::NONE;
+            unordered_map<string, vector<Book*> > copiesByKey;
+            vector<Book*> loans;
+            vector<int> loanTypes;
+
+            // A library card must belong to a registered patron, who must be allowed the whole batch of loans
+            if (patronID != 0) {
+
+                patronSlot = requirePatron(patronID);
+                if (borrowOrReturnChoice == 1 && !patronIndex.canBorrow(patronSlot, items.size())) {
+
+                    throw loanLimitReachedError();
+
+                }
+                if (borrowOrReturnChoice == 2) {
+
+                    patronIndex.getLoans(patronSlot, loans, loanTypes);
+
+                }
+
+            }
+
+            // Loop to pick a copy for each book of the batch
+            for (size_t i = 0; i < items.size(); i++) {
+
+                // Declaring necessary variables
+                Book* chosenBook = nullptr;
+                string titleKey = normalizeKey(items[i].title), authorKey = normalizeKey(items[i].author);
+                KeyMatcher title(bookTitleKeys, titleKey), author(bookAuthorKeys, authorKey);
+                int bookType = items[i].bookType;
+
+                // A patron returning a book only needs their own loans, so the sections are not scanned
+                if (borrowOrReturnChoice == 2 && patronSlot != PatronIndex::NONE) {
+
+                    for (size_t j = 0; j < loans.size(); j++) {
+
+                        if ( (loans[j] != nullptr) && (loanTypes[j] == bookType) &&
+                             title.matches(loans[j]->getTitleID()) && author.matches(loans[j]->getAuthorID()) ) {
+
+                            chosenBook = loans[j];
+                            loans[j] = nullptr;
+                            break;
+
+                        }
+
+                    }
+                    if (chosenBook == nullptr) {
+
+                        // Tell apart a book this library doesn't have from one the patron doesn't have
+                        if (findCopies(titleKey, authorKey, bookType).size() == 0) {
+
+                            throw bookNotFoundError();
+
+                        }
+                        throw bookNotReturnableError();
+
+                    }
+                    chosenBooks.push_back(chosenBook);
+                    continue;
+
+                }
+
+                // Looking up the copies of each distinct title only once
+                string key = bookKey(bookType, titleKey, authorKey);
+                unordered_map<string, vector<Book*> >::iterator copies = copiesByKey.find(key);
+                if (copies == copiesByKey.end()) {
+
+                    copies = copiesByKey.insert(make_pair(key, findCopies(titleKey, authorKey, bookType))).first;
+
+                }
+                vector<Book*>& matchingBooks = copies->second;
+
+                // Throw error if no matches
+                if (matchingBooks.size() == 0) {
+
+                    throw bookNotFoundError();
+
+                }
+
+                // Loop to look through the copies that haven't been picked yet by an earlier book of the batch
+                for (size_t j = 0; j < matchingBooks.size(); j++) {
+
+                    Book* copy = matchingBooks[j];
+                    if (find(chosenBooks.begin(), chosenBooks.end(), copy) != chosenBooks.end()) {
+
+                        continue;
+
+                    }
+
+                    // Borrowing: a copy held for this patron is picked up first, otherwise the first available one
+                    if (borrowOrReturnChoice == 1) {
+
+                        unordered_map<Book*, int>::iterator held = heldCopies.find(copy);
+                        if (patronID > 0 && held != heldCopies.end() && held->second == patronID) {
+
+                            chosenBook = copy;
+                            break;
+
+                        }
+                        if (chosenBook == nullptr && copy->getAvailability()) {
+
+                            chosenBook = copy;
+
+                        }
+
+                    // Returning without a card: a copy that was borrowed without a library card
+                    } else if ( !copy->getAvailability() && (heldCopies.count(copy) == 0) &&
+                                (patronIndex.findBorrower(copy) == PatronIndex::NONE) ) {
+
+                        chosenBook = copy;
+                        break;
+
+                    }
+
+                }
+
+                // Throw error if this book has no copy left to borrow or return
+                if (chosenBook == nullptr) {
+
+                    if (borrowOrReturnChoice == 1) {
+
+                        throw bookNotBorrowableError();
+
+                    }
+                    throw bookNotReturnableError();
+
+                }
+                chosenBooks.push_back(chosenBook);
+
+            }
+
+            return chosenBooks;
+
+        }
+
+        // Function to borrow or return the copies prepareBatch picked; the library must not have changed in between
+        //  The whole batch is written to the log as a single record. The trace records the items rather than the
+        //  copies, so a replay picks them again with prepareBatch (which, with nothing changed, picks the same ones).
+        void commitBatch(const vector<BatchItem>& items, int borrowOrReturnChoice, int patronID, const vector<Book*>& chosenBooks) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_COMMIT_BATCH, items, borrowOrReturnChoice, patronID);
+
+            // Declaring necessary variables
+            uint32_t patronSlot = (patronID != 0) ? patronIndex.findPatron(patronID) : PatronIndex::NONE;
+            bool wasShowingMessages = showMessages;
+
+            // Messages are shown once for the whole batch instead of once per book
+            showMessages = false;
+            for (size_t i = 0; i < chosenBooks.size(); i++) {
+
+                Book* chosenBook = chosenBooks[i];
+                int bookType = items[i].bookType;
+
+                // Borrowing a copy, which was either held for this patron or on the shelf
+                if (borrowOrReturnChoice == 1) {
+
+                    if (heldCopies.erase(chosenBook) == 0) {
+
+                        setAvailability(chosenBook, bookType, false);
+
+                    }
+                    if (patronSlot != PatronIndex::NONE) {
+
+                        patronIndex.addLoan(patronSlot, chosenBook, bookType);
+
+                    }
+                    recordCoBorrow(chosenBook, bookType, patronID);
+
+                // Returning a copy
+                } else {
+
+                    patronIndex.removeLoan(chosenBook);
+                    finishReturn(chosenBook, bookType);
+
+                }
+
+            }
+            showMessages = wasShowingMessages;
+            publishSnapshot();
+
+            if (showMessages) {
+
+                cout << "\nAll " << chosenBooks.size() << " book(s) have been " << (borrowOrReturnChoice == 1 ? "borrowed" : "returned")
+                     << " successfully!\n" << endl;
+
+            }
+            if (mutationLog != nullptr) {
+
+                mutationLog->logBorrowOrReturnBatch(items, borrowOrReturnChoice, patronID);
+
+            }
+
+        }
+
+        // Function to borrow or return several books at once on behalf of a patron (patron ID 0 means no library card)
+        //  Either every book is borrowed or returned, or (if any of them can't be) none are and the error is thrown
+        void borrowOrReturnBatch(const vector<BatchItem>& items, int borrowOrReturnChoice, int patronID) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_BORROW_OR_RETURN_BATCH, items, borrowOrReturnChoice, patronID);
+
+            vector<Book*> chosenBooks = prepareBatch(items, borrowOrReturnChoice, patronID);
+            commitBatch(items, borrowOrReturnChoice, patronID, chosenBooks);
+
+        }
+
+        // Function to place a hold on a book when every copy is out; returns the patron's position in line
+        size_t placeHold(string title, string author, int bookType, int patronID) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_PLACE_HOLD, title, author, bookType, patronID);
+
+            // Throw error if the patron ID is not valid or not registered
+            if (patronID <= 0) {
+
+                throw invalidPatronError();
+
+            }
+            requirePatron(patronID);
+            string titleKey = normalizeKey(title), authorKey = normalizeKey(author);
+
+            //  Vector to store matching books in case there are duplicates
+            vector<Book*> matchingBooks = findCopies(titleKey, authorKey, bookType);
+
+            // Throw error if no matches
+            if (matchingBooks.size() == 0) {
+
+                throw bookNotFoundError();
+
+            }
+
+            // Loop to make sure no copy is on the shelf and no copy is already held for this patron
+            for (size_t i = 0; i < matchingBooks.size(); i++) {
+
+                if (matchingBooks[i]->getAvailability()) {
+
+                    throw holdNotNeededError();
+
+                }
+
+                unordered_map<Book*, int>::iterator held = heldCopies.find(matchingBooks[i]);
+                if (held != heldCopies.end() && held->second == patronID) {
+
+                    throw duplicateHoldError();
+
+                }
+
+            }
+
+            // Adding the patron to the back of the queue
+            HoldQueue& queue = holdQueues[bookKey(bookType, titleKey, authorKey)];
+            if (queue.contains(patronID)) {
+
+                throw duplicateHoldError();
+
+            }
+            queue.push(patronID);
+            if (mutationLog != nullptr) {
+
+                mutationLog->logPlaceHold(title, author, bookType, patronID);
+
+            }
+
+            return queue.size();
+
+        }
+
+        // Function to return the number of patrons waiting for a book
+        size_t getHoldQueueLength(string title, string author, int bookType) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_GET_HOLD_QUEUE_LENGTH, title, author, bookType);
+
+            unordered_map<string, HoldQueue>::iterator queue = holdQueues.find(bookKey(bookType, normalizeKey(title), normalizeKey(author)));
+            if (queue == holdQueues.end()) {
+
+                return 0;
+
+            }
+
+            return queue->second.size();
+
+        }
+
+        // Function to register a patron with the default loan limit
+        void registerPatron(int patronID) {
+
+            registerPatron(patronID, DEFAULT_MAX_LOANS);
+
+        }
+
+        // Function to register a patron with a given limit on the number of books on loan at once
+        void registerPatron(int patronID, int maxLoans) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_REGISTER_PATRON, patronID, maxLoans);
+
+            // Throw error if the patron ID or the limit is not valid
+            if (patronID <= 0 || maxLoans <= 0 || maxLoans > 0xFFFF) {
+
+                throw invalidPatronError();
+
+            }
+
+            // Throw error if the patron ID is already registered
+            if (!patronIndex.registerPatron(patronID, maxLoans)) {
+
+                throw duplicatePatronError();
+
+            }
+            if (mutationLog != nullptr) {
+
+                mutationLog->logRegisterPatron(patronID, maxLoans);
+
+            }
+
+        }
+
+        // Function to return the books a patron has on loan
+        vector<Book*> getPatronLoans(int patronID) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_GET_PATRON_LOANS, patronID);
+
+            vector<Book*> books;
+            vector<int> bookTypes;
+            patronIndex.getLoans(requirePatron(patronID), books, bookTypes);
+            return books;
+
+        }
+
+        // Function to display the books a patron has on loan
+        void displayPatronLoans(int patronID) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_DISPLAY_PATRON_LOANS, patronID);
+
+            // Declaring necessary variables
+            vector<Book*> books;
+            vector<int> bookTypes;
+            patronIndex.getLoans(requirePatron(patronID), books, bookTypes);
+
+            cout << "\nPatron " << patronID << " has " << books.size() << " book(s) on loan:\n" << endl;
+            // Loop to display details of all books on loan, depending on their type
+            for (size_t i = 0; i < books.size(); i++) {
+
+                displayDetails(books[i]);
+                cout << "" << endl;
+
+            }
+
+        }
+
+        // Function to return the counts for one genre (facetChoice 1), course (facetChoice 2), or author (facetChoice 3)
+        FacetCounts getFacetCounts(int facetChoice, string value) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_GET_FACET_COUNTS, facetChoice, value);
+
+            // Declaring necessary variables
+            FacetCounts none = {0, 0};
+
+            // Genres and courses are counted in the facet index
+            if (facetChoice == 1) {
+
+                return facetIndex.getCounts(FacetFilter::GENRE, value);
+
+            } else if (facetChoice == 2) {
+
+                return facetIndex.getCounts(FacetFilter::COURSE, value);
+
+            } else if (facetChoice != 3) {
+
+                return none;
+
+            }
+
+            long authorID = bookAuthorKeys.find(normalizeKey(value));
+            unordered_map<uint32_t, FacetCounts>::iterator c = (authorID < 0) ? authorCounts.end() : authorCounts.find(authorID);
+            if (c == authorCounts.end()) {
+
+                return none;
+
+            }
+
+            return c->second;
+
+        }
+
+        // Function to attach the log every later change is written to (nullptr to stop logging)
+        void attachMutationLog(MutationLog* log) {
+
+            mutationLog = log;
+
+        }
+
+        // Function to attach the recorder every later call is traced to (nullptr to stop tracing)
+        void attachTraceRecorder(TraceRecorder* recorder) {
+
+            traceRecorder = recorder;
+
+        }
+
+        // Function to show or hide the messages borrowOrReturn displays
+        void setShowMessages(bool show) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_SET_SHOW_MESSAGES, show);
+
+            showMessages = show;
+
+        }
+
+        // Function to return every distinct title key (normalized title, of any type) that starts with a prefix, in
+        // sorted order; the prefix is normalized the same way, so "the h" finds "The Hobbit"
+        vector<string> findTitlesWithPrefix(string prefix) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_FIND_TITLES_WITH_PREFIX, prefix);
+
+            vector<string> titles;
+            bookTitleKeys.forEachWithPrefix(normalizeKey(prefix), [&](uint32_t id, const string& key) {
+
+                if (id < titleCopies.size() && titleCopies[id] > 0) {
+
+                    titles.push_back(key);
+
+                }
+
+            });
+            return titles;
+
+        }
+
+        // Function to compare the memory the title and author keys of this library's books would use as two strings per
+        // book with what they use as a dictionary ID each in the shared key dictionaries
+        DictionaryReport getDictionaryReport() {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_GET_DICTIONARY_REPORT);
+
+            DictionaryReport report;
+            report.books = 0;
+            report.distinctTitles = titleCopies.size() - count(titleCopies.begin(), titleCopies.end(), 0);
+            report.distinctAuthors = authorCopies.size() - count(authorCopies.begin(), authorCopies.end(), 0);
+            report.stringBytes = 0;
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                report.books += sections[bookType].size();
+                for (size_t i = 0; i < sections[bookType].size(); i++) {
+
+                    report.stringBytes += stringFootprint(sections[bookType][i]->getTitleKey()) + stringFootprint(sections[bookType][i]->getAuthorKey());
+
+                }
+
+            }
+            MemoryComponent keys = {"Title and author keys", 0, 0, 0};
+            bookTitleKeys.countMemory(keys);
+            bookAuthorKeys.countMemory(keys);
+            report.dictionaryBytes = keys.blockBytes + report.books * 2 * sizeof(uint32_t);
+            return report;
+
+        }
+
+        // Function to set the false positive rate of the Bloom filter and rebuild it (0 turns it off)
+        void configureBloomFilters(double falsePositiveRate) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_CONFIGURE_BLOOM_FILTERS, TraceRecorder::doubleBits(falsePositiveRate));
+
+            bloomFalsePositiveRate = (falsePositiveRate > 0 && falsePositiveRate < 1) ? falsePositiveRate : 0;
+            rebuildBloomFilter();
+
+        }
+
+        // Function to return how often the Bloom filter was checked and rejected a lookup, and its size
+        BloomFilterStats getBloomFilterStats() {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_GET_BLOOM_FILTER_STATS);
+
+            BloomFilterStats stats = bloomStats;
+            stats.keys = bloomFilter.size();
+            stats.bytes = bloomFilter.memoryUsage();
+            return stats;
+
+        }
+
+        // Function to return how many copies of a book were on the shelf at a time (seconds since 1970)
+        int getAvailableCopiesAt(string title, string author, int bookType, int64_t time) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_GET_AVAILABLE_COPIES_AT, title, author, bookType, time);
+
+            return availabilityHistory.availableAt(bookKey(bookType, normalizeKey(title), normalizeKey(author)), time);
+
+        }
+
+        // Function to summarize a book's availability between two times (seconds since 1970)
+        AvailabilityWindow getAvailabilityWindow(string title, string author, int bookType, int64_t from, int64_t to) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_GET_AVAILABILITY_WINDOW, title, author, bookType, from, to);
+
+            return availabilityHistory.window(bookKey(bookType, normalizeKey(title), normalizeKey(author)), from, to);
+
+        }
+
+        // Function to return up to k titles patrons borrowed along with a book, best first
+        vector<Recommendation> getRecommendations(string title, string author, int bookType, size_t k) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_GET_RECOMMENDATIONS, title, author, bookType, k);
+
+            return coBorrowGraph.recommend(bookKey(bookType, normalizeKey(title), normalizeKey(author)), k);
+
+        }
+
+        // Function to display up to k titles patrons borrowed along with a book (nothing if there are none)
+        void displayRecommendations(string title, string author, int bookType, size_t k) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_DISPLAY_RECOMMENDATIONS, title, author, bookType, k);
+
+            vector<Recommendation> recommendations = getRecommendations(title, author, bookType, k);
+            if (recommendations.empty()) {
+
+                return;
+
+            }
+            cout << "Patrons who borrowed this also borrowed:" << endl;
+            for (size_t i = 0; i < recommendations.size(); i++) {
+
+                cout << "\t" << recommendations[i].title << " by " << recommendations[i].author
+                     << " (" << BOOK_TYPES[recommendations[i].bookType].name << ")" << endl;
+
+            }
+            cout << "" << endl;
+
+        }
+
+        // Function to return the books in every section a facet filter matches (at most limit of them) and the facet
+        // counts of every match
+        FilterResult filterBooks(const FacetFilter& filter, size_t limit) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_FILTER_BOOKS, filter, limit);
+
+            return facetIndex.filter(filter, limit);
+
+        }
+
+        // Function to display the books a facet filter matches (at most limit of them) and the facet counts of every match
+        void displayFilteredBooks(const FacetFilter& filter, size_t limit) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_DISPLAY_FILTERED_BOOKS, filter, limit);
+
+            FilterResult result = filterBooks(filter, limit);
+            cout << "\nThere are " << result.matches << " matching book(s)";
+            if (result.matches > result.books.size()) {
+
+                cout << "; the first " << result.books.size() << " are";
+
+            }
+            cout << ":\n" << endl;
+            for (size_t i = 0; i < result.books.size(); i++) {
+
+                displayDetails(result.books[i]);
+                result.books[i]->displayAvailability();
+                cout << "" << endl;
+
+            }
+
+            for (size_t i = 0; i < result.facets.size(); i++) {
+
+                if (i == 0 || result.facets[i].field != result.facets[i - 1].field) {
+
+                    cout << "By " << FACET_FIELD_NAMES[result.facets[i].field] << ":" << endl;
+
+                }
+                cout << "\t" << result.facets[i].value << ": " << result.facets[i].count << endl;
+
+            }
+            cout << "" << endl;
+
+        }
+
+        // Function to change how long after one borrow another by the same patron counts as the same session (seconds)
+        void setSessionWindow(int64_t seconds) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_SET_SESSION_WINDOW, seconds);
+
+            coBorrowGraph.setSessionWindow(seconds);
+
+        }
+
+        // Function to fix the time (seconds since 1970) later changes are recorded at in the availability history, as when
+        // replaying a log; 0 goes back to the clock
+        void setHistoryTime(int64_t seconds) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_SET_HISTORY_TIME, seconds);
+
+            historyTime = seconds;
+
+        }
+
+        // Function to page the details (genre, course, edition, main character, setting) of every book still holding
+        // them in memory out to a new memory-mapped file, created at path plus a unique suffix; returns the number of
+        // books paged out (0 if the file failed)
+        //  Displays read the details back from the file; searches, statistics, borrowing, and returning never do (genre
+        //  and course counts go through the value IDs the facet index keeps per book)
+        size_t pageOutDetails(string path) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_PAGE_OUT_DETAILS, path);
+
+            // Declaring necessary variables
+            shared_ptr<DetailFile> file = make_shared<DetailFile>(path);
+            vector<Book*> books;
+            vector<uint64_t> offsets;
+            if (!file->isOpen()) {
+
+                return 0;
+
+            }
+
+            // Writing the details of every section
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                for (size_t i = 0; i < sections[bookType].size(); i++) {
+
+                    Book* b = sections[bookType][i];
+                    if (!b->detailsPagedOut()) {
+
+                        books.push_back(b);
+                        offsets.push_back(file->append(b->getDetails()));
+
+                    }
+
+                }
+
+            }
+
+            // Only dropping the details from memory once the whole file can be read back
+            if (books.empty() || !file->finish()) {
+
+                return 0;
+
+            }
+            for (size_t i = 0; i < books.size(); i++) {
+
+                books[i]->pageOutDetails(file, offsets[i]);
+
+            }
+            return books.size();
+
+        }
+
+        // Function to turn snapshot reads on or off; no snapshot may be held while they are turned off
+        //  While they are on, every change is also made to a copy of the catalog that readers can pin
+        void enableSnapshots(bool on) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_ENABLE_SNAPSHOTS, on);
+
+            if (!on) {
+
+                catalogVersions.reset();
+                return;
+
+            }
+            if (catalogVersions) {
+
+                return;
+
+            }
+
+            catalogVersions.reset(new CatalogVersions());
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                for (size_t i = 0; i < sections[bookType].size(); i++) {
+
+                    catalogVersions->addBook(sections[bookType][i], bookType);
+
+                }
+
+            }
+            catalogVersions->publish();
+
+        }
+
+        // Function to pin a consistent version of the catalog (every book and its availability)
+        //  Safe to call from other threads while one thread changes the library; the snapshot never sees part of
+        //  an operation, and the writer never waits for it
+        CatalogSnapshot snapshot() {
+
+            if (!catalogVersions) {
+
+                throw snapshotsDisabledError();
+
+            }
+            return CatalogSnapshot(catalogVersions.get());
+
+        }
+
+        // Function to change the number of searches the search cache keeps; this empties the cache
+        void setSearchCacheSize(size_t capacity) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_SET_SEARCH_CACHE_SIZE, capacity);
+
+            searchCache.resize(capacity);
+
+        }
+
+        // Function to return the search cache metrics
+        SearchCacheMetrics getSearchCacheMetrics() {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_GET_SEARCH_CACHE_METRICS);
+
+            return searchCache.getMetrics();
+
+        }
+
+        // Function to return the counts for one book type
+        FacetCounts getTypeCounts(int bookType) {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_GET_TYPE_COUNTS, bookType);
+
+            FacetCounts none = {0, 0};
+            if (bookType < 1 || bookType >= BOOK_TYPE_COUNT) {
+
+                return none;
+
+            }
+
+            return typeCounts[bookType];
+
+        }
+
+        // Function to break the heap memory the library uses down by component, with the bytes per book
+        //  Counts what each component asked the allocator for and estimates the allocator's overhead on top; paged
+        //  out details are counted separately, as memory-mapped file pages rather than heap
+        MemoryReport getMemoryReport() {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_GET_MEMORY_REPORT);
+
+            // Declaring necessary variables
+            MemoryReport report;
+            MemoryComponent objects = {"Book objects", 0, 0, 0}, strings = {"Book strings", 0, 0, 0};
+            MemoryComponent cold = {"Book details in memory", 0, 0, 0}, sectionVectors = {"Section vectors", 0, 0, 0};
+            MemoryComponent slack = {"Section vector slack", 0, 0, 0}, index = {"Search index", 0, 0, 0};
+            MemoryComponent isbns = {"ISBN index", 0, 0, 0}, statistics = {"Catalog statistics", 0, 0, 0};
+            MemoryComponent holds = {"Holds", 0, 0, 0}, patrons = {"Patrons and loans", 0, 0, 0};
+            MemoryComponent cache = {"Search cache", 0, 0, 0}, dictionaries = {"Title and author dictionaries", 0, 0, 0};
+            MemoryComponent blooms = {"Bloom filters", 0, 0, 0}, history = {"Availability history", 0, 0, 0};
+            MemoryComponent versions = {"Snapshot versions", 0, 0, 0}, files = {"Detail files", 0, 0, 0};
+            MemoryComponent graph = {"Co-borrow graph", 0, 0, 0}, facetBitmaps = {"Facet bitmaps", 0, 0, 0};
+            vector<DetailFile*> detailFiles;
+            report.books = 0;
+            report.mappedBytes = 0;
+
+            // Books, and the sections pointing at them (the used part of each buffer, then the slack)
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                const vector<Book*>& section = sections[bookType];
+                report.books += section.size();
+                for (size_t i = 0; i < section.size(); i++) {
+
+                    countAllocation(objects, BOOK_TYPES[bookType].objectSize);
+                    section[i]->countMemory(strings, cold);
+                    if (section[i]->getDetailFile() != nullptr) {
+
+                        detailFiles.push_back(section[i]->getDetailFile());
+
+                    }
+
+                }
+                if (section.capacity() == 0) {
+
+                    continue;
+
+                }
+                size_t block = heapBlockBytes(section.capacity() * sizeof(Book*));
+                sectionVectors.bytes += section.size() * sizeof(Book*);
+                sectionVectors.allocations++;
+                sectionVectors.blockBytes += block - (section.capacity() - section.size()) * sizeof(Book*);
+                slack.bytes += (section.capacity() - section.size()) * sizeof(Book*);
+                slack.blockBytes += (section.capacity() - section.size()) * sizeof(Book*);
+
+            }
+
+            // Indexes and statistics
+            countHashMap(index, searchIndex);
+            for (unordered_map<uint64_t, vector<Book*> >::iterator list = searchIndex.begin(); list != searchIndex.end(); list++) {
+
+                countVector(index, list->second);
+
+            }
+            countHashMap(isbns, isbnIndex);
+            bloomFilter.countMemory(blooms);
+            countHashMap(statistics, authorCounts);
+            countHashMap(holds, holdQueues);
+            for (unordered_map<string, HoldQueue>::iterator q = holdQueues.begin(); q != holdQueues.end(); q++) {
+
+                countString(holds, q->first);
+                q->second.countMemory(holds);
+
+            }
+            countHashMap(holds, heldCopies);
+            patronIndex.countMemory(patrons);
+            searchCache.countMemory(cache);
+            // The key dictionaries are shared by every library; they are counted in full here
+            bookTitleKeys.countMemory(dictionaries);
+            bookAuthorKeys.countMemory(dictionaries);
+            countVector(dictionaries, titleCopies);
+            countVector(dictionaries, authorCopies);
+            availabilityHistory.countMemory(history);
+            coBorrowGraph.countMemory(graph);
+            facetIndex.countMemory(facetBitmaps);
+            if (catalogVersions) {
+
+                catalogVersions->countMemory(versions);
+
+            }
+
+            // Each detail file once, however many books use it
+            sort(detailFiles.begin(), detailFiles.end());
+            detailFiles.erase(unique(detailFiles.begin(), detailFiles.end()), detailFiles.end());
+            for (size_t i = 0; i < detailFiles.size(); i++) {
+
+                detailFiles[i]->countMemory(files);
+                report.mappedBytes += detailFiles[i]->getMappedSize();
+
+            }
+
+            MemoryComponent all[] = {objects, strings, cold, sectionVectors, slack, index, isbns, statistics, holds, patrons,
+                                     cache, dictionaries, blooms, history, graph, facetBitmaps, versions, files};
+            report.components.assign(all, all + sizeof(all) / sizeof(all[0]));
+            return report;
+
+        }
+
+        // Function to display the memory report
+        void displayMemoryReport() {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_DISPLAY_MEMORY_REPORT);
+
+            // Declaring necessary variables
+            MemoryReport report = getMemoryReport();
+            size_t bytes = 0, allocations = 0, blockBytes = 0;
+
+            cout << "\nHeap memory of " << report.books << " books (bytes requested, allocations, bytes with allocator overhead):" << endl;
+            for (size_t i = 0; i < report.components.size(); i++) {
+
+                MemoryComponent& c = report.components[i];
+                cout << "\t" << c.name << ": " << c.bytes << " bytes, " << c.allocations << " allocations, " << c.blockBytes << " bytes" << endl;
+                bytes += c.bytes;
+                allocations += c.allocations;
+                blockBytes += c.blockBytes;
+
+            }
+            cout << "\tTotal: " << bytes << " bytes requested in " << allocations << " allocations, " << (blockBytes - bytes)
+                 << " bytes of allocator overhead, " << blockBytes << " bytes in the heap" << endl;
+            cout << "\tPer book: " << (report.books == 0 ? 0.0 : (double) blockBytes / report.books) << " bytes" << endl;
+            cout << "\tPaged out details: " << report.mappedBytes << " bytes of memory-mapped file\n" << endl;
+
+        }
+
+        // Function to display catalog statistics by type and by each facet field
+        void displayCatalogStats() {
+
+            TraceCall trace(traceRecorder, TraceRecorder::OP_DISPLAY_CATALOG_STATS);
+
+            cout << "" << endl;
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                cout << BOOK_TYPES[bookType].pluralName << ": " << typeCounts[bookType].total << " copies, " << typeCounts[bookType].available
+                     << " available, " << (typeCounts[bookType].total - typeCounts[bookType].available) << " checked out or on hold." << endl;
+
+            }
+
+            // Counts by each facet field, from the facet index
+            for (int field = FacetFilter::GENRE; field <= FACET_FIELD_COUNT; field++) {
+
+                cout << "\nBy " << normalizeKey(FACET_FIELD_NAMES[field]) << ":" << endl;
+                facetIndex.forEachValue(field, [](const string& value, const FacetCounts& counts) {
+
+                    cout << "\t" << value << ": " << counts.total << " copies, " << counts.available << " available" << endl;
+
+                });
+
+            }
+
+            // Search cache metrics
+            SearchCacheMetrics cache = searchCache.getMetrics();
+            uint64_t lookups = cache.hits + cache.misses;
+            cout << "\nSearch cache: " << cache.entries << " searches cached, " << cache.hits << " hits out of " << lookups << " lookups ("
+                 << (lookups == 0 ? 0.0 : 100.0 * cache.hits / lookups) << "%), " << cache.evictions << " evictions, "
+                 << cache.invalidations << " invalidations, about " << cache.bytes << " bytes." << endl;
+
+            // Availability history size
+            size_t changes = availabilityHistory.size(), historyBytes = availabilityHistory.memoryUsage();
+            cout << "Availability history: " << changes << " changes recorded in " << historyBytes << " bytes ("
+                 << (changes == 0 ? 0.0 : (double) historyBytes / changes) << " bytes per change)." << endl;
+
+            // Co-borrow graph size
+            cout << "Co-borrow graph: " << coBorrowGraph.getTitleCount() << " titles, " << coBorrowGraph.getLinkCount()
+                 << " links between titles borrowed together." << endl;
+
+            // Facet bitmap values
+            cout << "Facet bitmaps: ";
+            for (int field = FacetFilter::GENRE; field <= FACET_FIELD_COUNT; field++) {
+
+                cout << facetIndex.getValueCount(field) << " " << normalizeKey(FACET_FIELD_NAMES[field]) << "s" << (field < FACET_FIELD_COUNT ? ", " : ".\n");
+
+            }
+
+            // Heap memory, without the breakdown by component
+            MemoryReport memory = getMemoryReport();
+            size_t heapBytes = 0;
+            for (size_t i = 0; i < memory.components.size(); i++) {
+
+                heapBytes += memory.components[i].blockBytes;
+
+            }
+            cout << "Memory: about " << heapBytes << " bytes of heap (" << (memory.books == 0 ? 0.0 : (double) heapBytes / memory.books)
+                 << " bytes per book)." << endl;
+            cout << "" << endl;
+
+        }
+
+};
+
+
+// ReplicationLag struct
+//  How far a follower is behind its leader: the last sequence number applied, how long after the leader wrote it the
+//  follower applied it, and how many bytes of the log have been written but not yet applied
+struct ReplicationLag {
+    uint64_t appliedSequence;
+    int64_t lagMicros;
+    uint64_t bytesBehind;
+    uint64_t applyErrors;
+};
+
+
+// LogFollower class
+//  Applies the records a leader appends to a MutationLog to a follower Library. Each call to poll reads whatever has
+//  been appended since the last call; a record the leader is still writing is left for the next poll. A log whose
+//  header isn't the current format version (or that has none) is refused rather than misread, and nothing is applied.
+class LogFollower {
+
+    // Private members
+    private:
+        string path;
+        Library* library;
+        uint64_t offset;
+        ReplicationLag lag;
+        bool compatible;
+
+        // Function to apply one record; returns false if the record is malformed
+        bool apply(const char* p, const char* end) {
+
+            // Declaring necessary variables
+            uint8_t op = (uint8_t) *p++;
+            uint64_t sequence, bookType, choice;
+            int64_t timestamp, isbn, patronID, maxLoans;
+            string title, author, genre, field1, field2;
+
+            if (!readVarint(p, end, sequence) || !readSignedVarint(p, end, timestamp)) {
+
+                return false;
+
+            }
+
+            // Applying the change at the time the leader made it; an error means the replica has diverged from the
+            // leader, so it is only counted
+            library->setHistoryTime(timestamp / 1000000);
+            try {
+
+                if (op == MutationLog::OP_ADD_BOOK) {
+
+                    if (!readVarint(p, end, bookType) || !readString(p, end, title) || !readString(p, end, author) ||
+                        !readSignedVarint(p, end, isbn) || !readString(p, end, genre) || !readString(p, end, field1) ||
+                        !readString(p, end, field2)) {
+
+                        return false;
+
+                    }
+
+                    Book* b = createBook((int) bookType, title, author, (uint64_t) isbn, genre, field1, field2);
+                    if (b == nullptr) {
+
+                        return false;
+
+                    }
+                    try {
+
+                        library->addBook(b);
+
+                    } catch (...) {
+
+                        delete b;
+                        throw;
+
+                    }
+
+                } else if (op == MutationLog::OP_REMOVE_BOOK) {
+
+                    if (!readVarint(p, end, bookType) || !readString(p, end, title) || !readString(p, end, author)) {
+
+                        return false;
+
+                    }
+                    delete library->removeBook((int) bookType, title, author);
+
+                } else if (op == MutationLog::OP_BORROW_OR_RETURN) {
+
+                    if (!readString(p, end, title) || !readString(p, end, author) || !readVarint(p, end, bookType) ||
+                        !readVarint(p, end, choice) || !readSignedVarint(p, end, patronID)) {
+
+                        return false;
+
+                    }
+                    library->borrowOrReturn(title, author, (int) bookType, (int) choice, (int) patronID);
+
+                } else if (op == MutationLog::OP_BORROW_OR_RETURN_BATCH) {
+
+                    uint64_t itemCount;
+                    if (!readVarint(p, end, choice) || !readSignedVarint(p, end, patronID) || !readVarint(p, end, itemCount)) {
+
+                        return false;
+
+                    }
+                    vector<BatchItem> items;
+                    for (uint64_t i = 0; i < itemCount; i++) {
+
+                        BatchItem item;
+                        if (!readVarint(p, end, bookType) || !readString(p, end, item.title) || !readString(p, end, item.author)) {
+
+                            return false;
+
+                        }
+                        item.bookType = (int) bookType;
+                        items.push_back(item);
+
+                    }
+                    library->borrowOrReturnBatch(items, (int) choice, (int) patronID);
+
+                } else if (op == MutationLog::OP_REGISTER_PATRON) {
+
+                    if (!readSignedVarint(p, end, patronID) || !readSignedVarint(p, end, maxLoans)) {
+
+                        return false;
+
+                    }
+                    library->registerPatron((int) patronID, (int) maxLoans);
+
+                } else if (op == MutationLog::OP_PLACE_HOLD) {
+
+                    if (!readString(p, end, title) || !readString(p, end, author) || !readVarint(p, end, bookType) ||
+                        !readSignedVarint(p, end, patronID)) {
+
+                        return false;
+
+                    }
+                    library->placeHold(title, author, (int) bookType, (int) patronID);
+
+                } else {
+
+                    return false;
+
+                }
+
+            } catch (...) {
+
+                lag.applyErrors++;
+
+            }
+
+            lag.appliedSequence = sequence;
+            lag.lagMicros = wallClockMicros() - timestamp;
+            return true;
+
+        }
+
+    // Public member functions
+    public:
+
+        // Constructor with the log file path and the library the log is applied to
+        LogFollower(string logPath, Library* follower) {
+
+            path = logPath;
+            library = follower;
+            offset = 0;
+            lag.appliedSequence = 0;
+            lag.lagMicros = 0;
+            lag.bytesBehind = 0;
+            lag.applyErrors = 0;
+            compatible = true;
+
+        }
+
+        // Function to apply every complete record appended since the last poll; returns the number of records applied
+        size_t poll() {
+
+            // Reading everything past the current offset
+            ifstream file(path.c_str(), ios::binary);
+            if (!compatible || !file.is_open()) {
+
+                return 0;
+
+            }
+            file.seekg(0, ios::end);
+            uint64_t size = (uint64_t) file.tellg();
+            if (size <= offset) {
+
+                lag.bytesBehind = 0;
+                return 0;
+
+            }
+            string buffer((size_t) (size - offset), '\0');
+            file.seekg((streamoff) offset);
+            file.read(&buffer[0], buffer.size());
+
+            // Checking the header before the first record (a header the leader is still writing is left for the next
+            // poll)
+            size_t applied = 0;
+            const char* p = buffer.data();
+            const char* end = p + buffer.size();
+            if (offset == 0) {
+
+                size_t magicLength = strlen(MutationLog::MAGIC);
+                uint64_t version;
+                if (buffer.compare(0, min(buffer.size(), magicLength), MutationLog::MAGIC, min(buffer.size(), magicLength)) != 0) {
+
+                    compatible = false;
+                    return 0;
+
+                }
+                p += min(buffer.size(), magicLength);
+                if (buffer.size() <= magicLength || !readVarint(p, end, version)) {
+
+                    return 0;
+
+                }
+                if (version != MutationLog::FORMAT_VERSION) {
+
+                    compatible = false;
+                    return 0;
+
+                }
+
+            }
+
+            // Loop to apply each complete record
+            while (p < end) {
+
+                const char* recordStart = p;
+                uint64_t length;
+                if (!readVarint(p, end, length) || length == 0 || length > (uint64_t) (end - p)) {
+
+                    p = recordStart;
+                    break;
+
+                }
+                if (!apply(p, p + length)) {
+
+                    lag.applyErrors++;
+
+                }
+                p += length;
+                applied++;
+
+            }
+            library->setHistoryTime(0);
+
+            offset += (uint64_t) (p - buffer.data());
+            lag.bytesBehind = size - offset;
+            return applied;
+
+        }
+
+        // Function to return the replication lag metrics
+        ReplicationLag getLag() {
+
+            return lag;
+
+        }
+
+        // Function to check if the log is one this version can replay (false once a header of another format version,
+        // or no header, has been found)
+        bool isCompatible() {
+
+            return compatible;
+
+        }
+
+};
+
+
+// TraceOpStats struct
+//  What replaying one kind of traced call found: how many calls there were, how many threw, how many had a different
+//  outcome than when they were recorded, and the duration of each call when recorded and when replayed (nanoseconds)
+struct TraceOpStats {
+    uint64_t calls;
+    uint64_t errors;
+    uint64_t mismatches;
+    vector<int64_t> recordedNanos;
+    vector<int64_t> replayedNanos;
+};
+
+
+// TraceReplayer class
+//  Re-executes the calls a TraceRecorder traced against a fresh Library, either as fast as possible or at the pace
+//  they were recorded, and reports the latency of each kind of call when recorded and when replayed. Each call is
+//  made at the library time it was recorded at, so patron sessions and availability history come out the same.
+class TraceReplayer {
+
+    // Private members
+    private:
+        struct TracedCall {
+            uint8_t op;
+            int64_t offsetNanos;
+            int64_t durationNanos;
+            bool threw;
+            string arguments;
+        };
+        string path;
+        uint64_t version;
+        int64_t startMicros;
+        vector<TracedCall> calls;
+
+        // Function to read a book's type tag and fields and create it; returns nullptr if the arguments are malformed
+        static Book* readBook(const char*& p, const char* end) {
+
+            string title, author, genre, field1, field2;
+            uint64_t bookType;
+            int64_t isbn;
+            if (!readVarint(p, end, bookType) || !readString(p, end, title) || !readString(p, end, author) ||
+                !readSignedVarint(p, end, isbn) || !readString(p, end, genre) || !readString(p, end, field1) ||
+                !readString(p, end, field2)) {
+
+                return nullptr;
+
+            }
+            return createBook((int) bookType, title, author, (uint64_t) isbn, genre, field1, field2);
+
+        }
+
+        // Function to read a facet filter; returns false if it is malformed
+        static bool readFilter(const char*& p, const char* end, FacetFilter& filter, int depth) {
+
+            uint64_t op, count;
+            if (depth > 64 || !readVarint(p, end, op) || op > FacetFilter::NOT) {
+
+                return false;
+
+            }
+            filter.op = (int) op;
+            filter.field = 0;
+            if (op == FacetFilter::TERM) {
+
+                uint64_t field;
+                if (!readVarint(p, end, field) || !readString(p, end, filter.value)) {
+
+                    return false;
+
+                }
+                filter.field = (int) field;
+                return true;
+
+            }
+            if (!readVarint(p, end, count) || count > (uint64_t) (end - p)) {
+
+                return false;
+
+            }
+            filter.operands.resize((size_t) count);
+            for (size_t i = 0; i < filter.operands.size(); i++) {
+
+                if (!readFilter(p, end, filter.operands[i], depth + 1)) {
+
+                    return false;
+
+                }
+
+            }
+            return op != FacetFilter::NOT || count == 1;
+
+        }
+
+        // Function to make one traced call against a library; returns false if its arguments are malformed. The
+        // call's own exceptions are passed on.
+        static bool execute(Library& library, const TracedCall& call) {
+
+            // Declaring necessary variables
+            const char* p = call.arguments.data();
+            const char* end = p + call.arguments.size();
+            string title, author, value;
+            int64_t bookType = 0, choice = 0, patronID = 0, number = 0;
+
+            if (call.op == TraceRecorder::OP_ADD_BOOK) {
+
+                Book* b = readBook(p, end);
+                if (b == nullptr) {
+
+                    return false;
+
+                }
+                try {
+
+                    library.addBook(b);
+
+                } catch (...) {
+
+                    delete b;
+                    throw;
+
+                }
+                return true;
+
+            } else if (call.op == TraceRecorder::OP_BORROW_OR_RETURN_BATCH || call.op == TraceRecorder::OP_PREPARE_BATCH ||
+                       call.op == TraceRecorder::OP_COMMIT_BATCH) {
+
+                uint64_t itemCount;
+                if (!readVarint(p, end, itemCount)) {
+
+                    return false;
+
+                }
+                vector<BatchItem> items;
+                for (uint64_t i = 0; i < itemCount; i++) {
+
+                    BatchItem item;
+                    uint64_t itemType;
+                    if (!readVarint(p, end, itemType) || !readString(p, end, item.title) || !readString(p, end, item.author)) {
+
+                        return false;
+
+                    }
+                    item.bookType = (int) itemType;
+                    items.push_back(item);
+
+                }
+                if (!readSignedVarint(p, end, choice) || !readSignedVarint(p, end, patronID)) {
+
+                    return false;
+
+                }
+                if (call.op == TraceRecorder::OP_BORROW_OR_RETURN_BATCH) {
+
+                    library.borrowOrReturnBatch(items, (int) choice, (int) patronID);
+
+                } else if (call.op == TraceRecorder::OP_PREPARE_BATCH) {
+
+                    library.prepareBatch(items, (int) choice, (int) patronID);
+
+                } else {
+
+                    // The copies weren't recorded; picking them again gives the same ones, as nothing changed since
+                    library.commitBatch(items, (int) choice, (int) patronID, library.prepareBatch(items, (int) choice, (int) patronID));
+
+                }
+                return true;
+
+            } else if (call.op == TraceRecorder::OP_FILTER_BOOKS || call.op == TraceRecorder::OP_DISPLAY_FILTERED_BOOKS) {
+
+                FacetFilter filter;
+                if (!readFilter(p, end, filter, 0) || !readSignedVarint(p, end, number)) {
+
+                    return false;
+
+                }
+                if (call.op == TraceRecorder::OP_FILTER_BOOKS) {
+
+                    library.filterBooks(filter, (size_t) number);
+
+                } else {
+
+                    library.displayFilteredBooks(filter, (size_t) number);
+
+                }
+                return true;
+
+            }
+
+            // Every other call's arguments are a title and author, a patron ID, a facet, a prefix or path, or nothing,
+            // with integers after them (a removal's type tag comes first)
+            switch (call.op) {
+
+                case TraceRecorder::OP_REMOVE_BOOK:
+                    if (!readSignedVarint(p, end, bookType) || !readString(p, end, title) || !readString(p, end, author)) {
+
+                        return false;
+
+                    }
+                    break;
+                case TraceRecorder::OP_FIND_BOOKS:
+                case TraceRecorder::OP_BOOK_SEARCH:
+                case TraceRecorder::OP_BORROW_OR_RETURN:
+                case TraceRecorder::OP_PLACE_HOLD:
+                case TraceRecorder::OP_GET_HOLD_QUEUE_LENGTH:
+                case TraceRecorder::OP_GET_RECOMMENDATIONS:
+                case TraceRecorder::OP_DISPLAY_RECOMMENDATIONS:
+                case TraceRecorder::OP_GET_AVAILABLE_COPIES_AT:
+                case TraceRecorder::OP_GET_AVAILABILITY_WINDOW:
+                    if (!readString(p, end, title) || !readString(p, end, author)) {
+
+                        return false;
+
+                    }
+                    break;
+                case TraceRecorder::OP_GET_FACET_COUNTS:
+                    if (!readSignedVarint(p, end, choice) || !readString(p, end, value)) {
+
+                        return false;
+
+                    }
+                    break;
+                case TraceRecorder::OP_FIND_TITLES_WITH_PREFIX:
+                case TraceRecorder::OP_PAGE_OUT_DETAILS:
+                    if (!readString(p, end, value)) {
+
+                        return false;
+
+                    }
+                    break;
+
+            }
+
+            switch (call.op) {
+
+                case TraceRecorder::OP_REMOVE_BOOK:
+                    delete library.removeBook((int) bookType, title, author);
+                    return true;
+                case TraceRecorder::OP_FIND_BOOKS:
+                case TraceRecorder::OP_BOOK_SEARCH:
+                    if (!readSignedVarint(p, end, bookType) || !readSignedVarint(p, end, choice)) {
+
+                        return false;
+
+                    }
+                    if (call.op == TraceRecorder::OP_FIND_BOOKS) {
+
+                        library.findBooks(title, author, (int) bookType, (int) choice);
+
+                    } else {
+
+                        library.bookSearch(title, author, (int) bookType, (int) choice);
+
+                    }
+                    return true;
+                case TraceRecorder::OP_DISPLAY_BOOKS:
+                    library.displayBooks();
+                    return true;
+                case TraceRecorder::OP_BORROW_OR_RETURN:
+                    if (!readSignedVarint(p, end, bookType) || !readSignedVarint(p, end, choice) ||
+                        !readSignedVarint(p, end, patronID)) {
+
+                        return false;
+
+                    }
+                    library.borrowOrReturn(title, author, (int) bookType, (int) choice, (int) patronID);
+                    return true;
+                case TraceRecorder::OP_PLACE_HOLD:
+                    if (!readSignedVarint(p, end, bookType) || !readSignedVarint(p, end, patronID)) {
+
+                        return false;
+
+                    }
+                    library.placeHold(title, author, (int) bookType, (int) patronID);
+                    return true;
+                case TraceRecorder::OP_GET_HOLD_QUEUE_LENGTH:
+                    if (!readSignedVarint(p, end, bookType)) {
+
+                        return false;
+
+                    }
+                    library.getHoldQueueLength(title, author, (int) bookType);
+                    return true;
+                case TraceRecorder::OP_REGISTER_PATRON:
+                    if (!readSignedVarint(p, end, patronID) || !readSignedVarint(p, end, number)) {
+
+                        return false;
+
+                    }
+                    library.registerPatron((int) patronID, (int) number);
+                    return true;
+                case TraceRecorder::OP_GET_PATRON_LOANS:
+                case TraceRecorder::OP_DISPLAY_PATRON_LOANS:
+                    if (!readSignedVarint(p, end, patronID)) {
+
+                        return false;
+
+                    }
+                    if (call.op == TraceRecorder::OP_GET_PATRON_LOANS) {
+
+                        library.getPatronLoans((int) patronID);
+
+                    } else {
+
+                        library.displayPatronLoans((int) patronID);
+
+                    }
+                    return true;
+                case TraceRecorder::OP_GET_FACET_COUNTS:
+                    library.getFacetCounts((int) choice, value);
+                    return true;
+                case TraceRecorder::OP_FIND_TITLES_WITH_PREFIX:
+                    library.findTitlesWithPrefix(value);
+                    return true;
+                case TraceRecorder::OP_GET_RECOMMENDATIONS:
+                case TraceRecorder::OP_DISPLAY_RECOMMENDATIONS:
+                    if (!readSignedVarint(p, end, bookType) || !readSignedVarint(p, end, number)) {
+
+                        return false;
+
+                    }
+                    if (call.op == TraceRecorder::OP_GET_RECOMMENDATIONS) {
+
+                        library.getRecommendations(title, author, (int) bookType, (size_t) number);
+
+                    } else {
+
+                        library.displayRecommendations(title, author, (int) bookType, (size_t) number);
+
+                    }
+                    return true;
+                case TraceRecorder::OP_DISPLAY_CATALOG_STATS:
+                    library.displayCatalogStats();
+                    return true;
+                case TraceRecorder::OP_GET_AVAILABLE_COPIES_AT:
+                case TraceRecorder::OP_GET_AVAILABILITY_WINDOW:
+                    if (!readSignedVarint(p, end, bookType) || !readSignedVarint(p, end, number)) {
+
+                        return false;
+
+                    }
+                    if (call.op == TraceRecorder::OP_GET_AVAILABLE_COPIES_AT) {
+
+                        library.getAvailableCopiesAt(title, author, (int) bookType, number);
+
+                    } else {
+
+                        if (!readSignedVarint(p, end, choice)) {
+
+                            return false;
+
+                        }
+                        library.getAvailabilityWindow(title, author, (int) bookType, number, choice);
+
+                    }
+                    return true;
+                case TraceRecorder::OP_PAGE_OUT_DETAILS:
+                    library.pageOutDetails(value);
+                    return true;
+                case TraceRecorder::OP_SET_SESSION_WINDOW:
+                case TraceRecorder::OP_CONFIGURE_BLOOM_FILTERS:
+                case TraceRecorder::OP_SET_SEARCH_CACHE_SIZE:
+                case TraceRecorder::OP_SET_SHOW_MESSAGES:
+                case TraceRecorder::OP_SET_HISTORY_TIME:
+                case TraceRecorder::OP_ENABLE_SNAPSHOTS:
+                case TraceRecorder::OP_GET_TYPE_COUNTS:
+                    if (!readSignedVarint(p, end, number)) {
+
+                        return false;
+
+                    }
+                    if (call.op == TraceRecorder::OP_SET_SESSION_WINDOW) {
+
+                        library.setSessionWindow(number);
+
+                    } else if (call.op == TraceRecorder::OP_CONFIGURE_BLOOM_FILTERS) {
+
+                        library.configureBloomFilters(TraceRecorder::bitsDouble(number));
+
+                    } else if (call.op == TraceRecorder::OP_SET_SEARCH_CACHE_SIZE) {
+
+                        library.setSearchCacheSize((size_t) number);
+
+                    } else if (call.op == TraceRecorder::OP_SET_SHOW_MESSAGES) {
+
+                        library.setShowMessages(number != 0);
+
+                    } else if (call.op == TraceRecorder::OP_SET_HISTORY_TIME) {
+
+                        library.setHistoryTime(number);
+
+                    } else if (call.op == TraceRecorder::OP_ENABLE_SNAPSHOTS) {
+
+                        library.enableSnapshots(number != 0);
+
+                    } else {
+
+                        library.getTypeCounts((int) number);
+
+                    }
+                    return true;
+                case TraceRecorder::OP_GET_DICTIONARY_REPORT:
+                    library.getDictionaryReport();
+                    return true;
+                case TraceRecorder::OP_GET_BLOOM_FILTER_STATS:
+                    library.getBloomFilterStats();
+                    return true;
+                case TraceRecorder::OP_GET_SEARCH_CACHE_METRICS:
+                    library.getSearchCacheMetrics();
+                    return true;
+                case TraceRecorder::OP_GET_MEMORY_REPORT:
+                    library.getMemoryReport();
+                    return true;
+                case TraceRecorder::OP_DISPLAY_MEMORY_REPORT:
+                    library.displayMemoryReport();
+                    return true;
+
+            }
+            return false;
+
+        }
+
+    // Public member functions
+    public:
+
+        // Constructor with the trace file path
+        TraceReplayer(string tracePath) {
+
+            path = tracePath;
+            version = 0;
+            startMicros = 0;
+
+        }
+
+        // Function to return the format version of the trace load read (0 if it wasn't a trace, 1 if it was recorded
+        // before traces had a version)
+        uint64_t getVersion() {
+
+            return version;
+
+        }
+
+        // Function to return the name of an operation code
+        static const char* getOpName(uint8_t op) {
+
+            static const char* names[TraceRecorder::OP_COUNT] = {"unknown", "addBook", "removeBook", "findBooks", "bookSearch", "displayBooks", "borrowOrReturn",
+                "borrowOrReturnBatch", "placeHold", "registerPatron", "getPatronLoans", "displayPatronLoans",
+                "getFacetCounts", "findTitlesWithPrefix", "getRecommendations", "displayRecommendations",
+                "displayCatalogStats", "getHoldQueueLength", "filterBooks", "displayFilteredBooks", "prepareBatch",
+                "commitBatch", "setSessionWindow", "configureBloomFilters", "setSearchCacheSize", "setShowMessages",
+                "setHistoryTime", "pageOutDetails", "enableSnapshots", "getAvailableCopiesAt", "getAvailabilityWindow",
+                "getTypeCounts", "getDictionaryReport", "getBloomFilterStats", "getSearchCacheMetrics", "getMemoryReport",
+                "displayMemoryReport"};
+            return op < TraceRecorder::OP_COUNT ? names[op] : names[0];
+
+        }
+
+        // Function to read the trace file; returns false if it can't be opened, isn't a trace, or is a trace of another
+        // format version, whose records would be misread (a record cut short at the end, by a crash while recording,
+        // ends the trace there)
+        bool load() {
+
+            // Reading the whole file
+            ifstream file(path.c_str(), ios::binary);
+            if (!file.is_open()) {
+
+                return false;
+
+            }
+            string contents((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+            const char* p = contents.data();
+            const char* end = p + contents.size();
+            uint64_t start;
+            size_t magicLength = strlen(TraceRecorder::MAGIC);
+            version = 0;
+            if (contents.compare(0, magicLength - 1, TraceRecorder::MAGIC, magicLength - 1) != 0) {
+
+                return false;
+
+            }
+
+            // A trace from before the version was recorded is version 1
+            version = 1;
+            if (contents.compare(0, magicLength, TraceRecorder::MAGIC) != 0 || !readVarint(p += magicLength, end, version) ||
+                version != TraceRecorder::FORMAT_VERSION || !readVarint(p, end, start)) {
+
+                return false;
+
+            }
+            startMicros = (int64_t) start;
+
+            // Loop to decode each record
+            calls.clear();
+            int64_t offset = 0;
+            while (p < end) {
+
+                TracedCall call;
+                int64_t delta;
+                uint64_t duration;
+                call.op = (uint8_t) *p++;
+                if (!readSignedVarint(p, end, delta) || !readVarint(p, end, duration) || p == end) {
+
+                    break;
+
+                }
+                call.threw = *p++ != 0;
+                if (!readString(p, end, call.arguments)) {
+
+                    break;
+
+                }
+                offset += delta;
+                call.offsetNanos = offset;
+                call.durationNanos = (int64_t) duration;
+                calls.push_back(call);
+
+            }
+            return true;
+
+        }
+
+        // Function to return the number of calls loaded
+        size_t getCallCount() {
+
+            return calls.size();
+
+        }
+
+        // Function to replay every call against a fresh library; returns the statistics of each kind of call, indexed
+        // by operation code. At the original speed each call starts as long after the first as it did when recorded.
+        vector<TraceOpStats> replay(bool originalSpeed) {
+
+            // Stream buffer that throws away what the calls display
+            struct NullBuffer : public streambuf {
+                int overflow(int c) {
+                    return c;
+                }
+            };
+
+            // Declaring necessary variables
+            vector<TraceOpStats> stats(TraceRecorder::OP_COUNT);
+            for (size_t op = 0; op < stats.size(); op++) {
+
+                stats[op].calls = 0;
+                stats[op].errors = 0;
+                stats[op].mismatches = 0;
+
+            }
+            NullBuffer nullBuffer;
+            streambuf* console = cout.rdbuf();
+            vector<Book*> books;
+            int64_t fixedHistoryTime = 0;
+
+            {
+                Library library;
+                chrono::steady_clock::time_point replayStart = chrono::steady_clock::now();
+                cout.rdbuf(&nullBuffer);
+
+                // Loop to make each call at the time it was recorded
+                for (size_t i = 0; i < calls.size(); i++) {
+
+                    const TracedCall& call = calls[i];
+                    TraceOpStats& opStats = stats[call.op < TraceRecorder::OP_COUNT ? call.op : 0];
+                    if (originalSpeed) {
+
+                        this_thread::sleep_until(replayStart + chrono::nanoseconds(call.offsetNanos));
+
+                    }
+                    // Changes are recorded at the time of the call, unless the traced program fixed the time itself
+                    library.setHistoryTime(fixedHistoryTime != 0 ? fixedHistoryTime : (startMicros + call.offsetNanos / 1000) / 1000000);
+                    if (call.op == TraceRecorder::OP_SET_HISTORY_TIME) {
+
+                        const char* p = call.arguments.data();
+                        if (!readSignedVarint(p, p + call.arguments.size(), fixedHistoryTime)) {
+
+                            fixedHistoryTime = 0;
+
+                        }
+
+                    }
+
+                    bool threw = false;
+                    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                    try {
+
+                        if (!execute(library, call)) {
+
+                            threw = true;
+
+                        }
+
+                    } catch (...) {
+
+                        threw = true;
+
+                    }
+                    int64_t replayed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+
+                    opStats.calls++;
+                    opStats.errors += threw ? 1 : 0;
+                    opStats.mismatches += threw != call.threw ? 1 : 0;
+                    opStats.recordedNanos.push_back(call.durationNanos);
+                    opStats.replayedNanos.push_back(replayed);
+
+                }
+                cout.rdbuf(console);
+
+                // Collecting the books the library still holds, which it doesn't delete
+                for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                    for (size_t i = 0; i < library.getSectionSize(bookType); i++) {
+
+                        books.push_back(library.getSectionBook(bookType, i));
+
+                    }
+
+                }
+            }
+            for (size_t i = 0; i < books.size(); i++) {
+
+                delete books[i];
+
+            }
+
+            return stats;
+
+        }
+
+        // Function to display the statistics a replay returned
+        static void displayReport(vector<TraceOpStats>& stats) {
+
+            cout << "\nCall latency (microseconds) when recorded and when replayed:\n" << endl;
+            for (size_t op = 0; op < stats.size(); op++) {
+
+                if (stats[op].calls == 0) {
+
+                    continue;
+
+                }
+                vector<int64_t>& recorded = stats[op].recordedNanos;
+                vector<int64_t>& replayed = stats[op].replayedNanos;
+                sort(recorded.begin(), recorded.end());
+                sort(replayed.begin(), replayed.end());
+                cout << "\t" << getOpName((uint8_t) op) << ": " << stats[op].calls << " calls, " << stats[op].errors
+                     << " errors, " << stats[op].mismatches << " outcome mismatches\n"
+                     << "\t\trecorded p50 " << recorded[recorded.size() / 2] / 1000.0 << ", p99 "
+                     << recorded[recorded.size() * 99 / 100] / 1000.0 << ", max " << recorded.back() / 1000.0 << "\n"
+                     << "\t\treplayed p50 " << replayed[replayed.size() / 2] / 1000.0 << ", p99 "
+                     << replayed[replayed.size() * 99 / 100] / 1000.0 << ", max " << replayed.back() / 1000.0 << endl;
+
+            }
+
+        }
+
+};
+
+
+// ThreadPool class
+//  Fixed set of worker threads that run submitted tasks in the order they were submitted
+class ThreadPool {
+
+    // Private members
+    private:
+        vector<thread> workers;
+        queue< function<void()> > tasks;
+        mutex tasksLock;
+        condition_variable tasksReady;
+        bool stopping;
+
+        // Function run by each worker thread
+        void workerLoop() {
+
+            while (true) {
+
+                function<void()> task;
+                {
+                    unique_lock<mutex> lock(tasksLock);
+                    tasksReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+                    if (stopping && tasks.empty()) {
+
+                        return;
+
+                    }
+                    task = move(tasks.front());
+                    tasks.pop();
+                }
+                task();
+
+            }
+
+        }
+
+    // Public member functions
+    public:
+
+        // Constructor with the number of worker threads
+        ThreadPool(size_t threadCount) {
+
+            stopping = false;
+            if (threadCount == 0) {
+
+                threadCount = 1;
+
+            }
+            for (size_t i = 0; i < threadCount; i++) {
+
+                workers.push_back(thread(&ThreadPool::workerLoop, this));
+
+            }
+
+        }
+
+        // Destructor; finishes the queued tasks and joins the workers
+        ~ThreadPool() {
+
+            {
+                lock_guard<mutex> lock(tasksLock);
+                stopping = true;
+            }
+            tasksReady.notify_all();
+            for (size_t i = 0; i < workers.size(); i++) {
+
+                workers[i].join();
+
+            }
+
+        }
+
+        // Function to submit a task; the returned future becomes ready when the task has run
+        future<void> submit(function<void()> work) {
+
+            shared_ptr< packaged_task<void()> > task = make_shared< packaged_task<void()> >(work);
+            future<void> done = task->get_future();
+            {
+                lock_guard<mutex> lock(tasksLock);
+                tasks.push([task] { (*task)(); });
+            }
+            tasksReady.notify_one();
+            return done;
+
+        }
+
+        // Function to return the number of worker threads
+        size_t size() {
+
+            return workers.size();
+
+        }
+
+};
+
+
+// BatchQueryExecutor class
+//  Runs a batch of read-only queries against a Library on a thread pool and returns the results in input order.
+//  Each worker starts with an equal share of the queries and takes them from the front of its share a few at a time;
+//  a worker that runs out steals the back half of the largest share left, so slow queries don't leave threads idle.
+class BatchQueryExecutor {
+
+    // Private members
+    private:
+
+        // Range of query indexes [next, end) still to be run by one worker
+        struct WorkRange {
+            mutex lock;
+            size_t next;
+            size_t end;
+        };
+
+        // Number of queries a worker takes from its range at a time
+        static const size_t CHUNK_SIZE = 16;
+
+        ThreadPool pool;
+        uint64_t steals;
+        mutex stealsLock;
+
+        // Function to take the next chunk of a worker's own range; returns false if the range is empty
+        bool takeChunk(WorkRange& range, size_t& first, size_t& last) {
+
+            lock_guard<mutex> lock(range.lock);
+            if (range.next >= range.end) {
+
+                return false;
+
+            }
+            first = range.next;
+            last = min(range.end, first + CHUNK_SIZE);
+            range.next = last;
+            return true;
+
+        }
+
+        // Function to move the back half of the largest other range into a worker's own range; returns false if
+        // every range is empty
+        bool steal(vector<WorkRange>& ranges, size_t self) {
+
+            // Picking the victim with the most queries left (it may have changed by the time it is locked below)
+            size_t victim = self;
+            size_t most = 0;
+            for (size_t i = 0; i < ranges.size(); i++) {
+
+                if (i == self) {
+
+                    continue;
+
+                }
+                size_t left;
+                {
+                    lock_guard<mutex> lock(ranges[i].lock);
+                    left = (ranges[i].end > ranges[i].next) ? ranges[i].end - ranges[i].next : 0;
+                }
+                if (left > most) {
+
+                    victim = i;
+                    most = left;
+
+                }
+
+            }
+            if (victim == self) {
+
+                return false;
+
+            }
+
+            // Locking the two ranges in index order so two thieves can't deadlock
+            WorkRange& from = ranges[victim];
+            WorkRange& to = ranges[self];
+            unique_lock<mutex> first(victim < self ? from.lock : to.lock);
+            unique_lock<mutex> second(victim < self ? to.lock : from.lock);
+            if (from.next >= from.end) {
+
+                // Someone else emptied it first; the caller tries again
+                return true;
+
+            }
+            size_t middle = from.next + (from.end - from.next) / 2;
+            to.next = middle;
+            to.end = from.end;
+            from.end = middle;
+            {
+                lock_guard<mutex> lock(stealsLock);
+                steals++;
+            }
+            return true;
+
+        }
+
+        // Function run by each worker: its own range first, then whatever it can steal
+        void runWorker(Library* library, const vector<BatchQuery>* queries, vector< vector<Book*> >* results,
+                       vector<WorkRange>* ranges, size_t self) {
+
+            size_t first, last;
+            while (true) {
+
+                while (takeChunk((*ranges)[self], first, last)) {
+
+                    for (size_t i = first; i < last; i++) {
+
+                        (*results)[i] = library->lookup((*queries)[i]);
+
+                    }
+
+                }
+                if (!steal(*ranges, self)) {
+
+                    return;
+
+                }
+
+            }
+
+        }
+
+    // Public member functions
+    public:
+
+        // Constructor with the number of worker threads (0 for one per hardware thread)
+        BatchQueryExecutor(size_t threadCount)
+            : pool(threadCount != 0 ? threadCount : max(1u, thread::hardware_concurrency())) {
+
+            steals = 0;
+
+        }
+
+        // Function to run every query and return each one's matching copies, in the same order as the queries
+        //  The library must not change while the batch runs
+        vector< vector<Book*> > execute(Library& library, const vector<BatchQuery>& queries) {
+
+            // Declaring necessary variables
+            vector< vector<Book*> > results(queries.size());
+            vector<WorkRange> ranges(pool.size());
+            vector< future<void> > pending;
+
+            // Splitting the queries into one equal range per worker
+            for (size_t i = 0; i < ranges.size(); i++) {
+
+                ranges[i].next = queries.size() * i / ranges.size();
+                ranges[i].end = queries.size() * (i + 1) / ranges.size();
+
+            }
+
+            for (size_t i = 0; i < ranges.size(); i++) {
+
+                pending.push_back(pool.submit([this, &library, &queries, &results, &ranges, i] {
+
+                    runWorker(&library, &queries, &results, &ranges, i);
+
+                }));
+
+            }
+            for (size_t i = 0; i < pending.size(); i++) {
+
+                pending[i].get();
+
+            }
+            return results;
+
+        }
+
+        // Function to return how many times a worker has stolen queries from another
+        uint64_t getStealCount() {
+
+            lock_guard<mutex> lock(stealsLock);
+            return steals;
+
+        }
+
+        // Function to return the number of worker threads
+        size_t size() {
+
+            return pool.size();
+
+        }
+
+};
+
+
+// CatalogExporter class
+//  Writes every book of a Library, with the fields of its type and its availability, as CSV (format 1), a JSON array
+//  (format 2), or newline-delimited JSON (format 3). Books are formatted into large buffers that are reused from one
+//  write to the next; with more than one thread, chunks of books are formatted in parallel while earlier chunks are
+//  written out in order. Each type's name and detail field names come from BOOK_TYPES; in CSV every type has its own
+//  pair of detail columns, left empty for books of the other types.
+class CatalogExporter {
+
+    // Private members
+    private:
+
+        // Number of books formatted at a time (by one thread, when formatting in parallel), and the size a buffer is
+        // written out at
+        static const size_t CHUNK_BOOKS = 8192;
+        static const size_t BUFFER_SIZE = 1 << 20;
+
+        // Output buffer; bytes only grows, so a buffer reused for the next chunk doesn't allocate again
+        struct Buffer {
+            vector<char> bytes;
+            size_t length;
+        };
+
+        int format;
+        unique_ptr<ThreadPool> pool;
+        vector<Buffer> buffers;
+
+        // Text written around each type's fields, built once from BOOK_TYPES: the start of a book up to its title,
+        // what comes before its first and second detail field, and what comes after the second
+        string typeStart[BOOK_TYPE_COUNT], beforeField1[BOOK_TYPE_COUNT], beforeField2[BOOK_TYPE_COUNT];
+        string afterField2[BOOK_TYPE_COUNT];
+
+        // Function to make room for n more bytes at the end of a buffer and return where they start
+        static char* reserve(Buffer& buffer, size_t n) {
+
+            if (buffer.length + n > buffer.bytes.size()) {
+
+                buffer.bytes.resize(max(buffer.bytes.size() * 2, buffer.length + n));
+
+            }
+            return buffer.bytes.data() + buffer.length;
+
+        }
+
+        // Function to copy a string literal (without its terminating null)
+        template <size_t N>
+        static char* appendLiteral(char* p, const char (&text)[N]) {
+
+            memcpy(p, text, N - 1);
+            return p + N - 1;
+
+        }
+
+        // Function to copy text built at run time
+        static char* appendBytes(char* p, const string& text) {
+
+            memcpy(p, text.data(), text.size());
+            return p + text.size();
+
+        }
+
+        // Function to write an unsigned integer, two digits at a time
+        static char* appendUnsigned(char* p, uint64_t value) {
+
+            static const char pairs[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+            char digits[20];
+            size_t n = sizeof(digits);
+            while (value >= 100) {
+
+                size_t pair = (size_t) (value % 100) * 2;
+                value /= 100;
+                digits[--n] = pairs[pair + 1];
+                digits[--n] = pairs[pair];
+
+            }
+            if (value >= 10) {
+
+                digits[--n] = pairs[value * 2 + 1];
+                digits[--n] = pairs[value * 2];
+
+            } else {
+
+                digits[--n] = char('0' + value);
+
+            }
+            memcpy(p, digits + n, sizeof(digits) - n);
+            return p + sizeof(digits) - n;
+
+        }
+
+        // Function to find the first character that has to be escaped (JSON: control characters, quotes, and
+        // backslashes) or that makes a field need quoting (CSV: commas, quotes, and line breaks); returns end if none
+        //  Checks 16 bytes at a time with SSE2, as most titles and authors have nothing to escape
+        static const char* findSpecial(const char* p, const char* end, bool json) {
+
+#if defined(__SSE2__)
+            const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), comma = _mm_set1_epi8(',');
+            const __m128i newline = _mm_set1_epi8('\n'), carriageReturn = _mm_set1_epi8('\r');
+            const __m128i space = _mm_set1_epi8(0x20), negative = _mm_set1_epi8(-1);
+            while (end - p >= 16) {
+
+                __m128i v = _mm_loadu_si128((const __m128i*) p);
+                __m128i special = _mm_cmpeq_epi8(v, quote);
+                if (json) {
+
+                    // Control characters are below 0x20 and not negative (bytes of UTF-8 sequences are negative)
+                    special = _mm_or_si128(special, _mm_cmpeq_epi8(v, backslash));
+                    special = _mm_or_si128(special, _mm_and_si128(_mm_cmplt_epi8(v, space), _mm_cmpgt_epi8(v, negative)));
+
+                } else {
+
+                    special = _mm_or_si128(special, _mm_cmpeq_epi8(v, comma));
+                    special = _mm_or_si128(special, _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, carriageReturn)));
+
+                }
+                int mask = _mm_movemask_epi8(special);
+                if (mask != 0) {
+
+                    return p + __builtin_ctz(mask);
+
+                }
+                p += 16;
+
+            }
+#endif
+            for (; p < end; p++) {
+
+                unsigned char c = (unsigned char) *p;
+                if (c == '"' || (json ? (c == '\\' || c < 0x20) : (c == ',' || c == '\n' || c == '\r'))) {
+
+                    return p;
+
+                }
+
+            }
+            return end;
+
+        }
+
+        // Function to write a JSON string with its quotes, escaping what JSON requires (at most 6 bytes per character)
+        static char* appendJsonString(char* out, const string& value) {
+
+            static const char hex[] = "0123456789abcdef";
+            const char* p = value.data();
+            const char* end = p + value.size();
+            *out++ = '"';
+            while (p < end) {
+
+                const char* special = findSpecial(p, end, true);
+                memcpy(out, p, special - p);
+                out += special - p;
+                if (special == end) {
+
+                    break;
+
+                }
+                char c = *special;
+                *out++ = '\\';
+                if (c == '"' || c == '\\') {
+
+                    *out++ = c;
+
+                } else if (c == '\n') {
+
+                    *out++ = 'n';
+
+                } else if (c == '\r') {
+
+                    *out++ = 'r';
+
+                } else if (c == '\t') {
+
+                    *out++ = 't';
+
+                } else {
+
+                    out = appendLiteral(out, "u00");
+                    *out++ = hex[(c >> 4) & 15];
+                    *out++ = hex[c & 15];
+
+                }
+                p = special + 1;
+
+            }
+            *out++ = '"';
+            return out;
+
+        }
+
+        // Function to write a CSV field, quoting it (and doubling its quotes) only if it has to be (at most 2 bytes per
+        // character, plus the quotes)
+        static char* appendCsvField(char* out, const string& value) {
+
+            const char* p = value.data();
+            const char* end = p + value.size();
+            if (findSpecial(p, end, false) == end) {
+
+                memcpy(out, p, value.size());
+                return out + value.size();
+
+            }
+            *out++ = '"';
+            for (; p < end; p++) {
+
+                if (*p == '"') {
+
+                    *out++ = '"';
+
+                }
+                *out++ = *p;
+
+            }
+            *out++ = '"';
+            return out;
+
+        }
+
+        // Function to append one book as a CSV row or a JSON object; index is its position in the whole export
+        //  d holds the book's details while it is formatted, so its strings are reused from one book to the next
+        void formatBook(Book* b, int bookType, size_t index, BookDetails& d, Buffer& buffer) {
+
+            // Making room for the longest the book can come out as, with every character escaped
+            b->readDetails(d);
+            const string& title = b->getTitle();
+            const string& author = b->getAuthor();
+            size_t text = title.size() + author.size() + d.genre.size() + d.field1.size() + d.field2.size();
+            size_t around = typeStart[bookType].size() + beforeField1[bookType].size() + beforeField2[bookType].size() +
+                            afterField2[bookType].size();
+            char* start = reserve(buffer, 6 * text + around + 128);
+            char* p = start;
+
+            if (format == 1) {
+
+                p = appendBytes(p, typeStart[bookType]);
+                p = appendCsvField(p, title);
+                *p++ = ',';
+                p = appendCsvField(p, author);
+                *p++ = ',';
+                p = appendUnsigned(p, b->getISBN());
+                *p++ = ',';
+                p = appendCsvField(p, d.genre);
+                p = appendBytes(p, beforeField1[bookType]);
+                p = appendCsvField(p, d.field1);
+                p = appendBytes(p, beforeField2[bookType]);
+                p = appendCsvField(p, d.field2);
+                p = appendBytes(p, afterField2[bookType]);
+                p = b->getAvailability() ? appendLiteral(p, "true\n") : appendLiteral(p, "false\n");
+
+            } else {
+
+                if (format == 2) {
+
+                    p = (index == 0) ? appendLiteral(p, "\n") : appendLiteral(p, ",\n");
+
+                }
+                p = appendBytes(p, typeStart[bookType]);
+                p = appendJsonString(p, title);
+                p = appendLiteral(p, ",\"author\":");
+                p = appendJsonString(p, author);
+                p = appendLiteral(p, ",\"isbn\":");
+                p = appendUnsigned(p, b->getISBN());
+                p = appendLiteral(p, ",\"genre\":");
+                p = appendJsonString(p, d.genre);
+                p = appendBytes(p, beforeField1[bookType]);
+                p = appendJsonString(p, d.field1);
+                p = appendBytes(p, beforeField2[bookType]);
+                p = appendJsonString(p, d.field2);
+                p = b->getAvailability() ? appendLiteral(p, ",\"available\":true}") : appendLiteral(p, ",\"available\":false}");
+                if (format == 3) {
+
+                    *p++ = '\n';
+
+                }
+
+            }
+            buffer.length += p - start;
+
+        }
+
+        // Function to format the books at positions [first, last) of the export (each section in turn, by type tag)
+        void formatRange(Library& library, size_t first, size_t last, Buffer& buffer) {
+
+            // Finding the section the first book is in, and its position there
+            int bookType = 1;
+            size_t position = first;
+            while (bookType < BOOK_TYPE_COUNT - 1 && position >= library.getSectionSize(bookType)) {
+
+                position -= library.getSectionSize(bookType);
+                bookType++;
+
+            }
+
+            BookDetails d;
+            for (size_t i = first; i < last; i++, position++) {
+
+                while (position >= library.getSectionSize(bookType)) {
+
+                    position = 0;
+                    bookType++;
+
+                }
+                formatBook(library.getSectionBook(bookType, position), bookType, i, d, buffer);
+
+            }
+
+        }
+
+        // Function to append text that isn't a book (the CSV header and the JSON brackets)
+        static void appendText(Buffer& buffer, const string& text) {
+
+            memcpy(reserve(buffer, text.size()), text.data(), text.size());
+            buffer.length += text.size();
+
+        }
+
+        // Function to write a buffer out and empty it, keeping its memory for the next chunk
+        static void writeBuffer(ofstream& out, Buffer& buffer, uint64_t& written) {
+
+            out.write(buffer.bytes.data(), buffer.length);
+            written += buffer.length;
+            buffer.length = 0;
+
+        }
+
+    // Public member functions
+    public:
+
+        // Exception classes:
+        //  Exception class to handle an export file that can't be opened or written
+        class exportFileError {};
+
+        // Constructor with the format (1 for CSV, 2 for JSON, 3 for NDJSON) and the number of formatting threads
+        // (1 formats on the calling thread)
+        CatalogExporter(int f, size_t threadCount) {
+
+            format = (f >= 1 && f <= 3) ? f : 1;
+            if (threadCount > 1) {
+
+                pool.reset(new ThreadPool(threadCount));
+
+            }
+            buffers.resize(threadCount > 1 ? 2 * threadCount : 1);
+            for (size_t i = 0; i < buffers.size(); i++) {
+
+                buffers[i].bytes.resize(2 * BUFFER_SIZE);
+                buffers[i].length = 0;
+
+            }
+
+            // Building the text around each type's fields
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                const BookTypeInfo& info = BOOK_TYPES[bookType];
+                if (format == 1) {
+
+                    // The detail columns of the types before this one, and after it, are left empty
+                    typeStart[bookType] = string(info.exportName) + ",";
+                    beforeField1[bookType] = string(2 * (bookType - 1) + 1, ',');
+                    beforeField2[bookType] = ",";
+                    afterField2[bookType] = string(2 * (BOOK_TYPE_COUNT - 1 - bookType) + 1, ',');
+
+                } else {
+
+                    typeStart[bookType] = string("{\"type\":\"") + info.exportName + "\",\"title\":";
+                    beforeField1[bookType] = string(",\"") + info.field1Column + "\":";
+                    beforeField2[bookType] = string(",\"") + info.field2Column + "\":";
+
+                }
+
+            }
+
+        }
+
+        // Function to export every book of a library to a file; returns the number of bytes written
+        //  The library must not change while it is exported
+        uint64_t exportCatalog(Library& library, string path) {
+
+            // Declaring necessary variables
+            ofstream out(path.c_str(), ios::binary | ios::trunc);
+            size_t books = 0;
+            uint64_t written = 0;
+            if (!out.is_open()) {
+
+                throw exportFileError();
+
+            }
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                books += library.getSectionSize(bookType);
+
+            }
+
+            Buffer& first = buffers[0];
+            if (format == 1) {
+
+                string header = "type,title,author,isbn,genre,";
+                for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                    header += string(BOOK_TYPES[bookType].field1Column) + "," + BOOK_TYPES[bookType].field2Column + ",";
+
+                }
+                appendText(first, header + "available\n");
+
+            } else if (format == 2) {
+
+                appendText(first, "[");
+
+            }
+
+            // One thread: formatting into one buffer, written whenever it fills up
+            if (!pool) {
+
+                for (size_t i = 0; i < books; i += CHUNK_BOOKS) {
+
+                    formatRange(library, i, min(books, i + CHUNK_BOOKS), first);
+                    if (first.length >= BUFFER_SIZE) {
+
+                        writeBuffer(out, first, written);
+
+                    }
+
+                }
+
+            // Several threads: every buffer in the ring is a chunk being formatted or waiting to be written, and a
+            // buffer is handed the next chunk as soon as its own has been written
+            } else {
+
+                size_t chunks = (books + CHUNK_BOOKS - 1) / CHUNK_BOOKS;
+                size_t ring = buffers.size();
+                vector< future<void> > pending(ring);
+                size_t submitted = 0;
+                writeBuffer(out, first, written);
+                for (size_t c = 0; c < chunks; c++) {
+
+                    while (submitted < chunks && submitted < c + ring) {
+
+                        size_t from = submitted * CHUNK_BOOKS, to = min(books, from + CHUNK_BOOKS);
+                        Buffer* buffer = &buffers[submitted % ring];
+                        pending[submitted % ring] = pool->submit([this, &library, from, to, buffer]() {
+
+                            formatRange(library, from, to, *buffer);
+
+                        });
+                        submitted++;
+
+                    }
+                    pending[c % ring].get();
+                    writeBuffer(out, buffers[c % ring], written);
+
+                }
+
+            }
+
+            if (format == 2) {
+
+                appendText(first, (books == 0) ? "]\n" : "\n]\n");
+
+            }
+            writeBuffer(out, first, written);
+            out.close();
+            if (out.fail()) {
+
+                throw exportFileError();
+
+            }
+            return written;
+
+        }
+
+};
+
+
+// LibraryNetwork class
+//  Federates several Library shards, partitioned either by branch (the caller says which branch a book belongs to)
+//  or by ISBN hash. Searches fan out to every shard in parallel on a thread pool and the results are merged in shard
+//  order; borrows, returns, and removals go straight to the shards that hold copies of the book.
+//  Note: each shard checks duplicate ISBNs on its own, which covers the whole network when partitioning by ISBN hash.
+class LibraryNetwork {
+
+    // Private members
+    private:
+        vector<Library*> shards;
+        vector<mutex*> shardLocks;
+        int partitionChoice;
+        ThreadPool pool;
+
+        // Directory from book type, title, and author to the shard of every copy
+        unordered_map<string, vector<int> > directory;
+        mutex directoryLock;
+
+        // Loan limit of each registered patron and their books on loan across every shard, so the limit holds for the
+        // whole network rather than once per branch
+        struct PatronLoans {
+            int maxLoans;
+            int loans;
+        };
+        unordered_map<int, PatronLoans> patronLoans;
+        mutex patronLock;
+
+        // Function to reserve loans for a patron before borrowing, throwing an error if they would go over their limit;
+        // patron ID 0 (no library card) and patrons the network doesn't know are left to the shards to check
+        void reserveLoans(int patronID, int count) {
+
+            lock_guard<mutex> lock(patronLock);
+            unordered_map<int, PatronLoans>::iterator patron = patronLoans.find(patronID);
+            if (patron == patronLoans.end()) {
+
+                return;
+
+            }
+            if (patron->second.loans + count > patron->second.maxLoans) {
+
+                throw Library::loanLimitReachedError();
+
+            }
+            patron->second.loans += count;
+
+        }
+
+        // Function to give back a patron's loans, for books returned or a reservation that wasn't used
+        void releaseLoans(int patronID, int count) {
+
+            lock_guard<mutex> lock(patronLock);
+            unordered_map<int, PatronLoans>::iterator patron = patronLoans.find(patronID);
+            if (patron != patronLoans.end()) {
+
+                patron->second.loans = max(0, patron->second.loans - count);
+
+            }
+
+        }
+
+        // Function to borrow or return a book on the first of its shards that can, throwing the last shard's error if
+        // none of them can
+        void tryShards(const vector<int>& owners, const string& title, const string& author, int bookType,
+                       int borrowOrReturnChoice, int patronID) {
+
+            for (size_t i = 0; i < owners.size(); i++) {
+
+                lock_guard<mutex> lock(*shardLocks[owners[i]]);
+                try {
+
+                    shards[owners[i]]->borrowOrReturn(title, author, bookType, borrowOrReturnChoice, patronID);
+                    return;
+
+                }
+                // Trying the next shard if this one has no copy to borrow or return
+                catch (Library::bookNotBorrowableError) {
+
+                    if (i + 1 == owners.size()) {
+
+                        throw;
+
+                    }
+
+                }
+                catch (Library::bookNotReturnableError) {
+
+                    if (i + 1 == owners.size()) {
+
+                        throw;
+
+                    }
+
+                }
+
+            }
+
+        }
+
+        // Function to build a directory key (book type, normalized title, and normalized author)
+        static string directoryKey(int bookType, const string& title, const string& author) {
+
+            return char('0' + bookType) + normalizeKey(title) + '\x1f' + normalizeKey(author);
+
+        }
+
+        // Function to pick the shard for a new book
+        int pickShard(Book* b, int branch) {
+
+            // By branch:
+            if (partitionChoice == 1) {
+
+                if (branch < 0 || branch >= (int) shards.size()) {
+
+                    throw invalidBranchError();
+
+                }
+                return branch;
+
+            }
+
+            // By ISBN hash:
+            return (int) (hash<uint64_t>()(b->getISBN()) % shards.size());
+
+        }
+
+        // Function to record that a shard holds a copy of a book
+        void addToDirectory(int bookType, Book* b, int shard) {
+
+            lock_guard<mutex> lock(directoryLock);
+            directory[directoryKey(bookType, b->getTitle(), b->getAuthor())].push_back(shard);
+
+        }
+
+        // Function to return the distinct shards holding copies of a book, in the order they were added
+        vector<int> findShards(int bookType, const string& title, const string& author) {
+
+            vector<int> found;
+            lock_guard<mutex> lock(directoryLock);
+            unordered_map<string, vector<int> >::iterator entry = directory.find(directoryKey(bookType, title, author));
+            if (entry != directory.end()) {
+
+                for (size_t i = 0; i < entry->second.size(); i++) {
+
+                    bool seen = false;
+                    for (size_t j = 0; j < found.size(); j++) {
+
+                        if (found[j] == entry->second[i]) {
+
+                            seen = true;
+
+                        }
+
+                    }
+                    if (!seen) {
+
+                        found.push_back(entry->second[i]);
+
+                    }
+
+                }
+
+            }
+            return found;
+
+        }
+
+        // Function to forget one copy of a book on a shard
+        void removeFromDirectory(int bookType, const string& title, const string& author, int shard) {
+
+            lock_guard<mutex> lock(directoryLock);
+            unordered_map<string, vector<int> >::iterator entry = directory.find(directoryKey(bookType, title, author));
+            if (entry == directory.end()) {
+
+                return;
+
+            }
+            for (size_t i = 0; i < entry->second.size(); i++) {
+
+                if (entry->second[i] == shard) {
+
+                    entry->second.erase(entry->second.begin() + i);
+                    break;
+
+                }
+
+            }
+            if (entry->second.empty()) {
+
+                directory.erase(entry);
+
+            }
+
+        }
+
+    // Public member functions
+    public:
+
+        // Exception classes:
+        //  Exception class to handle a branch number that doesn't exist
+        class invalidBranchError {};
+
+        // Constructor with the number of shards, how to partition them (1 for by branch, 2 for by ISBN hash),
+        // and the number of threads used to search them (0 for one per hardware thread)
+        LibraryNetwork(int shardCount, int partition, size_t threadCount)
+            : pool(threadCount != 0 ? threadCount : max(1u, thread::hardware_concurrency())) {
+
+            partitionChoice = partition;
+            for (int i = 0; i < max(shardCount, 1); i++) {
+
+                shards.push_back(new Library());
+                shardLocks.push_back(new mutex());
+
+            }
+
+        }
+
+        // Destructor; the books themselves belong to the caller, as with Library
+        ~LibraryNetwork() {
+
+            for (size_t i = 0; i < shards.size(); i++) {
+
+                delete shards[i];
+                delete shardLocks[i];
+
+            }
+
+        }
+
+        // Function to add a book of any type to a branch (the branch is ignored when partitioning by ISBN hash)
+        void addBook(Book* b, int branch) {
+
+            int shard = pickShard(b, branch);
+            {
+                lock_guard<mutex> lock(*shardLocks[shard]);
+                shards[shard]->addBook(b);
+            }
+            addToDirectory(b->getType(), b, shard);
+
+        }
+
+        // Function to add a book of any type to the shard its ISBN hashes to
+        void addBook(Book* b) {
+
+            addBook(b, 0);
+
+        }
+
+        // Function to remove a book of a type from the first shard that has it
+        Book* removeBook(int bookType, string title, string author) {
+
+            vector<int> owners = findShards(bookType, title, author);
+            if (owners.size() == 0) {
+
+                throw Library::bookNotFoundError();
+
+            }
+
+            Book* bookPtr;
+            {
+                lock_guard<mutex> lock(*shardLocks[owners[0]]);
+                bookPtr = shards[owners[0]]->removeBook(bookType, title, author);
+            }
+            removeFromDirectory(bookType, title, author, owners[0]);
+            return bookPtr;
+
+        }
+
+        // Function to remove a Textbook from the first shard that has it
+        Textbook* removeTextbook(string title, string author) {
+
+            return static_cast<Textbook*>(removeBook(1, title, author));
+
+        }
+
+        // Function to remove a Fiction Book from the first shard that has it
+        FictionBook* removeFictionBook(string title, string author) {
+
+            return static_cast<FictionBook*>(removeBook(2, title, author));
+
+        }
+
+        // Function to find books by title (searchChoice 1) or author (searchChoice 2) on every shard in parallel
+        vector<Book*> findBooks(string title, string author, int bookType, int searchChoice) {
+
+            // Declaring necessary variables
+            vector< vector<Book*> > shardResults(shards.size());
+            vector< future<void> > pending;
+
+            // Fanning out one search task per shard
+            for (size_t i = 0; i < shards.size(); i++) {
+
+                pending.push_back(pool.submit([this, i, &shardResults, &title, &author, bookType, searchChoice] {
+
+                    lock_guard<mutex> lock(*shardLocks[i]);
+                    shardResults[i] = shards[i]->findBooks(title, author, bookType, searchChoice);
+
+                }));
+
+            }
+
+            // Merging the results in shard order once every task has finished
+            vector<Book*> matchingBooks;
+            for (size_t i = 0; i < pending.size(); i++) {
+
+                pending[i].get();
+                matchingBooks.insert(matchingBooks.end(), shardResults[i].begin(), shardResults[i].end());
+
+            }
+            return matchingBooks;
+
+        }
+
+        // Function for searching for a book on every shard
+        void bookSearch(string title, string author, int bookType, int searchChoice) {
+
+            // Vector to store books with matching titles or authors
+            vector<Book*> matchingBooks = findBooks(title, author, bookType, searchChoice);
+
+            // Throw error if no matches
+            if (matchingBooks.size() == 0) {
+
+                throw Library::bookNotFoundError();
+
+            }
+
+            cout << "\nThere are " << matchingBooks.size() << " book(s) with this title or author across " << shards.size() << " branches:\n" << endl;
+            // Loop to display details of all books of matching title or author
+            for (size_t i = 0; i < matchingBooks.size(); i++) {
+
+                displayDetails(matchingBooks[i]);
+                matchingBooks[i]->displayAvailability();
+                cout << "" << endl;
+
+            }
+
+        }
+
+        // Function to borrow or return a book on behalf of a patron (patron ID 0 means no library card)
+        //  The shards holding copies are tried in order until one of them can borrow or return a copy. A loan is
+        //  reserved against the patron's network-wide limit first, and given back if no shard can lend a copy.
+        void borrowOrReturn(string title, string author, int bookType, int borrowOrReturnChoice, int patronID) {
+
+            vector<int> owners = findShards(bookType, title, author);
+            if (owners.size() == 0) {
+
+                throw Library::bookNotFoundError();
+
+            }
+
+            if (borrowOrReturnChoice == 1) {
+
+                reserveLoans(patronID, 1);
+
+            }
+            try {
+
+                tryShards(owners, title, author, bookType, borrowOrReturnChoice, patronID);
+
+            } catch (...) {
+
+                if (borrowOrReturnChoice == 1) {
+
+                    releaseLoans(patronID, 1);
+
+                }
+                throw;
+
+            }
+            if (borrowOrReturnChoice == 2) {
+
+                releaseLoans(patronID, 1);
+
+            }
+
+        }
+
+        // Function to borrow or return several books at once on behalf of a patron (patron ID 0 means no library card)
+        //  Every shard holding a copy of any book in the batch is locked, always in ascending shard order so two batches
+        //  can't deadlock, and each book is assigned to the first of its shards that can take it. Nothing changes
+        //  until every book has a shard, so either the whole batch goes through or none of it does.
+        void borrowOrReturnBatch(const vector<BatchItem>& items, int borrowOrReturnChoice, int patronID) {
+
+            // Declaring necessary variables
+            vector< vector<int> > owners(items.size());
+            vector<int> lockOrder;
+            vector< unique_lock<mutex> > held;
+            vector< vector<BatchItem> > shardItems(shards.size());
+            vector< vector<Book*> > shardPlans(shards.size());
+
+            // Finding the shards of every book, and throwing error if a book isn't in any of them
+            for (size_t i = 0; i < items.size(); i++) {
+
+                owners[i] = findShards(items[i].bookType, items[i].title, items[i].author);
+                if (owners[i].size() == 0) {
+
+                    throw Library::bookNotFoundError();
+
+                }
+                lockOrder.insert(lockOrder.end(), owners[i].begin(), owners[i].end());
+
+            }
+
+            // Reserving the batch's loans against the patron's network-wide limit, given back if the batch fails
+            if (borrowOrReturnChoice == 1) {
+
+                reserveLoans(patronID, (int) items.size());
+
+            }
+            try {
+
+                // Locking the shards in ascending order
+                sort(lockOrder.begin(), lockOrder.end());
+                lockOrder.erase(unique(lockOrder.begin(), lockOrder.end()), lockOrder.end());
+                for (size_t i = 0; i < lockOrder.size(); i++) {
+
+                    held.push_back(unique_lock<mutex>(*shardLocks[lockOrder[i]]));
+
+                }
+
+                // Loop to assign each book to a shard, checking the shard's whole share of the batch so far (a shard
+                // at the patron's loan limit is passed over like one with no copy)
+                for (size_t i = 0; i < items.size(); i++) {
+
+                    for (size_t j = 0; j < owners[i].size(); j++) {
+
+                        int shard = owners[i][j];
+                        shardItems[shard].push_back(items[i]);
+                        try {
+
+                            shardPlans[shard] = shards[shard]->prepareBatch(shardItems[shard], borrowOrReturnChoice, patronID);
+                            break;
+
+                        }
+                        // Trying the next shard if this one has no copy left to borrow or return
+                        catch (Library::bookNotBorrowableError) {
+
+                            shardItems[shard].pop_back();
+                            if (j + 1 == owners[i].size()) {
+
+                                throw;
+
+                            }
+
+                        }
+                        catch (Library::bookNotReturnableError) {
+
+                            shardItems[shard].pop_back();
+                            if (j + 1 == owners[i].size()) {
+
+                                throw;
+
+                            }
+
+                        }
+                        catch (Library::loanLimitReachedError) {
+
+                            shardItems[shard].pop_back();
+                            if (j + 1 == owners[i].size()) {
+
+                                throw;
+
+                            }
+
+                        }
+
+                    }
+
+                }
+
+                // Every book has a copy, so the batch is committed on each shard
+                for (size_t i = 0; i < shards.size(); i++) {
+
+                    if (shardItems[i].size() != 0) {
+
+                        shards[i]->commitBatch(shardItems[i], borrowOrReturnChoice, patronID, shardPlans[i]);
+
+                    }
+
+                }
+
+            } catch (...) {
+
+                if (borrowOrReturnChoice == 1) {
+
+                    releaseLoans(patronID, (int) items.size());
+
+                }
+                throw;
+
+            }
+            if (borrowOrReturnChoice == 2) {
+
+                releaseLoans(patronID, (int) items.size());
+
+            }
+
+        }
+
+        // Function to register a patron at every branch; the loan limit covers the patron's loans at every branch
+        // together (each branch also checks it, but can never be the first to reach it)
+        void registerPatron(int patronID, int maxLoans) {
+
+            for (size_t i = 0; i < shards.size(); i++) {
+
+                lock_guard<mutex> lock(*shardLocks[i]);
+                shards[i]->registerPatron(patronID, maxLoans);
+
+            }
+            lock_guard<mutex> lock(patronLock);
+            patronLoans[patronID] = {maxLoans, 0};
+
+        }
+
+        // Function to change the number of searches each shard's search cache keeps
+        void setSearchCacheSize(size_t capacity) {
+
+            for (size_t i = 0; i < shards.size(); i++) {
+
+                lock_guard<mutex> lock(*shardLocks[i]);
+                shards[i]->setSearchCacheSize(capacity);
+
+            }
+
+        }
+
+        // Function to return the number of shards
+        size_t getShardCount() {
+
+            return shards.size();
+
+        }
+
+};
+
+
+// Function to measure how search throughput of a LibraryNetwork changes with the number of shards
+//  Every search is for a distinct title and the search caches are turned off, so each one scans every shard
+void runShardScalingBenchmark() {
+
+    // Declaring necessary variables
+    const int bookCount = 400000;
+    const int searchCount = 200;
+    unsigned int hardwareThreads = max(1u, thread::hardware_concurrency());
+    vector<FictionBook*> books;
+
+    for (int i = 0; i < bookCount; i++) {
+
+        books.push_back(new FictionBook("Title " + to_string(i), "Author " + to_string(i % 5000), i, "Genre " + to_string(i % 40),
+                                        "Character " + to_string(i), "Setting " + to_string(i % 300)));
+
+    }
+
+    cout << "\nSearching " << bookCount << " Fiction Books " << searchCount << " times on " << hardwareThreads << " hardware thread(s):\n" << endl;
+    double baseline = 0;
+    for (int shardCount = 1; shardCount <= (int) max(8u, 2 * hardwareThreads); shardCount *= 2) {
+
+        LibraryNetwork network(shardCount, 2, 0);
+        network.setSearchCacheSize(0);
+        for (int i = 0; i < bookCount; i++) {
+
+            network.addBook(books[i]);
+
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        size_t found = 0;
+        for (int i = 0; i < searchCount; i++) {
+
+            found += network.findBooks("Title " + to_string((i * 7919) % bookCount), "", 2, 1).size();
+
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double searchesPerSecond = searchCount / seconds;
+        if (shardCount == 1) {
+
+            baseline = searchesPerSecond;
+
+        }
+
+        cout << "\t" << shardCount << " shard(s): " << searchesPerSecond << " searches/s (" << (searchesPerSecond / baseline)
+             << "x), " << found << " found" << endl;
+
+    }
+
+    for (int i = 0; i < bookCount; i++) {
+
+        delete books[i];
+
+    }
+
+}
+
+
+// Function to compare front coded dictionaries with plain strings for a large synthetic catalog
+//  Reports the memory of each layout and the average time of an equality lookup and of a prefix lookup
+void runDictionaryBenchmark() {
+
+    // Declaring necessary variables
+    const int bookCount = 1000000;
+    const int lookupCount = 200000;
+    const char* words[] = {"Introduction", "Principles", "Calculus", "History", "Modern", "Chemistry", "Organic", "Physics",
+                           "Biology", "Economics", "Shadow", "Kingdom", "Winter", "Dragon", "Secret", "Garden", "Night",
+                           "River", "Empire", "Silent", "Stars", "Journey", "Lost", "City", "Fire", "Ocean", "Glass",
+                           "Iron", "Golden", "Children", "Storm", "Edge"};
+    const char* surnames[] = {"Smith", "Johnson", "Garcia", "Nguyen", "Brown", "Martinez", "Lee", "Walker", "Hernandez",
+                              "Lopez", "Gonzalez", "Wilson", "Anderson", "Thomas", "Taylor", "Moore"};
+    mt19937 random(12345);
+    vector<string> titles, authors;
+
+    for (int i = 0; i < bookCount; i++) {
+
+        string title = "The ";
+        title += words[random() % 32];
+        title += " of ";
+        title += words[random() % 32];
+        title += " ";
+        title += words[random() % 32];
+        title += " Volume " + to_string(i % 997);
+        titles.push_back(title);
+        authors.push_back(string(surnames[random() % 16]) + ", " + words[random() % 32] + " " + to_string(i % 20000));
+
+    }
+
+    // Plain strings, as stored in every Book, and a sorted copy for binary search
+    size_t stringBytes = 0;
+    for (int i = 0; i < bookCount; i++) {
+
+        stringBytes += stringFootprint(titles[i]) + stringFootprint(authors[i]);
+
+    }
+    vector<string> sortedTitles = titles;
+    sort(sortedTitles.begin(), sortedTitles.end());
+
+    vector<string> queries;
+    for (int i = 0; i < lookupCount; i++) {
+
+        queries.push_back(titles[random() % bookCount]);
+
+    }
+
+    cout << "\n" << bookCount << " books, " << lookupCount << " lookups:\n" << endl;
+    cout << "\tPlain strings: " << stringBytes << " bytes for titles and authors ("
+         << (double) stringBytes / bookCount << " bytes per book)" << endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    size_t hits = 0;
+    for (int i = 0; i < lookupCount; i++) {
+
+        hits += binary_search(sortedTitles.begin(), sortedTitles.end(), queries[i]);
+
+    }
+    double plainNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / lookupCount;
+    cout << "\tSorted plain strings: " << plainNanos << " ns per equality lookup (" << hits << " hits)\n" << endl;
+
+    for (int withCodec = 0; withCodec <= 1; withCodec++) {
+
+        FrontCodedDictionary titleDictionary, authorDictionary;
+        titleDictionary.build(titles, withCodec == 1);
+        authorDictionary.build(authors, withCodec == 1);
+        //  Projected: books would hold a 4 byte ID per title and author in place of the strings, which they don't today
+        size_t dictionaryBytes = titleDictionary.memoryUsage() + authorDictionary.memoryUsage() + bookCount * 2 * sizeof(uint32_t);
+
+        start = chrono::steady_clock::now();
+        hits = 0;
+        for (int i = 0; i < lookupCount; i++) {
+
+            hits += titleDictionary.find(queries[i]) >= 0;
+
+        }
+        double findNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / lookupCount;
+
+        start = chrono::steady_clock::now();
+        size_t matches = 0;
+        for (int i = 0; i < lookupCount; i++) {
+
+            size_t first, last;
+            titleDictionary.prefixRange(queries[i].substr(0, 12), first, last);
+            matches += last - first;
+
+        }
+        double prefixNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / lookupCount;
+
+        cout << "\tFront coded" << (withCodec == 1 ? " + bigram codec" : "") << ", projected with 4 byte IDs in place of the strings: "
+             << dictionaryBytes << " bytes (" << (double) dictionaryBytes / bookCount << " bytes per book, "
+             << 100.0 * (1.0 - (double) dictionaryBytes / stringBytes) << "% smaller)" << endl;
+        cout << "\t\t" << findNanos << " ns per equality lookup (" << hits << " hits), " << prefixNanos
+             << " ns per prefix lookup (" << matches << " matches)" << endl;
+
+    }
+
+    // Measured: the key dictionaries books use, filled one key at a time (so new keys go through the delta and are
+    // merged in as it grows), with a 4 byte ID per title and author held by each book
+    KeyDictionary titleKeys, authorKeys;
+    vector<uint32_t> titleIDs(bookCount), authorIDs(bookCount);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < bookCount; i++) {
+
+        titleIDs[i] = titleKeys.add(titles[i]);
+        authorIDs[i] = authorKeys.add(authors[i]);
+
+    }
+    double addNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (2.0 * bookCount);
+    MemoryComponent keys = {"Title and author keys", 0, 0, 0};
+    titleKeys.countMemory(keys);
+    authorKeys.countMemory(keys);
+    size_t keyBytes = keys.blockBytes + bookCount * 2 * sizeof(uint32_t);
+
+    start = chrono::steady_clock::now();
+    hits = 0;
+    string buffer;
+    for (int i = 0; i < lookupCount; i++) {
+
+        int book = (int) (((long) i * 7919) % bookCount);
+        hits += titleKeys.equals(titleIDs[book], titles[book], buffer);
+
+    }
+    double equalsNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / lookupCount;
+
+    cout << "\tKey dictionaries, measured with 4 byte IDs in place of the strings: " << keyBytes << " bytes ("
+         << (double) keyBytes / bookCount << " bytes per book, " << 100.0 * (1.0 - (double) keyBytes / stringBytes)
+         << "% smaller)" << endl;
+    cout << "\t\t" << addNanos << " ns per key added, " << equalsNanos << " ns per ID check against a key ("
+         << hits << " matches)" << endl;
+
+}
+
+
+// Function to compare matching against precomputed normalized keys with normalizing every title per query
+//  Also compares the vectorized normalizer with the UTF-8 (one code point at a time) normalizer
+void runNormalizationBenchmark() {
+
+    // Declaring necessary variables
+    const int bookCount = 200000;
+    const int searchCount = 200;
+    vector<FictionBook*> books;
+    Library library;
+    library.setSearchCacheSize(0);
+
+    for (int i = 0; i < bookCount; i++) {
+
+        books.push_back(new FictionBook("The Chronicles of Title Number " + to_string(i), "Author " + to_string(i % 5000), i,
+                                        "Genre", "Character", "Setting"));
+        library.addBook(books[i]);
+
+    }
+
+    // Normalizer throughput
+    size_t totalLength = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < bookCount; i++) {
+
+        totalLength += normalizeKey(books[i]->getTitle()).size();
+
+    }
+    double fastNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / bookCount;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < bookCount; i++) {
+
+        totalLength += normalizeKeyUtf8(books[i]->getTitle()).size();
+
+    }
+    double utf8Nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / bookCount;
+
+    // Searches with keys computed on insert
+    size_t found = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < searchCount; i++) {
+
+        found += library.findBooks("  the CHRONICLES of title number " + to_string((i * 7919) % bookCount), "", 2, 1).size();
+
+    }
+    double keyedMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / searchCount;
+
+    // Searches that normalize every title while scanning
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < searchCount; i++) {
+
+        string queryKey = normalizeKey("  the CHRONICLES of title number " + to_string((i * 7919) % bookCount));
+        for (int j = 0; j < bookCount; j++) {
+
+            found += normalizeKey(books[j]->getTitle()) == queryKey;
+
+        }
+
+    }
+    double perQueryMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / searchCount;
+
+    cout << "\nNormalizing " << bookCount << " titles: " << fastNanos << " ns per title (vectorized ASCII path), "
+         << utf8Nanos << " ns per title (UTF-8 path)" << endl;
+    cout << "Searching " << bookCount << " Fiction Books " << searchCount << " times: " << keyedMicros
+         << " us per search with keys computed on insert, " << perQueryMicros << " us per search normalizing every title per query ("
+         << found << " found, " << totalLength << " bytes normalized)" << endl;
+
+    // The library is not used again, so the books can be deleted without removing them one by one
+    for (int i = 0; i < bookCount; i++) {
+
+        delete books[i];
+
+    }
+
+}
+
+
+// Function to compare lookups of books the library doesn't have with and without the Bloom filters
+void runBloomFilterBenchmark() {
+
+    // Declaring necessary variables
+    const int bookCount = 200000;
+    const int lookupCount = 200;
+    vector<FictionBook*> books;
+    for (int i = 0; i < bookCount; i++) {
+
+        books.push_back(new FictionBook("Title " + to_string(i), "Author " + to_string(i % 5000), i, "Genre", "Character", "Setting"));
+
+    }
+
+    cout << "\n" << lookupCount << " lookups of titles that aren't in a library of " << bookCount << " Fiction Books:\n" << endl;
+    double rates[] = {0, 0.05, 0.01, 0.001};
+    for (int r = 0; r < 4; r++) {
+
+        Library library;
+        library.configureBloomFilters(rates[r]);
+        library.setSearchCacheSize(0);
+        for (int i = 0; i < bookCount; i++) {
+
+            library.addBook(books[i]);
+
+        }
+
+        // Misses through bookSearch's lookup, borrowOrReturn, and removeFictionBook
+        size_t notFound = 0;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int i = 0; i < lookupCount; i++) {
+
+            string missing = "Missing Title " + to_string(i);
+            notFound += library.findBooks(missing, "", 2, 1).empty();
+            try {
+
+                library.borrowOrReturn(missing, "Author 1", 2, 1);
+
+            } catch (Library::bookNotFoundError) {
+
+                notFound++;
+
+            }
+            try {
+
+                delete library.removeFictionBook(missing, "Author 1");
+
+            } catch (Library::bookNotFoundError) {
+
+                notFound++;
+
+            }
+
+        }
+        double nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (3.0 * lookupCount);
+        BloomFilterStats stats = library.getBloomFilterStats();
+
+        if (rates[r] == 0) {
+
+            cout << "\tNo Bloom filters: " << nanos << " ns per miss (" << notFound << " not found)" << endl;
+
+        } else {
+
+            cout << "\tFalse positive rate " << rates[r] << ": " << nanos << " ns per miss, " << stats.rejections << " of "
+                 << stats.checks << " checks rejected, " << stats.bytes << " bytes of filters" << endl;
+
+        }
+
+    }
+
+    // Rejection cost on its own, with a much larger number of lookups
+    Library library;
+    for (int i = 0; i < bookCount; i++) {
+
+        library.addBook(books[i]);
+
+    }
+    vector<string> missing;
+    for (int i = 0; i < 1000000; i++) {
+
+        missing.push_back("Missing Title " + to_string(i));
+
+    }
+    size_t found = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < missing.size(); i++) {
+
+        found += library.findBooks(missing[i], "", 2, 1).size();
+
+    }
+    double nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / missing.size();
+    cout << "\tfindBooks on a miss with the default filters (the title hashed as it is normalized): " << nanos << " ns ("
+         << found << " found)" << endl;
+
+    // The filter check by itself, on keys that are already normalized
+    CountingBloomFilter filter;
+    filter.reset(bookCount * 3, Library::DEFAULT_BLOOM_FALSE_POSITIVE_RATE);
+    for (int i = 0; i < bookCount; i++) {
+
+        string titleKey = books[i]->getTitleKey(), authorKey = books[i]->getAuthorKey();
+        filter.insert('t', titleKey, nullptr);
+        filter.insert('a', authorKey, nullptr);
+        filter.insert('b', titleKey, &authorKey);
+
+    }
+    for (size_t i = 0; i < missing.size(); i++) {
+
+        missing[i] = normalizeKey(missing[i]);
+
+    }
+    found = 0;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < missing.size(); i++) {
+
+        found += filter.mightContain('t', missing[i], nullptr);
+
+    }
+    nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / missing.size();
+    cout << "\tBloom filter check alone: " << nanos << " ns (" << found << " false positives out of " << missing.size() << ")" << endl;
+
+    for (int i = 0; i < bookCount; i++) {
+
+        delete books[i];
+
+    }
+
+}
+
+
+// Function to compare scanning books with every field inline (as they used to be) against the hot/cold split, and
+// against a probe of the search index, with the cold details in memory and paged out to a file
+void runHotColdBenchmark() {
+
+    // Textbook with every field inline, as before the split
+    struct InlineTextbook {
+        string title, author, genre;
+        string titleKey, authorKey;
+        uint64_t isbn;
+        bool availability;
+        string course, edition;
+    };
+
+    // Declaring necessary variables
+    const int bookCount = 1000000;
+    const int scanCount = 20;
+    const char* detailPath = "hot-cold-benchmark.details";
+    vector<InlineTextbook*> inlineBooks;
+    vector<Textbook*> books;
+    for (int i = 0; i < bookCount; i++) {
+
+        InlineTextbook* old = new InlineTextbook();
+        old->title = "Title " + to_string(i);
+        old->author = "Author " + to_string(i % 5000);
+        old->genre = "Genre of book " + to_string(i % 40);
+        old->titleKey = normalizeKey(old->title);
+        old->authorKey = normalizeKey(old->author);
+        old->isbn = i;
+        old->availability = true;
+        old->course = "Course number " + to_string(i % 300);
+        old->edition = "First edition";
+        inlineBooks.push_back(old);
+
+    }
+    for (int i = 0; i < bookCount; i++) {
+
+        books.push_back(new Textbook("Title " + to_string(i), "Author " + to_string(i % 5000), i, "Genre of book " + to_string(i % 40),
+                                     "Course number " + to_string(i % 300), "First edition"));
+
+    }
+    Library library;
+    library.configureBloomFilters(0);
+    for (int i = 0; i < bookCount; i++) {
+
+        library.addBook(books[i]);
+
+    }
+
+    cout << "\nScanning " << bookCount << " Textbooks for a title and author that match nothing, " << scanCount << " times:\n" << endl;
+    cout << "\tObject size: " << sizeof(InlineTextbook) << " bytes inline; " << sizeof(Textbook) << " bytes hot + "
+         << sizeof(BookDetails) << " bytes of cold details" << endl;
+    const char* names[] = {"Every field inline, through the book pointers", "Hot/cold split, through the book pointers",
+                           "Hot/cold split, through the search index", "Same, with the details paged out"};
+    for (int layout = 0; layout < 4; layout++) {
+
+        if (layout == 3) {
+
+            cout << "\t(" << library.pageOutDetails(detailPath) << " books paged out)" << endl;
+
+        }
+
+        size_t matches = 0;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int scan = 0; scan < scanCount; scan++) {
+
+            BatchQuery query;
+            query.queryChoice = 2;
+            query.bookType = 1;
+            query.title = "Missing Title " + to_string(scan);
+            query.author = "Author 7";
+            string titleKey = normalizeKey(query.title), authorKey = normalizeKey(query.author);
+            if (layout >= 2) {
+
+                matches += library.lookup(query).size();
+                continue;
+
+            }
+            long titleID = bookTitleKeys.find(titleKey), authorID = bookAuthorKeys.find(authorKey);
+            for (int i = 0; i < bookCount; i++) {
+
+                if (layout == 0) {
+
+                    matches += (inlineBooks[i]->titleKey == titleKey) && (inlineBooks[i]->authorKey == authorKey);
+
+                } else {
+
+                    matches += ((long) books[i]->getTitleID() == titleID) && ((long) books[i]->getAuthorID() == authorID);
+
+                }
+
+            }
+
+        }
+        double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / scanCount;
+        cout << "\t" << names[layout] << ": " << millis << " ms per scan (" << matches << " matches)" << endl;
+
+    }
+
+    // Reading the details back from the file for a display
+    cout << "\tDetails read back from the file: " << books[bookCount / 2]->getGenre() << ", " << books[bookCount / 2]->getCourse() << endl;
+
+    for (int i = 0; i < bookCount; i++) {
+
+        delete inlineBooks[i];
+        delete books[i];
+
+    }
+
+}
+
+
+// Function to compare validating millions of ISBNs one at a time (parseISBN) with the batch validator, over plain
+// ISBN-13s (the batch validator's SSE2 path) and over a mix with hyphens and ISBN-10s
+void runISBNBenchmark() {
+
+    // Declaring necessary variables
+    const int isbnCount = 2000000;
+    mt19937_64 random(40);
+    vector<string> plain, mixed;
+    plain.reserve(isbnCount);
+    mixed.reserve(isbnCount);
+
+    // Random ISBN-13s, one in ten with a wrong check digit; the mix also has hyphenated ISBN-13s and ISBN-10s
+    for (int i = 0; i < isbnCount; i++) {
+
+        int digits[13] = {9, 7, (random() % 2 == 0) ? 8 : 9};
+        for (int d = 3; d < 12; d++) {
+
+            digits[d] = (int) (random() % 10);
+
+        }
+        digits[12] = (isbn13CheckDigit(digits) + ((random() % 10 == 0) ? 1 : 0)) % 10;
+        string text;
+        for (int d = 0; d < 13; d++) {
+
+            text += char('0' + digits[d]);
+
+        }
+        plain.push_back(text);
+        if (i % 3 == 0) {
+
+            mixed.push_back(text.substr(0, 3) + "-" + text.substr(3, 1) + "-" + text.substr(4, 4) + "-" +
+                            text.substr(8, 4) + "-" + text.substr(12));
+
+        } else if (i % 3 == 1) {
+
+            int sum = 0;
+            for (int d = 3; d < 12; d++) {
+
+                sum += digits[d] * (13 - d);
+
+            }
+            int check = (11 - sum % 11) % 11;
+            mixed.push_back(text.substr(3, 9) + ((check == 10) ? 'X' : char('0' + check)));
+
+        } else {
+
+            mixed.push_back(text);
+
+        }
+
+    }
+
+    cout << "\nValidating " << isbnCount << " ISBNs:\n" << endl;
+    vector<string>* inputs[2] = {&plain, &mixed};
+    const char* names[2] = {"Plain ISBN-13s", "Mixed forms"};
+    for (int n = 0; n < 2; n++) {
+
+        vector<string>& texts = *inputs[n];
+
+        // One at a time
+        vector<uint64_t> single(texts.size());
+        size_t singleValid = 0;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t i = 0; i < texts.size(); i++) {
+
+            singleValid += parseISBN(texts[i], single[i]) ? 1 : 0;
+
+        }
+        double singleSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        // Batch validator
+        vector<uint64_t> batch;
+        start = chrono::steady_clock::now();
+        size_t batchValid = validateISBNs(texts, batch);
+        double batchSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        size_t mismatches = (singleValid != batchValid) ? 1 : 0;
+        for (size_t i = 0; i < texts.size(); i++) {
+
+            mismatches += (batch[i] != 0 && batch[i] != single[i]);
+
+        }
+        cout << "\t" << names[n] << ": " << batchValid << " valid, " << mismatches << " mismatches" << endl;
+        cout << "\t\tOne at a time: " << texts.size() / singleSeconds / 1e6 << " million per second" << endl;
+        cout << "\t\tBatch validator: " << texts.size() / batchSeconds / 1e6 << " million per second" << endl;
+
+    }
+
+}
+
+
+// Function to build a catalog of the given number of books, display its memory report before and after paging the
+// details out, and, with the tracking allocator hook compiled in, check the report against what was really allocated
+//  Returns 1 if the report and the tracked heap disagree (so a structure left out of the report fails the check),
+//  otherwise 0
+int runMemoryReport(int bookCount) {
+
+    // Declaring necessary variables
+    size_t startBytes, startAllocations, bytes, allocations;
+    int result = 0;
+    const char* genres[] = {"Science", "History", "Mathematics", "Fantasy", "Mystery", "Science Fiction and Fantasy"};
+    mt19937 random(41);
+    vector<Book*> books;
+    books.reserve(bookCount);
+    trackedAllocationTotals(startBytes, startAllocations);
+
+    // Library with short and long titles, a few hundred patrons, loans, holds, searches, and snapshots turned on
+    Library* library = new Library();
+    library->setShowMessages(false);
+    library->enableSnapshots(true);
+    for (int i = 0; i < bookCount; i++) {
+
+        string title = (i % 4 == 0) ? "Book " + to_string(i) : "A Longer Title for Book Number " + to_string(i);
+        string author = "Author " + to_string(i % (bookCount / 10 + 1));
+        if (i % 3 == 0) {
+
+            Textbook* b = new Textbook(title, author, i + 1, genres[random() % 6], "Course " + to_string(i % 200), "2nd");
+            library->addBook(b);
+            books.push_back(b);
+
+        } else {
+
+            FictionBook* b = new FictionBook(title, author, i + 1, genres[random() % 6], "Main character " + to_string(i % 500), "City");
+            library->addBook(b);
+            books.push_back(b);
+
+        }
+
+    }
+    for (int p = 1; p <= 300; p++) {
+
+        library->registerPatron(p, 5);
+        int i = (int) (random() % bookCount);
+        string title = (i % 4 == 0) ? "Book " + to_string(i) : "A Longer Title for Book Number " + to_string(i);
+        string author = "Author " + to_string(i % (bookCount / 10 + 1));
+        int bookType = (i % 3 == 0) ? 1 : 2;
+        try {
+
+            library->borrowOrReturn(title, author, bookType, 1, p);
+            library->placeHold(title, author, bookType, (p % 300) + 1);
+
+        } catch (...) {
+
+            // Some books are picked twice; those loans and holds are just skipped
+
+        }
+        library->findBooks(title, "", bookType, 1);
+
+    }
+    library->getDictionaryReport();
+
+    // Report against the tracked heap, with the details in memory and then paged out
+    for (int pass = 0; pass < 2; pass++) {
+
+        if (pass == 1) {
+
+            cout << "After paging out the details of " << library->pageOutDetails("memory_report_details.bin") << " books:" << endl;
+
+        }
+        trackedAllocationTotals(bytes, allocations);
+        MemoryReport report = library->getMemoryReport();
+        library->displayMemoryReport();
+        size_t reportBytes = 0, reportAllocations = 0;
+        for (size_t i = 0; i < report.components.size(); i++) {
+
+            reportBytes += report.components[i].bytes;
+            reportAllocations += report.components[i].allocations;
+
+        }
+        reportBytes += sizeof(Library);
+        reportAllocations++;
+        if (allocationTrackingEnabled()) {
+
+            cout << "\tTracking allocator: " << bytes - startBytes << " bytes in " << allocations - startAllocations
+                 << " allocations (the report counts " << reportBytes << " bytes in " << reportAllocations
+                 << ", plus the Library object)\n" << endl;
+            if (bytes - startBytes != reportBytes || allocations - startAllocations != reportAllocations) {
+
+                cout << "ERROR: The memory report doesn't match the tracking allocator; "
+                     << (long long) (bytes - startBytes) - (long long) reportBytes << " bytes in "
+                     << (long long) (allocations - startAllocations) - (long long) reportAllocations
+                     << " allocations are not counted by any component.\n" << endl;
+                result = 1;
+
+            }
+
+        } else {
+
+            cout << "\tBuild with -DLMS_TRACK_ALLOCATIONS to check these numbers against the allocator\n" << endl;
+
+        }
+
+    }
+
+    // The library doesn't own its books, so they are deleted here (which also unmaps the detail file)
+    delete library;
+    for (size_t i = 0; i < books.size(); i++) {
+
+        delete books[i];
+
+    }
+    return result;
+
+}
+
+
+// Function to compare exporting a large catalog as CSV, JSON, and NDJSON on one and several threads with writing the
+// same number of bytes straight from memory, which is as fast as the disk can go
+void runExportBenchmark() {
+
+    // Declaring necessary variables
+    const int bookCount = 500000;
+    const char* path = "export_benchmark.tmp";
+    const char* formats[] = {"", "CSV", "JSON", "NDJSON"};
+    vector<size_t> threadCounts = {1, 2, 4};
+    vector<Book*> books;
+    Library library;
+    if (thread::hardware_concurrency() > 4) {
+
+        threadCounts.push_back(thread::hardware_concurrency());
+
+    }
+    library.configureBloomFilters(0);
+    for (int i = 0; i < bookCount; i++) {
+
+        string title = "The \"Collected\" Works, Volume " + to_string(i);
+        if (i % 2 == 0) {
+
+            Textbook* b = new Textbook(title, "Author " + to_string(i % 20000), 9780000000000LL + i, "Genre " + to_string(i % 40),
+                                       "Course " + to_string(i % 300), "3rd");
+            library.addBook(b);
+            books.push_back(b);
+
+        } else {
+
+            FictionBook* b = new FictionBook(title, "Author " + to_string(i % 20000), 9780000000000LL + i, "Genre " + to_string(i % 40),
+                                             "Character " + to_string(i % 900), "Paris, France");
+            library.addBook(b);
+            books.push_back(b);
+
+        }
+
+    }
+
+    cout << "\nExporting " << bookCount << " books (" << thread::hardware_concurrency() << " hardware threads):\n" << endl;
+    for (int format = 1; format <= 3; format++) {
+
+        for (size_t t = 0; t < threadCounts.size(); t++) {
+
+            CatalogExporter exporter(format, threadCounts[t]);
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            uint64_t bytes = exporter.exportCatalog(library, path);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            cout << "\t" << formats[format] << ", " << threadCounts[t] << " thread(s): " << bytes << " bytes in "
+                 << seconds * 1000 << " ms (" << bytes / seconds / 1e6 << " MB/s)" << endl;
+
+            // Writing the same number of bytes from memory, once per format
+            if (t == 0) {
+
+                string block(1 << 20, 'x');
+                ofstream out(path, ios::binary | ios::trunc);
+                start = chrono::steady_clock::now();
+                for (uint64_t left = bytes; left > 0; left -= min(left, (uint64_t) block.size())) {
+
+                    out.write(block.data(), min(left, (uint64_t) block.size()));
+
+                }
+                out.close();
+                seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                cout << "\t" << formats[format] << ", writing the bytes only: " << seconds * 1000 << " ms ("
+                     << bytes / seconds / 1e6 << " MB/s)" << endl;
+
+            }
+
+        }
+
+    }
+    remove(path);
+
+    for (size_t i = 0; i < books.size(); i++) {
+
+        delete books[i];
+
+    }
+
+}
+
+
+// Function to measure how fast the co-borrow graph records borrows and serves recommendations, and how much memory
+// its links take, over simulated borrowing sessions where patrons mostly borrow titles on one topic
+void runRecommendationBenchmark() {
+
+    // Declaring necessary variables
+    const int titleCount = 100000;
+    const int topicSize = 50;
+    const int patronCount = 20000;
+    const int sessionCount = 400000;
+    const int queryCount = 20000;
+    mt19937 random(43);
+    vector<Book*> books;
+    vector<string> keys;
+    CoBorrowGraph graph;
+
+    // Titles in topics of 50, by authors who write two or three titles each
+    for (int i = 0; i < titleCount; i++) {
+
+        int topic = i / topicSize;
+        Book* b = new FictionBook("Title " + to_string(i), "Author " + to_string(i / 3), i + 1, "Genre " + to_string(topic % 40),
+                                  "Someone", "Somewhere");
+        books.push_back(b);
+        keys.push_back("2\x1f" + b->getTitleKey() + "\x1f" + b->getAuthorKey());
+        graph.addCopy(keys[i], b, 2);
+
+    }
+
+    // Sessions of 2 to 6 borrows a few minutes apart, each patron's sessions at least a day apart; one borrow in
+    // ten is off topic
+    vector<int64_t> patronTime(patronCount, 0);
+    size_t borrows = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int s = 0; s < sessionCount; s++) {
+
+        int patron = (int) (random() % patronCount);
+        int topic = (int) (random() % (titleCount / topicSize));
+        int length = 2 + (int) (random() % 5);
+        patronTime[patron] += 86400 + (int64_t) (random() % 86400);
+        for (int i = 0; i < length; i++) {
+
+            int title = (random() % 10 == 0) ? (int) (random() % titleCount) : topic * topicSize + (int) (random() % topicSize);
+            graph.recordBorrow(patron + 1, keys[title], books[title], 2, patronTime[patron] + i * 300);
+            borrows++;
+
+        }
+
+    }
+    double recordNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / borrows;
+
+    // Memory of the links
+    MemoryComponent memory = {"Co-borrow graph", 0, 0, 0};
+    graph.countMemory(memory);
+    size_t links = graph.getLinkCount();
+
+    // Top 10 recommendations for random titles, and how many of them are on the same topic
+    vector<double> latencies;
+    size_t recommended = 0, sameTopic = 0;
+    for (int q = 0; q < queryCount; q++) {
+
+        int title = (int) (random() % titleCount);
+        start = chrono::steady_clock::now();
+        vector<Recommendation> top = graph.recommend(keys[title], 10);
+        latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+        for (size_t i = 0; i < top.size(); i++) {
+
+            int other = atoi(top[i].title.c_str() + 6);
+            sameTopic += (other / topicSize == title / topicSize);
+
+        }
+        recommended += top.size();
+
+    }
+    sort(latencies.begin(), latencies.end());
+
+    cout << "\n" << titleCount << " titles, " << borrows << " borrows in " << sessionCount << " sessions by " << patronCount << " patrons:\n" << endl;
+    cout << "\tRecording a borrow: " << recordNanos << " ns (" << graph.getMergeCount() << " merges into CSR form)" << endl;
+    cout << "\tLinks: " << links << " pairs of titles in " << memory.bytes << " bytes ("
+         << (double) memory.bytes / links << " bytes per pair, including the titles)" << endl;
+    cout << "\tTop 10 recommendations: " << latencies[queryCount / 2] << " us median, " << latencies[queryCount * 99 / 100]
+         << " us p99, " << (double) recommended / queryCount << " per title, "
+         << (recommended == 0 ? 0.0 : 100.0 * sameTopic / recommended) << "% on the same topic" << endl;
+
+    for (size_t i = 0; i < books.size(); i++) {
+
+        delete books[i];
+
+    }
+
+}
+
+
+// Function to compare answering faceted filters (with their facet counts) from the bitmap index with scanning both
+//  sections and reading every book's details
+void runFacetBenchmark() {
+
+    // Declaring necessary variables
+    const int booksPerType = 100000;
+    const int queryCount = 300;
+    mt19937 random(45);
+    vector<Book*> books;
+    Library library;
+    library.setShowMessages(false);
+
+    // Textbooks over 40 genres, 300 courses, and 8 editions, Fiction Books over 40 genres and 50 settings, with about
+    // a third of the copies borrowed
+    for (int i = 0; i < booksPerType; i++) {
+
+        Textbook* txtPtr = new Textbook("Textbook " + to_string(i), "Author " + to_string(i % 5000), 9780000000000LL + i,
+                                        "Genre " + to_string(random() % 40), "Course " + to_string(random() % 300),
+                                        "Edition " + to_string(1 + random() % 8));
+        FictionBook* ficPtr = new FictionBook("Novel " + to_string(i), "Author " + to_string(i % 5000), 9790000000000LL + i,
+                                              "Genre " + to_string(random() % 40), "Someone", "Setting " + to_string(random() % 50));
+        books.push_back(txtPtr);
+        books.push_back(ficPtr);
+        library.addBook(txtPtr);
+        library.addBook(ficPtr);
+
+    }
+    for (size_t i = 0; i < books.size(); i++) {
+
+        if (random() % 3 == 0) {
+
+            library.borrowOrReturn(books[i]->getTitle(), books[i]->getAuthor(), (i % 2 == 0) ? 1 : 2, 1);
+
+        }
+
+    }
+
+    // Queries: available Textbooks for a course and edition, Fiction in a genre with a setting, and books of either
+    // of two genres that aren't Textbooks for a course
+    vector<FacetFilter> filters;
+    for (int q = 0; q < queryCount; q++) {
+
+        string genre = "Genre " + to_string(random() % 40), other = "Genre " + to_string(random() % 40);
+        string course = "Course " + to_string(random() % 300), edition = "Edition " + to_string(1 + random() % 8);
+        string setting = "Setting " + to_string(random() % 50);
+        if (q % 3 == 0) {
+
+            filters.push_back(facetAnd(facetAnd(facetAnd(facetType(1), facetTerm(FacetFilter::COURSE, course)),
+                                                facetTerm(FacetFilter::EDITION, edition)), facetAvailable()));
+
+        } else if (q % 3 == 1) {
+
+            filters.push_back(facetAnd(facetAnd(facetType(2), facetTerm(FacetFilter::GENRE, genre)),
+                                       facetTerm(FacetFilter::SETTING, setting)));
+
+        } else {
+
+            filters.push_back(facetAnd(facetOr(facetTerm(FacetFilter::GENRE, genre), facetTerm(FacetFilter::GENRE, other)),
+                                       facetNot(facetTerm(FacetFilter::COURSE, course))));
+
+        }
+
+    }
+
+    // Function to check one book against a filter by reading its details (values compared as stored)
+    function<bool(const FacetFilter&, Book*, int, const BookDetails&)> matches =
+        [&matches](const FacetFilter& filter, Book* b, int bookType, const BookDetails& details) {
+
+        if (filter.op != FacetFilter::TERM) {
+
+            bool any = false, all = true;
+            for (size_t i = 0; i < filter.operands.size(); i++) {
+
+                bool m = matches(filter.operands[i], b, bookType, details);
+                any = any || m;
+                all = all && m;
+
+            }
+            return (filter.op == FacetFilter::AND) ? all : (filter.op == FacetFilter::OR) ? any : !all;
+
+        }
+        switch (filter.field) {
+
+            case FacetFilter::GENRE:
+                return details.genre == filter.value;
+            case FacetFilter::TYPE:
+                return filter.value == to_string(bookType);
+            case FacetFilter::AVAILABILITY:
+                return b->getAvailability() == (filter.value == "1");
+            default:
+                return (BOOK_TYPES[bookType].field1Facet == filter.field && details.field1 == filter.value) ||
+                       (BOOK_TYPES[bookType].field2Facet == filter.field && details.field2 == filter.value);
+
+        }
+
+    };
+
+    // Scanning: every book's details read and checked, with the matches' values tallied for the facet counts
+    uint64_t scanMatches = 0, bitmapMatches = 0;
+    BookDetails details;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int q = 0; q < queryCount; q++) {
+
+        unordered_map<string, uint64_t> tallies[FACET_FIELD_COUNT];
+        for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+            for (size_t i = 0; i < library.getSectionSize(bookType); i++) {
+
+                Book* b = library.getSectionBook(bookType, i);
+                b->readDetails(details);
+                if (matches(filters[q], b, bookType, details)) {
+
+                    scanMatches++;
+                    tallies[0][details.genre]++;
+                    if (BOOK_TYPES[bookType].field1Facet != 0) {
+
+                        tallies[BOOK_TYPES[bookType].field1Facet - 1][details.field1]++;
+
+                    }
+                    if (BOOK_TYPES[bookType].field2Facet != 0) {
+
+                        tallies[BOOK_TYPES[bookType].field2Facet - 1][details.field2]++;
+
+                    }
+
+                }
+
+            }
+
+        }
+
+    }
+    double scanMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / queryCount;
+
+    // Bitmaps: the same filters, with the facet counts of every field
+    size_t facetValues = 0;
+    start = chrono::steady_clock::now();
+    for (int q = 0; q < queryCount; q++) {
+
+        FilterResult result = library.filterBooks(filters[q], 20);
+        bitmapMatches += result.matches;
+        facetValues += result.facets.size();
+
+    }
+    double bitmapMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / queryCount;
+    MemoryReport memory = library.getMemoryReport();
+    size_t bitmapBytes = 0;
+    for (size_t i = 0; i < memory.components.size(); i++) {
+
+        bitmapBytes += (memory.components[i].name == "Facet bitmaps") ? memory.components[i].blockBytes : 0;
+
+    }
+
+    cout << "\n" << queryCount << " faceted filters with facet counts over " << 2 * booksPerType << " books:\n" << endl;
+    cout << "\tScanning both sections: " << scanMicros << " us per filter" << endl;
+    cout << "\tBitmap index: " << bitmapMicros << " us per filter (" << (double) facetValues / queryCount
+         << " facet values counted per filter), " << bitmapBytes << " bytes of bitmaps ("
+         << (double) bitmapBytes / (2 * booksPerType) << " bytes per book)" << endl;
+    cout << "\tMatches: " << bitmapMatches << " from the bitmaps, " << scanMatches << " from scanning"
+         << (bitmapMatches == scanMatches ? "" : " (MISMATCH)") << endl;
+
+    for (size_t i = 0; i < books.size(); i++) {
+
+        delete books[i];
+
+    }
+
+}
+
+
+// Function to export the catalog a mutation log describes to a file in a format ("csv", "json", or "ndjson")
+int runExport(string formatName, string path, string logPath, size_t threadCount) {
+
+    // Declaring necessary variables
+    int format = (formatName == "csv") ? 1 : (formatName == "json") ? 2 : (formatName == "ndjson") ? 3 : 0;
+    Library library;
+    if (format == 0) {
+
+        cout << "ERROR: The export format must be csv, json, or ndjson." << endl;
+        return 1;
+
+    }
+
+    // Replaying the log into an empty library, then exporting it
+    LogFollower replay(logPath, &library);
+    library.setShowMessages(false);
+    replay.poll();
+    if (!replay.isCompatible()) {
+
+        cout << "ERROR: " << logPath << " is not a version " << MutationLog::FORMAT_VERSION << " log and can't be replayed." << endl;
+        return 1;
+
+    }
+    try {
+
+        CatalogExporter exporter(format, threadCount);
+        uint64_t bytes = exporter.exportCatalog(library, path);
+        size_t books = 0;
+        for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+            books += library.getSectionSize(bookType);
+
+        }
+        cout << "Exported " << books << " books (" << bytes << " bytes) to "
+             << path << "." << endl;
+
+    }
+    catch (CatalogExporter::exportFileError) {
+
+        cout << "ERROR: " << path << " could not be written." << endl;
+        return 1;
+
+    }
+    return 0;
+
+}
+
+
+// Function to replay a trace recorded with --trace and display how long each kind of call took
+int runTraceReplay(string path, bool originalSpeed) {
+
+    TraceReplayer replayer(path);
+    if (!replayer.load()) {
+
+        if (replayer.getVersion() != 0 && replayer.getVersion() != TraceRecorder::FORMAT_VERSION) {
+
+            cout << "ERROR: " << path << " is a version " << replayer.getVersion() << " trace; only version "
+                 << TraceRecorder::FORMAT_VERSION << " traces can be replayed." << endl;
+
+        } else {
+
+            cout << "ERROR: " << path << " could not be read as a trace." << endl;
+
+        }
+        return 1;
+
+    }
+    cout << "Replaying " << replayer.getCallCount() << " calls from " << path
+         << (originalSpeed ? " at the speed they were recorded." : " as fast as possible.") << endl;
+    vector<TraceOpStats> stats = replayer.replay(originalSpeed);
+    TraceReplayer::displayReport(stats);
+    return 0;
+
+}
+
+
+// Function to compare finding the books of any type with a title or author in one findBooks call (one probe of the
+// search index) with one findBooks call per type whose results are then merged
+void runAnyTypeBenchmark() {
+
+    // Declaring necessary variables
+    const int bookCount = 200000;
+    const int searchCount = 2000;
+    vector<Book*> books;
+    for (int i = 0; i < bookCount; i++) {
+
+        string title = "Title " + to_string(i % 50000), author = "Author " + to_string(i % 5000);
+        if (i % 2 == 0) {
+
+            books.push_back(new Textbook(title, author, 9780000000000LL + i, "Genre", "Course", "1st"));
+
+        } else {
+
+            books.push_back(new FictionBook(title, author, 9790000000000LL + i, "Genre", "Character", "Setting"));
+
+        }
+
+    }
+
+    cout << "\n" << searchCount << " title and " << searchCount << " author searches of " << bookCount / 2 << " Textbooks and "
+         << bookCount / 2 << " Fiction Books, for books of any type (search cache off):\n" << endl;
+    {
+
+        Library library;
+        library.setSearchCacheSize(0);
+        for (int i = 0; i < bookCount; i++) {
+
+            if (i % 2 == 0) {
+
+                library.addBook(static_cast<Textbook*>(books[i]));
+
+            } else {
+
+                library.addBook(static_cast<FictionBook*>(books[i]));
+
+            }
+
+        }
+
+        const char* modes[2] = {"One findBooks call per type", "Any type in one call"};
+        for (int mode = 0; mode < 2; mode++) {
+
+            size_t found = 0;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (int i = 0; i < searchCount; i++) {
+
+                for (int searchChoice = 1; searchChoice <= 2; searchChoice++) {
+
+                    string title = "Title " + to_string(i * 7 % 50000), author = "Author " + to_string(i * 7 % 5000);
+                    vector<Book*> matchingBooks;
+                    if (mode == 0) {
+
+                        for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                            vector<Book*> ofType = library.findBooks(title, author, bookType, searchChoice);
+                            matchingBooks.insert(matchingBooks.end(), ofType.begin(), ofType.end());
+
+                        }
+
+                    } else {
+
+                        matchingBooks = library.findBooks(title, author, 0, searchChoice);
+
+                    }
+                    found += matchingBooks.size();
+
+                }
+
+            }
+            double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / (2.0 * searchCount);
+            cout << "\t" << modes[mode] << ": " << micros << " us per search (" << found << " matches)" << endl;
+
+        }
+
+    }
+
+    for (int i = 0; i < bookCount; i++) {
+
+        delete books[i];
+
+    }
+
+}
+
+
+// Function to measure what tracing adds to each call, then check that replaying the trace reproduces every outcome
+void runTraceBenchmark() {
+
+    // Declaring necessary variables
+    const int bookCount = 20000;
+    const int patronCount = 200;
+    const int operationCount = 200000;
+    const string tracePath = "trace_benchmark.lmstrace";
+    double seconds[2] = {1e9, 1e9};
+    uint64_t traced = 0;
+
+    // Running the workload four times, alternating without and with tracing, and keeping the faster run of each
+    cout << "\nA workload of " << bookCount << " added Textbooks and " << operationCount
+         << " searches, facet counts, borrows, and returns, without and with tracing:\n" << endl;
+    for (int run = 0; run < 4; run++) {
+
+        int mode = run % 2;
+        vector<Book*> books;
+        {
+            Library library;
+            TraceRecorder* recorder = nullptr;
+            if (mode == 1) {
+
+                recorder = new TraceRecorder(tracePath);
+                library.attachTraceRecorder(recorder);
+
+            }
+            library.setShowMessages(false);
+            mt19937 random(5);
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+            // Registering the patrons and adding the books, then running a mix of calls, some of which fail
+            for (int p = 1; p <= patronCount; p++) {
+
+                library.registerPatron(p, 5);
+
+            }
+            for (int i = 0; i < bookCount; i++) {
+
+                library.addBook(new Textbook("Title " + to_string(i), "Author " + to_string(i % 500), 9780000000000LL + i,
+                                             "Genre " + to_string(i % 40), "Course", "1st"));
+
+            }
+            for (int i = 0; i < operationCount; i++) {
+
+                int book = (int) (random() % bookCount);
+                int patron = 1 + (int) (random() % patronCount);
+                string title = "Title " + to_string(book), author = "Author " + to_string(book % 500);
+                try {
+
+                    switch (random() % 4) {
+
+                        case 0:
+                            library.findBooks(title, "", 1, 1);
+                            break;
+                        case 1:
+                            library.borrowOrReturn(title, author, 1, 1, patron);
+                            break;
+                        case 2:
+                            library.borrowOrReturn(title, author, 1, 2, patron);
+                            break;
+                        case 3:
+                            library.getFacetCounts(1, "Genre " + to_string(book % 40));
+                            break;
+
+                    }
+
+                } catch (...) {
+
+                }
+
+            }
+            seconds[mode] = min(seconds[mode], chrono::duration<double>(chrono::steady_clock::now() - start).count());
+
+            if (recorder != nullptr) {
+
+                traced = recorder->getCallCount();
+                library.attachTraceRecorder(nullptr);
+                delete recorder;
+
+            }
+            for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+                for (size_t i = 0; i < library.getSectionSize(bookType); i++) {
+
+                    books.push_back(library.getSectionBook(bookType, i));
+
+                }
+
+            }
+        }
+        for (size_t i = 0; i < books.size(); i++) {
+
+            delete books[i];
+
+        }
+
+    }
+
+    ifstream traceFile(tracePath.c_str(), ios::binary | ios::ate);
+    size_t traceBytes = (size_t) traceFile.tellg();
+    traceFile.close();
+    int calls = patronCount + bookCount + operationCount;
+    cout << "\tWithout tracing: " << seconds[0] * 1e9 / calls << " ns per call\n"
+         << "\tWith tracing: " << seconds[1] * 1e9 / calls << " ns per call (" << traced << " calls traced, "
+         << (double) traceBytes / traced << " bytes each)" << endl;
+
+    // Replaying the trace and checking every call ends the way it did when it was recorded
+    TraceReplayer replayer(tracePath);
+    replayer.load();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<TraceOpStats> stats = replayer.replay(false);
+    double replaySeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    uint64_t errors = 0, mismatches = 0;
+    for (size_t op = 0; op < stats.size(); op++) {
+
+        errors += stats[op].errors;
+        mismatches += stats[op].mismatches;
+
+    }
+    cout << "\tReplay: " << replaySeconds * 1e9 / replayer.getCallCount() << " ns per call, " << errors << " errors, "
+         << mismatches << " outcome mismatches" << endl;
+    remove(tracePath.c_str());
+
+}
+
+
+// Function to measure the memory and query time of the availability history over a simulated semester
+//  The answers are checked against a plain list of (time, available copies) per title
+void runHistoryBenchmark() {
+
+    // Declaring necessary variables
+    const int titleCount = 10000;
+    const int copies = 3;
+    const int changeCount = 2000000;
+    const int queryCount = 100000;
+    const int64_t semesterStart = 1755000000;
+    const int64_t semesterLength = 120 * 24 * 3600;
+    AvailabilityHistory history;
+    vector< vector< pair<int64_t, int> > > plain(titleCount);
+    vector<int> available(titleCount, copies);
+    vector<string> keys;
+    mt19937 random(11);
+
+    // Adding every title, then borrowing and returning copies at random times through the semester
+    for (int i = 0; i < titleCount; i++) {
+
+        keys.push_back("1\x1ftitle " + to_string(i) + "\x1f" + "author " + to_string(i % 300));
+        history.record(keys[i], semesterStart, copies, copies);
+        plain[i].push_back(make_pair(semesterStart, copies));
+
+    }
+    int64_t now = semesterStart;
+    for (int i = 0; i < changeCount; i++) {
+
+        now += (int64_t) (random() % (2 * semesterLength / changeCount + 1));
+        int title = (int) (random() % titleCount);
+        int change = (available[title] == 0 || (available[title] < copies && random() % 2 == 0)) ? 1 : -1;
+        available[title] += change;
+        history.record(keys[title], now, change, 0);
+        plain[title].push_back(make_pair(now, available[title]));
+
+    }
+    size_t plainBytes = 0;
+    for (int i = 0; i < titleCount; i++) {
+
+        plainBytes += plain[i].capacity() * sizeof(pair<int64_t, int>);
+
+    }
+
+    cout << "\nAvailability history of " << titleCount << " titles (" << copies << " copies each) with "
+         << history.size() << " changes over " << semesterLength / 86400 << " days:\n" << endl;
+    cout << "\tDelta encoded blocks: " << history.memoryUsage() << " bytes ("
+         << (double) history.memoryUsage() / history.size() << " bytes per change)" << endl;
+    cout << "\tPlain (time, count) pairs: " << plainBytes << " bytes (" << (double) plainBytes / history.size()
+         << " bytes per change)" << endl;
+
+    // Point in time queries
+    vector<int> titles(queryCount);
+    vector<int64_t> times(queryCount);
+    for (int i = 0; i < queryCount; i++) {
+
+        titles[i] = (int) (random() % titleCount);
+        times[i] = semesterStart + (int64_t) (random() % semesterLength);
+
+    }
+    size_t mismatches = 0;
+    long long total = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < queryCount; i++) {
+
+        total += history.availableAt(keys[titles[i]], times[i]);
+
+    }
+    double nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / queryCount;
+    for (int i = 0; i < queryCount; i++) {
+
+        vector< pair<int64_t, int> >& p = plain[titles[i]];
+        vector< pair<int64_t, int> >::iterator after = upper_bound(p.begin(), p.end(), make_pair(times[i], INT32_MAX));
+        int expected = (after == p.begin()) ? 0 : (after - 1)->second;
+        mismatches += (history.availableAt(keys[titles[i]], times[i]) != expected);
+
+    }
+    cout << "\tPoint in time query: " << nanos << " ns (" << mismatches << " mismatches in " << queryCount << ")" << endl;
+
+    // Week long window queries
+    double peak = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < queryCount / 10; i++) {
+
+        AvailabilityWindow w = history.window(keys[titles[i]], times[i], times[i] + 7 * 86400);
+        peak = max(peak, w.peakUtilization);
+
+    }
+    nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (queryCount / 10);
+    cout << "\tOne week window query: " << nanos << " ns (peak utilization " << peak << ", " << total << ")" << endl;
+
+}
+
+
+// Function to measure how a reader dumping the whole catalog affects the latency of a writer borrowing and returning
+//  books, when the reader locks the library and when it reads a snapshot instead
+void runSnapshotBenchmark() {
+
+    // Stream buffer that throws away the dumps
+    struct NullBuffer : public streambuf {
+        int overflow(int c) {
+            return c;
+        }
+    };
+
+    // Declaring necessary variables
+    const int bookCount = 100000;
+    const int dumpCount = 10;
+    vector<Textbook*> books;
+    for (int i = 0; i < bookCount; i++) {
+
+        books.push_back(new Textbook("Title " + to_string(i), "Author " + to_string(i % 500), i, "Genre", "Course", "1st"));
+
+    }
+    Library library;
+    for (int i = 0; i < bookCount; i++) {
+
+        library.addBook(books[i]);
+
+    }
+    library.setShowMessages(false);
+    library.setSearchCacheSize(0);
+    library.enableSnapshots(true);
+    mutex libraryLock;
+    NullBuffer nullBuffer;
+    streambuf* console = cout.rdbuf();
+
+    cout << "\nWriter latency (microseconds per borrow or return) in a library of " << bookCount
+         << " Textbooks while a reader dumps the catalog " << dumpCount << " times:\n" << endl;
+    const char* modes[] = {"No reader", "Reader locks the library", "Reader uses snapshots"};
+    for (int mode = 0; mode < 3; mode++) {
+
+        atomic<bool> done(false);
+        atomic<int> tornDumps(0);
+        vector<double> latencies;
+        double dumpMillis = 0;
+
+        // Writer: borrowing and returning random books until the reader is done (or 2000 operations without one)
+        thread writer([&] {
+
+            mt19937 random(3);
+            while (mode == 0 ? latencies.size() < 2000 : !done.load()) {
+
+                int book = (int) (random() % bookCount);
+                for (int choice = 1; choice <= 2; choice++) {
+
+                    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                    {
+                        lock_guard<mutex> lock(libraryLock);
+                        library.borrowOrReturn(books[book]->getTitle(), books[book]->getAuthor(), 1, choice);
+                    }
+                    latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+
+                }
+
+            }
+
+        });
+
+        // Reader: dumping the catalog, either under the lock or from a snapshot that is checked for torn state
+        if (mode != 0) {
+
+            this_thread::sleep_for(chrono::milliseconds(20));
+            cout.rdbuf(&nullBuffer);
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (int d = 0; d < dumpCount; d++) {
+
+                if (mode == 1) {
+
+                    lock_guard<mutex> lock(libraryLock);
+                    library.displayBooks();
+
+                } else {
+
+                    CatalogSnapshot snapshot = library.snapshot();
+                    snapshot.displayBooks();
+                    int available = 0;
+                    snapshot.forEachBook(1, [&available](const BookRecord&, bool isAvailable) {
+
+                        available += isAvailable ? 1 : 0;
+
+                    });
+                    if (available != snapshot.getTypeCounts(1).available) {
+
+                        tornDumps++;
+
+                    }
+
+                }
+
+            }
+            dumpMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / dumpCount;
+            cout.rdbuf(console);
+            done.store(true);
+
+        }
+        writer.join();
+
+        sort(latencies.begin(), latencies.end());
+        cout << "\t" << modes[mode] << ": " << latencies.size() << " operations, median " << latencies[latencies.size() / 2]
+             << ", p99 " << latencies[latencies.size() * 99 / 100] << ", max " << latencies.back();
+        if (mode != 0) {
+
+            cout << "; " << dumpMillis << " ms per dump";
+
+        }
+        if (mode == 2) {
+
+            cout << ", " << tornDumps.load() << " torn dumps";
+
+        }
+        cout << endl;
+
+    }
+
+    library.enableSnapshots(false);
+    for (int i = 0; i < bookCount; i++) {
+
+        delete books[i];
+
+    }
+
+}
+
+
+// Function to measure how a batch of lookups scales with the number of threads of a BatchQueryExecutor
+//  The batch mixes ISBN checks, title and author checks (half of them for books the library doesn't have), and
+//  title searches, like a nightly reconciliation run
+void runBatchQueryBenchmark() {
+
+    // Declaring necessary variables
+    const int bookCount = 50000;
+    const int queryCount = 20000;
+    vector<Textbook*> books;
+    for (int i = 0; i < bookCount; i++) {
+
+        books.push_back(new Textbook("Title " + to_string(i % 40000), "Author " + to_string(i % 40000 % 700), i, "Genre", "Course", "1st"));
+
+    }
+    Library library;
+    for (int i = 0; i < bookCount; i++) {
+
+        library.addBook(books[i]);
+
+    }
+
+    // Building the batch
+    vector<BatchQuery> queries;
+    mt19937 random(7);
+    for (int i = 0; i < queryCount; i++) {
+
+        BatchQuery query;
+        int book = (int) (random() % bookCount);
+        query.queryChoice = (i % 10 < 6) ? 1 : (i % 10 < 9) ? 2 : 3;
+        query.bookType = 1;
+        query.isbn = (i % 2 == 0) ? book : bookCount + book;
+        query.title = (i % 2 == 0) ? books[book]->getTitle() : "Missing Title " + to_string(book);
+        query.author = books[book]->getAuthor();
+        queries.push_back(query);
+
+    }
+
+    // Running the batch one query at a time as the baseline
+    size_t matches = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < queries.size(); i++) {
+
+        matches += library.lookup(queries[i]).size();
+
+    }
+    double baseline = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    cout << "\n" << queryCount << " queries against " << bookCount << " Textbooks (" << thread::hardware_concurrency()
+         << " hardware threads):\n" << endl;
+    cout << "\tOne at a time: " << baseline << " ms (" << matches << " matching copies)" << endl;
+    size_t threadCounts[] = {1, 2, 4, 8};
+    for (int t = 0; t < 4; t++) {
+
+        BatchQueryExecutor executor(threadCounts[t]);
+        start = chrono::steady_clock::now();
+        vector< vector<Book*> > results = executor.execute(library, queries);
+        double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        size_t batchMatches = 0;
+        for (size_t i = 0; i < results.size(); i++) {
+
+            batchMatches += results[i].size();
+
+        }
+        cout << "\t" << threadCounts[t] << " thread(s): " << millis << " ms, " << (baseline / millis) << "x, "
+             << executor.getStealCount() << " steals (" << batchMatches << " matching copies)" << endl;
+
+    }
+
+    for (int i = 0; i < bookCount; i++) {
+
+        delete books[i];
+
+    }
+
+}
+
+
+// Function to compare the latency of borrowing and returning several books as one batch with one call per book
+//  The library writes a mutation log, as a leader would, so each call also pays for its log record
+void runBatchBenchmark() {
+
+    // Declaring necessary variables
+    const int bookCount = 20000;
+    const int rounds = 200;
+    const char* logPath = "batch-benchmark.log";
+    vector<Textbook*> books;
+    for (int i = 0; i < bookCount; i++) {
+
+        books.push_back(new Textbook("Title " + to_string(i), "Author " + to_string(i % 500), i, "Genre", "Course", "1st"));
+
+    }
+    Library library;
+    for (int i = 0; i < bookCount; i++) {
+
+        library.addBook(books[i]);
+
+    }
+    library.registerPatron(1, 1000);
+    library.setShowMessages(false);
+    MutationLog log(logPath, 1);
+    library.attachMutationLog(&log);
+    mt19937 random(42);
+
+    cout << "\nBorrowing and returning books for one patron in a library of " << bookCount << " Textbooks ("
+         << rounds << " rounds, microseconds per batch):\n" << endl;
+    int batchSizes[] = {1, 2, 6, 16};
+    for (int s = 0; s < 4; s++) {
+
+        // Latencies per round: individual borrows, individual returns, batch borrow, batch return
+        vector<double> latencies[4];
+        for (int r = 0; r < rounds; r++) {
+
+            // Picking distinct titles for this round
+            vector<BatchItem> items;
+            while ((int) items.size() < batchSizes[s]) {
+
+                BatchItem item;
+                int book = (int) (random() % bookCount);
+                item.bookType = 1;
+                item.title = books[book]->getTitle();
+                item.author = books[book]->getAuthor();
+                bool seen = false;
+                for (size_t i = 0; i < items.size(); i++) {
+
+                    seen = seen || (items[i].title == item.title);
+
+                }
+                if (!seen) {
+
+                    items.push_back(item);
+
+                }
+
+            }
+
+            // One call per book
+            for (int choice = 1; choice <= 2; choice++) {
+
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                for (size_t i = 0; i < items.size(); i++) {
+
+                    library.borrowOrReturn(items[i].title, items[i].author, 1, choice, 1);
+
+                }
+                latencies[choice - 1].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+
+            }
+
+            // One batch
+            for (int choice = 1; choice <= 2; choice++) {
+
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                library.borrowOrReturnBatch(items, choice, 1);
+                latencies[choice + 1].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+
+            }
+
+        }
+
+        // Reporting the median and 99th percentile of each
+        const char* names[] = {"individual borrows", "individual returns", "batch borrow", "batch return"};
+        cout << "\t" << batchSizes[s] << " book(s):" << endl;
+        for (int k = 0; k < 4; k++) {
+
+            sort(latencies[k].begin(), latencies[k].end());
+            cout << "\t\t" << names[k] << ": median " << latencies[k][latencies[k].size() / 2] << ", p99 "
+                 << latencies[k][latencies[k].size() * 99 / 100] << endl;
+
+        }
+
+    }
+
+    library.attachMutationLog(nullptr);
+    remove(logPath);
+    for (int i = 0; i < bookCount; i++) {
+
+        delete books[i];
+
+    }
+
+}
+
+
+// Function to ask which type of book the menu should act on, listing every type in BOOK_TYPES (and any type as the
+// last choice if it is allowed) until a valid choice is made; returns the type tag, or 0 for any type
+int chooseBookType(string question, bool allowAnyType) {
+
+    // Declaring necessary variables
+    int choice = 0, choices = BOOK_TYPE_COUNT - 1 + (allowAnyType ? 1 : 0);
+
+    // Loop to choose a type
+    do {
+
+        cout << "\n" << question << endl;
+        for (int bookType = 1; bookType < BOOK_TYPE_COUNT; bookType++) {
+
+            cout << "\t" << bookType << ". " << BOOK_TYPES[bookType].name << endl;
+
+        }
+        if (allowAnyType) {
+
+            cout << "\t" << BOOK_TYPE_COUNT << ". Any type" << endl;
+
+        }
+        cout << "Selection: ";
+        cin >> choice;
+
+        // Try again if invalid input
+        if (choice < 1 || choice > choices) {
+            cout << "\nERROR: Invalid choice; please try again." << endl;
+        }
+
+    } while (choice < 1 || choice > choices);
+
+    // Any type is searched as book type 0
+    return (choice == BOOK_TYPE_COUNT) ? 0 : choice;
+
+}
+
+
+// Function to run the read-only menu of a follower; the leader's log is polled before every choice. Returns 1 if the
+// log is of another format version, 0 otherwise
+int runFollowerMenu(string logPath) {
+
+    // Creating the replica and the follower that keeps it up to date
+    Library replica;
+    replica.setShowMessages(false);
+    LogFollower follower(logPath, &replica);
+    follower.poll();
+    if (!follower.isCompatible()) {
+
+        cout << "ERROR: " << logPath << " is not a version " << MutationLog::FORMAT_VERSION << " log and can't be replayed." << endl;
+        return 1;
+
+    }
+    // Declaring necessary variables for the user's choices
+    int choice, bookType, searchChoice;
+    string title, author;
+
+    cout << "Welcome to the Broward College Library (read-only replica)! What would you like to do today?\n" << endl;
+    // Loop for menu
+    do {
+
+        // Displaying menu
+        cout << "Please pick a number." << endl;
+        cout << "\t1. Search for a Book" << endl;
+        cout << "\t2. Display all Books" << endl;
+        cout << "\t3. Display Catalog Statistics" << endl;
+        cout << "\t4. Display Replication Status" << endl;
+        cout << "\t5. Leave" << endl;
+        cout << "Selection: ";
+        cin >> choice;
+
+        // Catching up with the leader before answering
+        follower.poll();
+
+        // Switch statement for menu choices
+        switch (choice) {
+
+            // If user chooses to search for a book...
+            case 1: {
+
+                // Choosing the type of book to search for, or any type
+                bookType = chooseBookType("What type of book would you like to search for?", true);
+
+                // Loop to choose between searching by title or author
+                do {
+
+                    cout << "\nWould you like to search by title or author?" << endl;
+                    cout << "\t1. Title" << endl;
+                    cout << "\t2. Author" << endl;
+                    cout << "Selection: ";
+                    cin >> searchChoice;
+
+                    // Try again if invalid input
+                    if (searchChoice != 1 && searchChoice != 2) {
+                        cout << "\nERROR: Invalid choice; please try again." << endl;
+                    }
+
+                } while (searchChoice != 1 && searchChoice != 2);
+
+                // Getting title or author from user depending on choice
+                cin.ignore();
+                title = "";
+                author = "";
+                if (searchChoice == 1) {
+
+                    cout << "\nWhat is the title of the book?" << endl;
+                    getline(cin, title);
+
+                } else {
+
+                    cout << "\nWhat is the author of the book?" << endl;
+                    getline(cin, author);
+
+                }
+
+                // Searching for book and displaying details
+                try {
+
+                    replica.bookSearch(title, author, bookType, searchChoice);
+
+                }
+                // Catching exception for book not being found
+                catch (Library::bookNotFoundError) {
+
+                    cout << "\nERROR: Book was not found.\n" << endl;
+
+                }
+
+                break;
+            }
+
+            // If user chooses to display all books...
+            case 2: {
+
+                replica.displayBooks();
+
+                break;
+            }
+
+            // If user chooses to display catalog statistics...
+            case 3: {
+
+                replica.displayCatalogStats();
+
+                break;
+            }
+
+            // If user chooses to display the replication status...
+            case 4: {
+
+                ReplicationLag lag = follower.getLag();
+                cout << "\nApplied up to change #" << lag.appliedSequence << "; the last change was applied "
+                     << lag.lagMicros << " microseconds after the leader made it." << endl;
+                cout << lag.bytesBehind << " byte(s) of the log have not been applied yet; " << lag.applyErrors
+                     << " change(s) could not be applied.\n" << endl;
+
+                break;
+            }
+
+            // If user chooses to leave, then end loop and quit program
+            case 5: {
+
+                cout << "\nGoodbye!" << endl;
+
+                break;
+            }
+
+            // If user choice is invalid, display error and try again
+            default: {
+
+                cout << "\nERROR: Invalid choice; please try again.\n" << endl;
+
+                break;
+            }
+
+        }
+
+    // End loop if user choice is to leave
+    } while (choice != 5);
+
+    return 0;
+
+}
+
+
+// Main function
+int main(int argc, char* argv[]) {
+
+    // Running a benchmark instead of the menu if one was asked for on the command line
+    if (argc > 1 && string(argv[1]) == "--bench-shards") {
+
+        runShardScalingBenchmark();
+        return 0;
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-dictionary") {
+
+        runDictionaryBenchmark();
+        return 0;
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-bloom") {
+
+        runBloomFilterBenchmark();
+        return 0;
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-hot-cold") {
+
+        runHotColdBenchmark();
+        return 0;
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-isbn") {
+
+        runISBNBenchmark();
+        return 0;
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-recommend") {
+
+        runRecommendationBenchmark();
+        return 0;
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-facets") {
+
+        runFacetBenchmark();
+        return 0;
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-any-type") {
+
+        runAnyTypeBenchmark();
+        return 0;
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-export") {
+
+        runExportBenchmark();
+        return 0;
+
+    }
+    if (argc > 4 && string(argv[1]) == "--export") {
+
+        return runExport(argv[2], argv[3], argv[4], (argc > 5) ? (size_t) max(1, atoi(argv[5])) : 1);
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-trace") {
+
+        runTraceBenchmark();
+        return 0;
+
+    }
+    if (argc > 2 && string(argv[1]) == "--replay") {
+
+        return runTraceReplay(argv[2], argc > 3 && string(argv[3]) == "--original-speed");
+
+    }
+    if (argc > 1 && string(argv[1]) == "--memory-report") {
+
+        return runMemoryReport((argc > 2) ? max(1, atoi(argv[2])) : 100000);
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-history") {
+
+        runHistoryBenchmark();
+        return 0;
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-snapshot") {
+
+        runSnapshotBenchmark();
+        return 0;
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-queries") {
+
+        runBatchQueryBenchmark();
+        return 0;
+
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-batch") {
+
+        runBatchBenchmark();
+        return 0;
 
-                    }
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-normalize") {
 
-                    // If book available, update availability and comfirm success
-                    if (tempAvailability) {
+        runNormalizationBenchmark();
+        return 0;
 
-                        fictionBookSection[tempIndex]->updateAvailability(false);
-                        cout << "\nThe book has been borrowed successfully!\n" << endl;
+    }
 
-                    // Otherwise, throw error (cannot borrow book)
-                    } else {
+    // Running as a read-only follower if one was asked for on the command line
+    if (argc > 2 && string(argv[1]) == "--follower") {
 
-                        throw bookNotBorrowableError();
+        return runFollowerMenu(argv[2]);
 
-                    }
+    }
+    
+    // Creating the library
+    Library BC_Lib;
+    MutationLog* leaderLog = nullptr;
 
-                // If we are returning a book...
-                } else if (borrowOrReturnChoice == 2) {
-                    
-                    // Loop to look through book matches/duplicates for an available one to return
-                    for (int i = 0; i < matchingBookIndexes.size(); i++) {
-                        
-                        // Checking if one of the matches/duplicates is not available
-                        tempIndex = matchingBookIndexes[i];
-                        tempAvailability = fictionBookSection[tempIndex]->getAvailability();
-                        
-                        // If it is not, stop loop early to return only that duplicate
-                        if (!tempAvailability) {
+    // Running as the leader if one was asked for on the command line
+    //  The existing log is replayed first so the library starts where the last leader left off
+    if (argc > 2 && string(argv[1]) == "--leader") {
 
-                            break;
+        LogFollower catchUp(argv[2], &BC_Lib);
+        BC_Lib.setShowMessages(false);
+        catchUp.poll();
+        BC_Lib.setShowMessages(true);
+        if (!catchUp.isCompatible()) {
 
-                        }
+            cout << "ERROR: " << argv[2] << " is not a version " << MutationLog::FORMAT_VERSION << " log, so it can't be replayed or appended to." << endl;
+            return 1;
 
-                    }
+        }
 
-                    // If book is not available, update availability and comfirm success
-                    if (!tempAvailability) {
+        leaderLog = new MutationLog(argv[2], catchUp.getLag().appliedSequence + 1);
+        if (!leaderLog->isOpen()) {
 
-                        fictionBookSection[tempIndex]->updateAvailability(true);
-                        cout << "\nThe book has been returned successfully!\n" << endl;
+            cout << "ERROR: The log " << argv[2] << " could not be opened." << endl;
+            delete leaderLog;
+            return 1;
 
-                    // Otherwise, throw error (cannot return book)
-                    } else {
+        }
+        BC_Lib.attachMutationLog(leaderLog);
 
-                        throw bookNotReturnableError();
+    }
 
-                    }
+    // Tracing every call the menu makes if it was asked for on the command line
+    TraceRecorder* traceRecorder = nullptr;
+    if (argc > 2 && string(argv[1]) == "--trace") {
 
-                }
+        traceRecorder = new TraceRecorder(argv[2]);
+        if (!traceRecorder->isOpen()) {
 
-            }
+            cout << "ERROR: The trace " << argv[2] << " could not be opened." << endl;
+            delete traceRecorder;
+            return 1;
 
         }
+        BC_Lib.attachTraceRecorder(traceRecorder);
 
-};
-
+    }
 
-// Main function
-int main() {
-    
-    // Creating the library
-    Library BC_Lib;
     // Declaring necessary variables for the user's choices
-    int choice, bookType, searchChoice, borrowOrReturnChoice;
-    string title, author, genre, course, edition, mainCharacter, setting;
-    int isbn;
-    // Declaring pointer variables to store pointers of created objects
-    Textbook* txtPtr = nullptr;
-    FictionBook* ficPtr = nullptr;
+    int choice, bookType, searchChoice, borrowOrReturnChoice, patronChoice, maxLoans;
+    string title, author, genre, field1, field2, isbnText;
+    uint64_t isbn;
+    int patronID;
+    // Declaring a pointer variable to store pointers of created objects
+    Book* bookPtr = nullptr;
 
     cout << "Welcome to the Broward College Library! What would you like to do today?\n" << endl;
     // Loop for menu
@@ -777,7 +12651,10 @@ int main() {
         cout << "\t4. Display all Books" << endl;
         cout << "\t5. Borrow a Book" << endl;
         cout << "\t6. Return a Book" << endl;
-        cout << "\t7. Leave" << endl;
+        cout << "\t7. Place a Hold on a Book" << endl;
+        cout << "\t8. Patron Services" << endl;
+        cout << "\t9. Display Catalog Statistics" << endl;
+        cout << "\t10. Leave" << endl;
         cout << "Selection: ";
         cin >> choice;
         
@@ -787,21 +12664,8 @@ int main() {
             // If user chooses to add a book...
             case 1: {
                 
-                // Loop to choose between adding a Textbook or Fiction Book
-                do {
-                    
-                    cout << "\nWhat type of book would you like to add?" << endl;
-                    cout << "\t1. Textbook" << endl;
-                    cout << "\t2. Fiction Book" << endl;
-                    cout << "Selection: ";
-                    cin >> bookType;
-
-                    // Try again if invalid input
-                    if (bookType != 1 && bookType != 2) {
-                        cout << "\nERROR: Invalid choice; please try again." << endl;
-                    }
-
-                } while (bookType != 1 && bookType != 2);
+                // Choosing the type of book to add
+                bookType = chooseBookType("What type of book would you like to add?", false);
 
                 // User picks book details
                 cout << "\nTitle: ";
@@ -809,88 +12673,45 @@ int main() {
                 getline(cin, title);
                 cout << "Author: ";
                 getline(cin, author);
-                cout << "ISBN (enter an integer): ";
-                cin >> isbn;
-                cout << "Genre: ";
-                cin.ignore();
-                getline(cin, genre);
-
-                // User continues picking book details based on book type, and then the respective object is created
-                // For Textbook:
-                if (bookType == 1) {
-                    
-                    cout << "\nCourse: ";
-                    getline(cin, course);
-                    cout << "Edition: ";
-                    getline(cin, edition);
-
-                    // Creating new textbook object and adding it to the library
-                    try {
-                        
-                        txtPtr = new Textbook(title, author, isbn, genre, course, edition);
-                        BC_Lib.addBook(txtPtr);
-                        txtPtr = nullptr;
-                        cout << "\nThe book has been added successfully!\n" << endl;
+                cout << "ISBN (ISBN-10 or ISBN-13): ";
+                getline(cin, isbnText);
+                // Rejecting ISBNs with the wrong number of digits or the wrong check digit
+                if (!parseISBN(isbnText, isbn)) {
 
-                    }
-                    // Catching empty string, negative ISBN, and duplicate ISBN exceptions
-                    catch (Textbook::emptyStringError) {
+                    cout << "\nERROR: " << isbnText << " is not a valid ISBN-10 or ISBN-13." << endl;
+                    cout << "The book has not been added.\n" << endl;
+                    continue;
 
-                        cout << "\nERROR: Empty title, author, genre, course, or edition is invalid." << endl;
-                        cout << "The book has not been added.\n" << endl;
+                }
+                cout << "Genre: ";
+                getline(cin, genre);
 
-                    }
-                    catch (Textbook::negativeISBNerror) {
+                // User continues picking the details of the book's type, and then the book is created and added
+                cout << "\n" << BOOK_TYPES[bookType].field1Prompt << ": ";
+                getline(cin, field1);
+                cout << BOOK_TYPES[bookType].field2Prompt << ": ";
+                getline(cin, field2);
+                try {
 
-                        cout << "\nERROR: Negative ISBN is invalid." << endl;
-                        cout << "The book has not been added.\n" << endl;
+                    bookPtr = createBook(bookType, title, author, isbn, genre, field1, field2);
+                    BC_Lib.addBook(bookPtr);
+                    bookPtr = nullptr;
+                    cout << "\nThe book has been added successfully!\n" << endl;
 
-                    }
-                    catch (Library::duplicateISBN) {
-                        
-                        delete txtPtr;
-                        txtPtr = nullptr;
-                        cout << "\nERROR: Books that aren't the same book cannot have the same ISBN.\n" << endl;
+                }
+                // Catching empty string and duplicate ISBN exceptions (the ISBN itself was checked as it was read)
+                catch (Book::emptyStringError) {
 
-                    }
+                    cout << "\nERROR: Empty title, author, genre, " << normalizeKey(BOOK_TYPES[bookType].field1Prompt) << ", or "
+                         << normalizeKey(BOOK_TYPES[bookType].field2Prompt) << " is invalid." << endl;
+                    cout << "The book has not been added.\n" << endl;
 
-                // For Fiction Book:
-                } else if (bookType == 2) {
+                }
+                catch (Library::duplicateISBN) {
                     
-                    cout << "\nMain Character: ";
-                    getline(cin, mainCharacter);
-                    cout << "Setting: ";
-                    getline(cin, setting);
-
-                    // Creating new fiction book object and adding it to the library
-                    try {
-
-                        ficPtr = new FictionBook(title, author, isbn, genre, mainCharacter, setting);
-                        BC_Lib.addBook(ficPtr);
-                        ficPtr = nullptr;
-                        cout << "\nThe book has been added successfully!\n" << endl;
-
-                    }
-                    // Catching empty string, negative ISBN, and duplicate ISBN exceptions
-                    catch (FictionBook::emptyStringError) {
-
-                        cout << "\nERROR: Empty title, author, genre, main character, or setting is invalid." << endl;
-                        cout << "The book has not been added.\n" << endl;
-
-                    }
-                    catch (FictionBook::negativeISBNerror) {
-
-                        cout << "\nERROR: Negative ISBN is invalid." << endl;
-                        cout << "The book has not been added.\n" << endl;
-
-                    }
-                    catch (Library::duplicateISBN) {
-                        
-                        delete ficPtr;
-                        ficPtr = nullptr;
-                        cout << "\nERROR: Books that aren't the same book cannot have the same ISBN.\n" << endl;
-
-                    }
+                    delete bookPtr;
+                    bookPtr = nullptr;
+                    cout << "\nERROR: Books that aren't the same book cannot have the same ISBN.\n" << endl;
 
                 }
 
@@ -900,21 +12721,8 @@ int main() {
             // If user chooses to remove a book...
             case 2: {
                 
-                // Loop to choose between removing a Textbook or Fiction Book
-                do {
-                    
-                    cout << "\nWhat type of book would you like to remove?" << endl;
-                    cout << "\t1. Textbook" << endl;
-                    cout << "\t2. Fiction Book" << endl;
-                    cout << "Selection: ";
-                    cin >> bookType;
-
-                    // Try again if invalid input
-                    if (bookType != 1 && bookType != 2) {
-                        cout << "\nERROR: Invalid choice; please try again." << endl;
-                    }
-
-                } while (bookType != 1 && bookType != 2);
+                // Choosing the type of book to remove
+                bookType = chooseBookType("What type of book would you like to remove?", false);
 
                 // Getting title and author of book to find it
                 cout << "\nWhat is the title of the book?" << endl;
@@ -923,43 +12731,19 @@ int main() {
                 cout << "\nWhat is the author of the book?" << endl;
                 getline(cin, author);
 
-                // For Textbook:
-                if (bookType == 1) {
+                // The book is searched for and removed from the library; the object is also deleted
+                try {
                     
-                    // Textbook is searched for and removed from the library; the object is also deleted
-                    try {
-                        
-                        txtPtr = BC_Lib.removeTextbook(title, author);
-                        delete txtPtr;
-                        txtPtr = nullptr;
-                        cout << "\nThe book was successfully removed!\n" << endl;
-
-                    }
-                    // Catching exception for book not being found
-                    catch (Library::bookNotFoundError) {
-
-                        cout << "\nERROR: Book was not found.\n" << endl;
-
-                    }
-                
-                // For Fiction Book:
-                } else if (bookType == 2) {
+                    bookPtr = BC_Lib.removeBook(bookType, title, author);
+                    delete bookPtr;
+                    bookPtr = nullptr;
+                    cout << "\nThe book was successfully removed!\n" << endl;
 
-                    // Fiction Book is searched for and removed from the library; the object is also deleted
-                    try {
-
-                        ficPtr = BC_Lib.removeFictionBook(title, author);
-                        delete ficPtr;
-                        ficPtr = nullptr;
-                        cout << "\nThe book was successfully removed!\n" << endl;
-
-                    }
-                    // Catching exception for book not being found
-                    catch (Library::bookNotFoundError) {
-
-                        cout << "\nERROR: Book was not found.\n" << endl;
+                }
+                // Catching exception for book not being found
+                catch (Library::bookNotFoundError) {
 
-                    }
+                    cout << "\nERROR: Book was not found.\n" << endl;
 
                 }
                 
@@ -969,40 +12753,64 @@ int main() {
             // If user chooses to search for a book...
             case 3: {
                 
-                // Loop to choose between searching for a Textbook or Fiction Book
-                do {
-                    
-                    cout << "\nWhat type of book would you like to search for?" << endl;
-                    cout << "\t1. Textbook" << endl;
-                    cout << "\t2. Fiction Book" << endl;
-                    cout << "Selection: ";
-                    cin >> bookType;
-
-                    // Try again if invalid input
-                    if (bookType != 1 && bookType != 2) {
-                        cout << "\nERROR: Invalid choice; please try again." << endl;
-                    }
+                // Choosing the type of book to search for, or any type (book type 0)
+                bookType = chooseBookType("What type of book would you like to search for?", true);
+                vector<int> facetFields = getFacetFields(bookType);
 
-                } while (bookType != 1 && bookType != 2);
-
-                // Loop to choose between searching by title or author
+                // Loop to choose between searching by title, author, or facets
                 do {
                     
-                    cout << "\nWould you like to search by title or author?" << endl;
+                    cout << "\nWould you like to search by title, author, or facets?" << endl;
                     cout << "\t1. Title" << endl;
                     cout << "\t2. Author" << endl;
+                    cout << "\t3. ";
+                    for (size_t f = 0; f < facetFields.size(); f++) {
+
+                        cout << (f == 0 ? string(FACET_FIELD_NAMES[facetFields[f]]) : normalizeKey(FACET_FIELD_NAMES[facetFields[f]])) << ", ";
+
+                    }
+                    cout << "and availability" << endl;
                     cout << "Selection: ";
                     cin >> searchChoice;
 
                     // Try again if invalid input
-                    if (searchChoice != 1 && searchChoice != 2) {
+                    if (searchChoice < 1 || searchChoice > 3) {
                         cout << "\nERROR: Invalid choice; please try again." << endl;
                     }
 
-                } while (searchChoice != 1 && searchChoice != 2);
+                } while (searchChoice < 1 || searchChoice > 3);
                 
                 // Getting title or author from user depending on choice
                 cin.ignore();
+                if (searchChoice == 3) {
+
+                    // Narrowing the books of the type by each facet given (a blank answer matches any value)
+                    FacetFilter filter = facetType(bookType);
+                    for (size_t f = 0; f < facetFields.size(); f++) {
+
+                        string answer;
+                        cout << "\nWhat " << normalizeKey(FACET_FIELD_NAMES[facetFields[f]]) << " are you looking for? (leave blank for any)" << endl;
+                        getline(cin, answer);
+                        if (!normalizeKey(answer).empty()) {
+
+                            filter = facetAnd(filter, facetTerm(facetFields[f], answer));
+
+                        }
+
+                    }
+                    cout << "\nOnly available copies? (y/n)" << endl;
+                    string onlyAvailable;
+                    getline(cin, onlyAvailable);
+                    if (onlyAvailable == "y" || onlyAvailable == "Y") {
+
+                        filter = facetAnd(filter, facetAvailable());
+
+                    }
+
+                    BC_Lib.displayFilteredBooks(filter, 20);
+                    break;
+
+                }
                 if (searchChoice == 1) {
 
                     cout << "\nWhat is the title of the book?" << endl;
@@ -1048,21 +12856,8 @@ int main() {
                 // User picked to borrow book, so we set variable accordingly
                 borrowOrReturnChoice = 1;
 
-                // Loop to choose between borrwing a Textbook or Fiction Book
-                do {
-                    
-                    cout << "\nWhat type of book would you like to borrow?" << endl;
-                    cout << "\t1. Textbook" << endl;
-                    cout << "\t2. Fiction Book" << endl;
-                    cout << "Selection: ";
-                    cin >> bookType;
-
-                    // Try again if invalid input
-                    if (bookType != 1 && bookType != 2) {
-                        cout << "\nERROR: Invalid choice; please try again." << endl;
-                    }
-
-                } while (bookType != 1 && bookType != 2);
+                // Choosing the type of book to borrow
+                bookType = chooseBookType("What type of book would you like to borrow?", false);
 
                 // Getting title and author of book to borrow it
                 cout << "\nWhat is the title of the book?" << endl;
@@ -1070,11 +12865,15 @@ int main() {
                 getline(cin, title);
                 cout << "\nWhat is the author of the book?" << endl;
                 getline(cin, author);
+                // Getting the library card number so a copy held for the patron can be picked up
+                cout << "\nWhat is your library card number? (enter 0 if you don't have one)" << endl;
+                cin >> patronID;
 
                 // Borrowing book
                 try {
                     
-                    BC_Lib.borrowOrReturn(title, author, bookType, borrowOrReturnChoice);
+                    BC_Lib.borrowOrReturn(title, author, bookType, borrowOrReturnChoice, patronID);
+                    BC_Lib.displayRecommendations(title, author, bookType, 5);
 
                 }
                 // Catching book not found and book not available to be borrowed errors
@@ -1085,7 +12884,18 @@ int main() {
                 }
                 catch (Library::bookNotBorrowableError) {
 
-                    cout << "\nERROR: This book is not available at this time.\n" << endl;
+                    cout << "\nERROR: This book is not available at this time." << endl;
+                    cout << "You can place a hold on it to get the next copy that is returned.\n" << endl;
+
+                }
+                catch (Library::patronNotFoundError) {
+
+                    cout << "\nERROR: This library card number is not registered.\n" << endl;
+
+                }
+                catch (Library::loanLimitReachedError) {
+
+                    cout << "\nERROR: You already have as many books on loan as you are allowed.\n" << endl;
 
                 }
                 
@@ -1098,21 +12908,8 @@ int main() {
                 // User picked to return book, so we set variable accordingly
                 borrowOrReturnChoice = 2;
 
-                // Loop to choose between return a Textbook or Fiction Book
-                do {
-                    
-                    cout << "\nWhat type of book would you like to return?" << endl;
-                    cout << "\t1. Textbook" << endl;
-                    cout << "\t2. Fiction Book" << endl;
-                    cout << "Selection: ";
-                    cin >> bookType;
-
-                    // Try again if invalid input
-                    if (bookType != 1 && bookType != 2) {
-                        cout << "\nERROR: Invalid choice; please try again." << endl;
-                    }
-
-                } while (bookType != 1 && bookType != 2);
+                // Choosing the type of book to return
+                bookType = chooseBookType("What type of book would you like to return?", false);
 
                 // Getting title and author of book to return it
                 cout << "\nWhat is the title of the book?" << endl;
@@ -1120,11 +12917,14 @@ int main() {
                 getline(cin, title);
                 cout << "\nWhat is the author of the book?" << endl;
                 getline(cin, author);
+                // Getting the library card number the book was borrowed with
+                cout << "\nWhat is your library card number? (enter 0 if you don't have one)" << endl;
+                cin >> patronID;
 
                 // Returning book
                 try {
                     
-                    BC_Lib.borrowOrReturn(title, author, bookType, borrowOrReturnChoice);
+                    BC_Lib.borrowOrReturn(title, author, bookType, borrowOrReturnChoice, patronID);
 
                 }
                 // Catching book not found and book not able to be returned errors
@@ -1138,13 +12938,217 @@ int main() {
                     cout << "\nERROR: This book cannot be returned, as all matches are already present." << endl;
                     cout << "It is likely that this book does not belong to this library.\n" << endl;
 
+                }
+                catch (Library::patronNotFoundError) {
+
+                    cout << "\nERROR: This library card number is not registered.\n" << endl;
+
                 }
                 
                 break;
             }
 
-            // If user chooses to leave, then end loop and quit program
+            // If user chooses to place a hold on a book...
             case 7: {
+
+                // Choosing the type of book to place a hold on
+                bookType = chooseBookType("What type of book would you like to place a hold on?", false);
+
+                // Getting title and author of book, and the patron placing the hold
+                cout << "\nWhat is the title of the book?" << endl;
+                cin.ignore();
+                getline(cin, title);
+                cout << "\nWhat is the author of the book?" << endl;
+                getline(cin, author);
+                cout << "\nWhat is your library card number?" << endl;
+                cin >> patronID;
+
+                // Placing the hold
+                try {
+
+                    size_t position = BC_Lib.placeHold(title, author, bookType, patronID);
+                    cout << "\nThe hold has been placed! You are number " << position << " in line.\n" << endl;
+
+                }
+                // Catching invalid patron, book not found, hold not needed, and duplicate hold errors
+                catch (Library::invalidPatronError) {
+
+                    cout << "\nERROR: A valid library card number is needed to place a hold.\n" << endl;
+
+                }
+                catch (Library::patronNotFoundError) {
+
+                    cout << "\nERROR: This library card number is not registered.\n" << endl;
+
+                }
+                catch (Library::bookNotFoundError) {
+
+                    cout << "\nERROR: Book was not found.\n" << endl;
+
+                }
+                catch (Library::holdNotNeededError) {
+
+                    cout << "\nERROR: A copy of this book is available right now; it can be borrowed instead.\n" << endl;
+
+                }
+                catch (Library::duplicateHoldError) {
+
+                    cout << "\nERROR: You already have a hold on this book.\n" << endl;
+
+                }
+
+                break;
+            }
+
+            // If user chooses patron services...
+            case 8: {
+
+                // Loop to choose between registering a patron, viewing a patron's loans, or borrowing or returning several books
+                do {
+
+                    cout << "\nWhat would you like to do?" << endl;
+                    cout << "\t1. Register a Patron" << endl;
+                    cout << "\t2. View a Patron's Loans" << endl;
+                    cout << "\t3. Borrow or Return Several Books at Once" << endl;
+                    cout << "Selection: ";
+                    cin >> patronChoice;
+
+                    // Try again if invalid input
+                    if (patronChoice < 1 || patronChoice > 3) {
+                        cout << "\nERROR: Invalid choice; please try again." << endl;
+                    }
+
+                } while (patronChoice < 1 || patronChoice > 3);
+
+                cout << "\nWhat is the library card number?" << endl;
+                cin >> patronID;
+
+                // Registering a patron
+                if (patronChoice == 1) {
+
+                    cout << "\nHow many books may this patron borrow at once?" << endl;
+                    cin >> maxLoans;
+
+                    try {
+
+                        BC_Lib.registerPatron(patronID, maxLoans);
+                        cout << "\nThe patron has been registered successfully!\n" << endl;
+
+                    }
+                    // Catching invalid patron and duplicate patron errors
+                    catch (Library::invalidPatronError) {
+
+                        cout << "\nERROR: The library card number and the number of books must be positive.\n" << endl;
+
+                    }
+                    catch (Library::duplicatePatronError) {
+
+                        cout << "\nERROR: This library card number is already registered.\n" << endl;
+
+                    }
+
+                // Viewing a patron's loans
+                } else if (patronChoice == 2) {
+
+                    try {
+
+                        BC_Lib.displayPatronLoans(patronID);
+
+                    }
+                    // Catching exception for patron not being found
+                    catch (Library::patronNotFoundError) {
+
+                        cout << "\nERROR: This library card number is not registered.\n" << endl;
+
+                    }
+
+                // Borrowing or returning several books at once
+                } else if (patronChoice == 3) {
+
+                    // Loop to choose between borrowing and returning
+                    do {
+
+                        cout << "\nWould you like to borrow or return the books?" << endl;
+                        cout << "\t1. Borrow" << endl;
+                        cout << "\t2. Return" << endl;
+                        cout << "Selection: ";
+                        cin >> borrowOrReturnChoice;
+
+                        // Try again if invalid input
+                        if (borrowOrReturnChoice != 1 && borrowOrReturnChoice != 2) {
+                            cout << "\nERROR: Invalid choice; please try again." << endl;
+                        }
+
+                    } while (borrowOrReturnChoice != 1 && borrowOrReturnChoice != 2);
+
+                    int bookCount;
+                    cout << "\nHow many books?" << endl;
+                    cin >> bookCount;
+
+                    // Getting the type, title, and author of each book
+                    vector<BatchItem> items;
+                    for (int i = 0; i < bookCount; i++) {
+
+                        BatchItem item;
+                        item.bookType = chooseBookType("Book " + to_string(i + 1) + " type:", false);
+                        cout << "\nWhat is the title of the book?" << endl;
+                        cin.ignore();
+                        getline(cin, item.title);
+                        cout << "\nWhat is the author of the book?" << endl;
+                        getline(cin, item.author);
+                        items.push_back(item);
+
+                    }
+
+                    // Borrowing or returning every book, or none of them if any one can't be
+                    try {
+
+                        BC_Lib.borrowOrReturnBatch(items, borrowOrReturnChoice, patronID);
+
+                    }
+                    // Catching the same errors as borrowing or returning one book
+                    catch (Library::bookNotFoundError) {
+
+                        cout << "\nERROR: One of the books was not found; none of them were " << (borrowOrReturnChoice == 1 ? "borrowed" : "returned") << ".\n" << endl;
+
+                    }
+                    catch (Library::bookNotBorrowableError) {
+
+                        cout << "\nERROR: One of the books is not available at this time; none of them were borrowed.\n" << endl;
+
+                    }
+                    catch (Library::bookNotReturnableError) {
+
+                        cout << "\nERROR: One of the books cannot be returned; none of them were returned.\n" << endl;
+
+                    }
+                    catch (Library::patronNotFoundError) {
+
+                        cout << "\nERROR: This library card number is not registered.\n" << endl;
+
+                    }
+                    catch (Library::loanLimitReachedError) {
+
+                        cout << "\nERROR: These books would put you over the number of books you are allowed on loan.\n" << endl;
+
+                    }
+
+                }
+
+                break;
+            }
+
+            // If user chooses to display catalog statistics...
+            case 9: {
+
+                // Statistics by type and by each facet field are displayed
+                BC_Lib.displayCatalogStats();
+
+                break;
+            }
+
+            // If user chooses to leave, then end loop and quit program
+            case 10: {
                 
                 cout << "\nGoodbye!" << endl;
                 
@@ -1162,6 +13166,14 @@ int main() {
         }
 
     // End loop if user choice is to leave
-    } while (choice != 7);
+    } while (choice != 10);
+
+    // Closing the log if this was the leader
+    BC_Lib.attachMutationLog(nullptr);
+    delete leaderLog;
+
+    // Writing the rest of the trace if calls were traced
+    BC_Lib.attachTraceRecorder(nullptr);
+    delete traceRecorder;
 
 }
\ No newline at end of file